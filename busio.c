@@ -169,7 +169,8 @@ void bus_list(void)
 	struct dtree_dev_t *dev;
 	while((dev = dtree_next()) != NULL) {
 		printf("%s", dtree_dev_name(dev));
-		printf(" at 0x%X..0x%X", dtree_dev_base(dev), dtree_dev_high(dev));
+		printf(" at 0x%llX..0x%llX", (unsigned long long) dtree_dev_base(dev),
+				(unsigned long long) dtree_dev_high(dev));
 
 		const char **compat = dtree_dev_compat(dev);
 		if(compat[0] != NULL)
@@ -198,6 +199,22 @@ int perform_list(void)
 	return 0;
 }
 
+/**
+ * CPU address of the device to be accessed through /dev/mem.
+ * Devices on buses without ranges fall back to the bus address.
+ */
+dtree_addr_t dev_mem_base(const struct dtree_dev_t *d)
+{
+	const dtree_addr_t cpu = dtree_dev_cpu_base(d);
+
+	if(cpu == DTREE_ADDR_NONE) {
+		verbosity_printf(1, "WARN: '%s' is not mapped to the CPU, using its bus address", dtree_dev_name(d));
+		return dtree_dev_base(d);
+	}
+
+	return cpu;
+}
+
 int perform_read(const char *dev, uint32_t addr, int len)
 {
 	struct dtree_dev_t *d = dtree_byname(dev);
@@ -211,14 +228,15 @@ int perform_read(const char *dev, uint32_t addr, int len)
 
 	if(base < high) {
 		if(base + addr + len > high) {
-			verbosity_printf(1, "Address is out of range of the device: 0x%08X (high: 0x%08X)", base + addr, high);
+			verbosity_printf(1, "Address is out of range of the device: 0x%08llX (high: 0x%08llX)",
+					(unsigned long long) (base + addr), (unsigned long long) high);
 			return 2;
 		}
 	}
 
 	verbosity_printf(1, "Action: read, device: '%s', offset: '0x%08X', len: '%d'", dev, addr, len);
 
-	uint32_t value = bus_read(base, addr, len);
+	uint32_t value = bus_read(dev_mem_base(d), addr, len);
 	printf("0x%08X\n", value);
 
 	dtree_dev_free(d);
@@ -238,14 +256,15 @@ int perform_write(const char *dev, uint32_t addr, uint32_t len, uint32_t value)
 
 	if(base < high) {
 		if(base + addr + len > high) {
-			verbosity_printf(1, "Address is out of range of the device: 0x%08X (high: 0x%08X)", base + addr, high);
+			verbosity_printf(1, "Address is out of range of the device: 0x%08llX (high: 0x%08llX)",
+					(unsigned long long) (base + addr), (unsigned long long) high);
 			return 2;
 		}
 	}
 
 	verbosity_printf(1, "Action: write, device: '%s', offset: '0x%08X', data: '0x%08X', len: '%d'", dev, addr, value, len);
 
-	bus_write(dtree_dev_base(d), addr, value, len);
+	bus_write(dev_mem_base(d), addr, value, len);
 
 	dtree_dev_free(d);
 	return 0;
@@ -277,6 +296,8 @@ int perform_file_write(const char *dev, uint32_t addr, uint32_t len, FILE *f)
 		return 1;
 	}
 
+	const dtree_addr_t mem = dev_mem_base(d);
+
 	while (fgets(s_value, S_BUFFSIZE, f) != NULL) {
 		size_t s_len = strlen(s_value);
 
@@ -293,12 +314,13 @@ int perform_file_write(const char *dev, uint32_t addr, uint32_t len, FILE *f)
 
 		if(base < high) {
 			if(base + addr + len > high) {
-				verbosity_printf(1, "Address is out of range of the device: 0x%08X (high: 0x%08X)", base + addr, high);
+				verbosity_printf(1, "Address is out of range of the device: 0x%08llX (high: 0x%08llX)",
+						(unsigned long long) (base + addr), (unsigned long long) high);
 				return 2;
 			}
 		}
 
-		bus_write(base, addr, value, len);
+		bus_write(mem, addr, value, len);
 
 		addr += len;
 	}
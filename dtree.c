@@ -1,85 +1,829 @@
+#define _DEFAULT_SOURCE
+
 #include "dtree.h"
 #include "dtree_error.h"
-#include "dtree_procfs.h"
+#include "dtree_backend.h"
+#include "dtree_ctx.h"
+#include "dtree_shared.h"
+#include "dtree_util.h"
+#include "dtree_reg.h"
 
+#include <errno.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <sys/stat.h>
 
-int dtree_open(const char *rootd)
+/**
+ * Context used by the functions without the ctx argument.
+ */
+static struct dtree_ctx g_ctx;
+
+static
+unsigned long time_us(void)
 {
-	int err = dtree_procfs_open(rootd);
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
 
-	if(err == 0) {
-		dtree_error_clear();
-		return 0;
+	return (unsigned long) ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+}
+
+/**
+ * A regular file is considered to be a flattened
+ * device tree blob, anything else is left to procfs.
+ */
+const struct dtree_backend *dtree_backend_detect(const char *rootd)
+{
+	struct stat st;
+
+	if(rootd != NULL && !stat(rootd, &st) && S_ISREG(st.st_mode))
+		return &dtree_fdt_backend;
+
+	return &dtree_procfs_backend;
+}
+
+dtree_ctx_t *dtree_ctx_new(void)
+{
+	return calloc(1, sizeof(struct dtree_ctx));
+}
+
+void dtree_ctx_free(dtree_ctx_t *ctx)
+{
+	if(ctx == NULL)
+		return;
+
+	dtree_ctx_close(ctx);
+	free(ctx);
+}
+
+static
+int open_backend(dtree_ctx_t *ctx, const char *rootd, const struct dtree_backend *backend)
+{
+	if(ctx->state != NULL) {
+		dtree_error_set(&ctx->err, EBUSY); // call close first
+		return -1;
+	}
+
+	const unsigned long start = time_us();
+	void *state = backend->open(rootd, &ctx->opts, &ctx->err);
+
+	if(state == NULL)
+		return -1;
+
+	void *iter = backend->iter_new(state);
+	if(iter == NULL) {
+		dtree_error_from_errno(&ctx->err);
+		backend->close(state);
+		return -1;
 	}
 
-	dtree_procfs_close();
-	return err;
+	ctx->backend = backend;
+	ctx->state   = state;
+	ctx->iter    = iter;
+	ctx->open_us = time_us() - start;
+	dtree_error_clear(&ctx->err);
+	return 0;
 }
 
-void dtree_close(void)
+int dtree_ctx_open(dtree_ctx_t *ctx, const char *rootd)
 {
-	dtree_procfs_close();
+	if(ctx->opts.pipeline > 0)
+		return open_backend(ctx, rootd, &dtree_pipe_backend);
+
+	return open_backend(ctx, rootd, dtree_backend_detect(rootd));
 }
 
-struct dtree_dev_t *dtree_next(void)
+int dtree_ctx_open_snapshot(dtree_ctx_t *ctx, const char *rootd)
 {
-	return dtree_procfs_next();
+	return open_backend(ctx, rootd, &dtree_snapshot_backend);
 }
 
-void dtree_dev_free(struct dtree_dev_t *dev)
+void dtree_ctx_set_threads(dtree_ctx_t *ctx, unsigned threads)
 {
-	dtree_procfs_dev_free(dev);
+	ctx->opts.threads = threads;
 }
 
-int dtree_reset(void)
+void dtree_ctx_set_pipeline(dtree_ctx_t *ctx, unsigned depth)
 {
-	return dtree_procfs_reset();
+	ctx->opts.pipeline = depth;
 }
 
-struct dtree_dev_t *dtree_byname(const char *name)
+void dtree_ctx_set_uring(dtree_ctx_t *ctx, int enabled)
+{
+	ctx->opts.uring = enabled;
+}
+
+void dtree_ctx_set_props(dtree_ctx_t *ctx, int enabled)
+{
+	ctx->opts.props = enabled;
+}
+
+void dtree_ctx_set_filter(dtree_ctx_t *ctx, const struct dtree_filter_t *filter)
+{
+	memset(&ctx->opts.filter, 0, sizeof(struct dtree_filter_t));
+
+	if(filter != NULL)
+		ctx->opts.filter = *filter;
+}
+
+void dtree_ctx_close(dtree_ctx_t *ctx)
+{
+	if(ctx->state != NULL) {
+		ctx->backend->iter_free(ctx->state, ctx->iter);
+		ctx->backend->close(ctx->state);
+	}
+
+	ctx->backend = NULL;
+	ctx->state   = NULL;
+	ctx->iter    = NULL;
+	ctx->open_us = 0;
+}
+
+static
+struct dtree_dev_t *ctx_next(dtree_ctx_t *ctx, void *cursor)
+{
+	if(ctx->state == NULL)
+		return NULL;
+
+	return ctx->backend->next(ctx->state, cursor);
+}
+
+struct dtree_dev_t *dtree_ctx_next(dtree_ctx_t *ctx)
+{
+	return ctx_next(ctx, ctx->iter);
+}
+
+void dtree_ctx_dev_free(dtree_ctx_t *ctx, struct dtree_dev_t *dev)
+{
+	if(ctx->state != NULL)
+		ctx->backend->dev_free(ctx->state, dev);
+}
+
+static
+int ctx_reset(dtree_ctx_t *ctx, void *cursor)
+{
+	if(ctx->state == NULL)
+		return 0;
+
+	return ctx->backend->reset(ctx->state, cursor);
+}
+
+int dtree_ctx_reset(dtree_ctx_t *ctx)
+{
+	return ctx_reset(ctx, ctx->iter);
+}
+
+void dtree_ctx_stats(dtree_ctx_t *ctx, struct dtree_stats_t *stats)
+{
+	memset(stats, 0, sizeof(struct dtree_stats_t));
+
+	if(ctx->state != NULL && ctx->backend->stats != NULL)
+		ctx->backend->stats(ctx->state, stats);
+
+	stats->load_us = ctx->open_us;
+}
+
+int dtree_ctx_iserror(const dtree_ctx_t *ctx)
+{
+	return dtree_error_isset(&ctx->err);
+}
+
+const char *dtree_ctx_errstr(const dtree_ctx_t *ctx)
+{
+	return dtree_error_str(&ctx->err);
+}
+
+static
+struct dtree_dev_t *ctx_byname(dtree_ctx_t *ctx, void *cursor, const char *name)
 {
 	struct dtree_dev_t *curr = NULL;
 
-	if(name == NULL || strlen(name) == 0)
+	if(name == NULL || strlen(name) == 0 || ctx->state == NULL)
 		return NULL;
 
-	while((curr = dtree_next()) != NULL) {
-		if(!strcmp(name, curr->name))
+	if(ctx->backend->byname != NULL)
+		return ctx->backend->byname(ctx->state, cursor, name);
+
+	while((curr = ctx_next(ctx, cursor)) != NULL) {
+		if(name_matches(name, curr->name))
 			break;
 
-		dtree_dev_free(curr);
+		dtree_ctx_dev_free(ctx, curr);
 	}
 
 	return curr;
 }
 
+struct dtree_dev_t *dtree_ctx_byname(dtree_ctx_t *ctx, const char *name)
+{
+	return ctx_byname(ctx, ctx->iter, name);
+}
+
+/**
+ * Walks the whole tree by a temporary cursor and collects
+ * devices accepted by match (see dtree_byname_all()).
+ */
 static
-int is_compatible(const struct dtree_dev_t *dev, const char *compat)
+size_t all_matching(dtree_ctx_t *ctx, int (*match)(const void *, const struct dtree_dev_t *),
+		const void *key, struct dtree_dev_t **devs, size_t max)
+{
+	struct dtree_dev_t *curr = NULL;
+	size_t count = 0;
+
+	void *cursor = ctx->backend->iter_new(ctx->state);
+	if(cursor == NULL) {
+		dtree_error_from_errno(&ctx->err);
+		return 0;
+	}
+
+	while((curr = ctx_next(ctx, cursor)) != NULL) {
+		if(!match(key, curr)) {
+			dtree_ctx_dev_free(ctx, curr);
+			continue;
+		}
+
+		if(count < max)
+			devs[count] = curr;
+		else
+			dtree_ctx_dev_free(ctx, curr);
+
+		count += 1;
+	}
+
+	ctx->backend->iter_free(ctx->state, cursor);
+	return count;
+}
+
+static
+int dev_name_matches(const void *name, const struct dtree_dev_t *dev)
+{
+	return name_matches((const char *) name, dtree_dev_name(dev));
+}
+
+size_t dtree_ctx_byname_all(dtree_ctx_t *ctx, const char *name,
+		struct dtree_dev_t **devs, size_t max)
+{
+	if(name == NULL || strlen(name) == 0 || ctx->state == NULL)
+		return 0;
+
+	if(ctx->backend->byname_all != NULL)
+		return ctx->backend->byname_all(ctx->state, name, devs, max);
+
+	return all_matching(ctx, dev_name_matches, name, devs, max);
+}
+
+static
+int is_compatible(const void *compat, const struct dtree_dev_t *dev)
 {
 	const char **dev_compat = dtree_dev_compat(dev);
 
 	for(int i = 0; dev_compat[i] != NULL; ++i) {
-		if(!strcmp(dev_compat[i], compat))
+		if(!strcmp(dev_compat[i], (const char *) compat))
 			return 1;
 	}
 
 	return 0;
 }
 
-struct dtree_dev_t *dtree_bycompat(const char *compat)
+static
+struct dtree_dev_t *ctx_bycompat(dtree_ctx_t *ctx, void *cursor, const char *compat)
+{
+	struct dtree_dev_t *curr = NULL;
+
+	if(compat == NULL || strlen(compat) == 0 || ctx->state == NULL)
+		return NULL;
+
+	if(ctx->backend->bycompat != NULL)
+		return ctx->backend->bycompat(ctx->state, cursor, compat);
+
+	while((curr = ctx_next(ctx, cursor)) != NULL) {
+		if(is_compatible(compat, curr))
+			break;
+
+		dtree_ctx_dev_free(ctx, curr);
+	}
+
+	return curr;
+}
+
+struct dtree_dev_t *dtree_ctx_bycompat(dtree_ctx_t *ctx, const char *compat)
+{
+	return ctx_bycompat(ctx, ctx->iter, compat);
+}
+
+size_t dtree_ctx_bycompat_all(dtree_ctx_t *ctx, const char *compat,
+		struct dtree_dev_t **devs, size_t max)
+{
+	if(compat == NULL || strlen(compat) == 0 || ctx->state == NULL)
+		return 0;
+
+	if(ctx->backend->bycompat_all != NULL)
+		return ctx->backend->bycompat_all(ctx->state, compat, devs, max);
+
+	return all_matching(ctx, is_compatible, compat, devs, max);
+}
+
+/**
+ * Addresses lo..hi in the bus or CPU address space.
+ */
+struct addr_range {
+	dtree_addr_t lo;
+	dtree_addr_t hi;
+	int cpu;
+};
+
+static
+int dev_in_range(const void *range, const struct dtree_dev_t *dev)
+{
+	const struct addr_range *r = (const struct addr_range *) range;
+	return dtree_reg_intersects(dev, r->lo, r->hi, r->cpu);
+}
+
+static
+struct dtree_dev_t *ctx_byaddr(dtree_ctx_t *ctx, void *cursor, dtree_addr_t addr, int cpu)
 {
 	struct dtree_dev_t *curr = NULL;
 
-	if(compat == NULL || strlen(compat) == 0)
+	if(ctx->state == NULL)
 		return NULL;
 
-	while((curr = dtree_next()) != NULL) {
-		if(is_compatible(curr, compat))
+	if(ctx->backend->byaddr != NULL)
+		return ctx->backend->byaddr(ctx->state, cursor, addr, cpu);
+
+	while((curr = ctx_next(ctx, cursor)) != NULL) {
+		if(dtree_reg_intersects(curr, addr, addr, cpu))
 			break;
 
-		dtree_dev_free(curr);
+		dtree_ctx_dev_free(ctx, curr);
 	}
 
 	return curr;
 }
+
+static
+size_t ctx_byrange(dtree_ctx_t *ctx, dtree_addr_t lo, dtree_addr_t hi, int cpu,
+		struct dtree_dev_t **devs, size_t max)
+{
+	const struct addr_range range = {lo, hi, cpu};
+
+	if(lo > hi || ctx->state == NULL)
+		return 0;
+
+	if(ctx->backend->byrange != NULL) {
+		const size_t count = ctx->backend->byrange(ctx->state, lo, hi, cpu, devs, max);
+		if(count != DTREE_RANGE_FAILED)
+			return count;
+
+		dtree_error_from_errno(&ctx->err);
+		return 0;
+	}
+
+	return all_matching(ctx, dev_in_range, &range, devs, max);
+}
+
+struct dtree_dev_t *dtree_ctx_byaddr(dtree_ctx_t *ctx, dtree_addr_t addr)
+{
+	return ctx_byaddr(ctx, ctx->iter, addr, 0);
+}
+
+size_t dtree_ctx_byrange(dtree_ctx_t *ctx, dtree_addr_t lo, dtree_addr_t hi,
+		struct dtree_dev_t **devs, size_t max)
+{
+	return ctx_byrange(ctx, lo, hi, 0, devs, max);
+}
+
+struct dtree_dev_t *dtree_ctx_bycpuaddr(dtree_ctx_t *ctx, dtree_addr_t addr)
+{
+	return ctx_byaddr(ctx, ctx->iter, addr, 1);
+}
+
+size_t dtree_ctx_bycpurange(dtree_ctx_t *ctx, dtree_addr_t lo, dtree_addr_t hi,
+		struct dtree_dev_t **devs, size_t max)
+{
+	return ctx_byrange(ctx, lo, hi, 1, devs, max);
+}
+
+struct dtree_dev_t *dtree_ctx_byphandle(dtree_ctx_t *ctx, uint32_t phandle)
+{
+	struct dtree_dev_t *curr = NULL;
+
+	if(phandle == 0 || ctx->state == NULL)
+		return NULL;
+
+	if(ctx->backend->byphandle != NULL)
+		return ctx->backend->byphandle(ctx->state, phandle);
+
+	void *cursor = ctx->backend->iter_new(ctx->state);
+	if(cursor == NULL) {
+		dtree_error_from_errno(&ctx->err);
+		return NULL;
+	}
+
+	while((curr = ctx_next(ctx, cursor)) != NULL) {
+		if(dtree_dev_phandle(curr) == phandle)
+			break;
+
+		dtree_ctx_dev_free(ctx, curr);
+	}
+
+	ctx->backend->iter_free(ctx->state, cursor);
+	return curr;
+}
+
+size_t dtree_ctx_byphandle_list(dtree_ctx_t *ctx, const void *list, size_t len,
+		const char *cells, struct dtree_dev_t **devs, size_t max)
+{
+	const unsigned char *data = (const unsigned char *) list;
+	const size_t ncells = list == NULL? 0 : len / 4;
+	size_t count = 0;
+
+	for(size_t i = 0; i < ncells; ++count) {
+		uint32_t phandle = 0;
+		uint32_t args = 0;
+
+		dtree_cells_read32(data + 4 * i, 1, &phandle);
+		struct dtree_dev_t *dev = dtree_ctx_byphandle(ctx, phandle);
+
+		// an empty (0) entry has no specifier, without the provider
+		// it is not known where the next entry begins
+		int lost = cells != NULL && phandle != 0
+			&& (dev == NULL || dtree_dev_prop_u32(dev, cells, &args));
+
+		if(lost && dev != NULL) {
+			dtree_ctx_dev_free(ctx, dev);
+			dev = NULL;
+		}
+
+		if(count < max)
+			devs[count] = dev;
+		else if(dev != NULL)
+			dtree_ctx_dev_free(ctx, dev);
+
+		if(lost)
+			return count + 1;
+
+		i += 1 + (size_t) args;
+	}
+
+	return count;
+}
+
+
+//
+// Device properties
+//
+
+const void *dtree_dev_prop(const struct dtree_dev_t *d, const char *name, size_t *len)
+{
+	for(size_t i = 0; i < d->nprops; ++i) {
+		if(strcmp(d->props[i].name, name))
+			continue;
+
+		if(len != NULL)
+			*len = d->props[i].len;
+
+		return d->props[i].value;
+	}
+
+	return NULL;
+}
+
+int dtree_dev_prop_u32(const struct dtree_dev_t *d, const char *name, uint32_t *val)
+{
+	size_t len = 0;
+	const void *value = dtree_dev_prop(d, name, &len);
+
+	if(value == NULL || len != 4)
+		return 1;
+
+	dtree_cells_read32(value, 1, val);
+	return 0;
+}
+
+int dtree_dev_prop_u64(const struct dtree_dev_t *d, const char *name, uint64_t *val)
+{
+	size_t len = 0;
+	const void *value = dtree_dev_prop(d, name, &len);
+
+	if(value == NULL || (len != 4 && len != 8))
+		return 1;
+
+	dtree_cells_read(value, 1, len / 4, val);
+	return 0;
+}
+
+size_t dtree_dev_prop_cells(const struct dtree_dev_t *d, const char *name,
+		uint32_t *cells, size_t max)
+{
+	size_t len = 0;
+	const void *value = dtree_dev_prop(d, name, &len);
+
+	if(value == NULL)
+		return 0;
+
+	const size_t count = len / 4;
+	dtree_cells_read32(value, count < max? count : max, cells);
+	return count;
+}
+
+size_t dtree_dev_prop_strings(const struct dtree_dev_t *d, const char *name,
+		const char **strs, size_t max)
+{
+	size_t len = 0;
+	const char *value = dtree_dev_prop(d, name, &len);
+	size_t count = 0;
+
+	if(value == NULL)
+		return 0;
+
+	for(size_t off = 0; off < len; ) {
+		const char *end = memchr(value + off, '\0', len - off);
+		if(end == NULL)
+			break;
+
+		if(count < max)
+			strs[count] = value + off;
+
+		count += 1;
+		off = (size_t) (end - value) + 1;
+	}
+
+	return count;
+}
+
+
+//
+// Independent iterators
+//
+
+/**
+ * Errors of iterators over shared snapshots are not stored
+ * (the context is used by many threads), only errno is set.
+ */
+static
+void iter_error(const dtree_iter_t *it, dtree_ctx_t *ctx)
+{
+	if(it == NULL || it->version == NULL)
+		dtree_error_from_errno(&ctx->err);
+}
+
+dtree_iter_t *dtree_ctx_iter_new(dtree_ctx_t *ctx, struct dtree_version *version)
+{
+	dtree_iter_t *it = malloc(sizeof(struct dtree_iter));
+	if(it == NULL)
+		return NULL;
+
+	it->ctx     = ctx;
+	it->version = version;
+	it->cursor  = ctx->backend->iter_new(ctx->state);
+
+	if(it->cursor == NULL) {
+		free(it);
+		return NULL;
+	}
+
+	return it;
+}
+
+dtree_iter_t *dtree_iter_create(dtree_ctx_t *ctx)
+{
+	if(ctx == NULL)
+		ctx = &g_ctx;
+
+	if(ctx->state == NULL) {
+		dtree_error_set(&ctx->err, EINVAL); // call open first
+		return NULL;
+	}
+
+	dtree_iter_t *it = dtree_ctx_iter_new(ctx, NULL);
+	if(it == NULL)
+		iter_error(NULL, ctx);
+
+	return it;
+}
+
+dtree_iter_t *dtree_iter_clone(const dtree_iter_t *it)
+{
+	dtree_ctx_t *ctx = it->ctx;
+
+	dtree_iter_t *copy = malloc(sizeof(struct dtree_iter));
+	if(copy == NULL) {
+		iter_error(it, ctx);
+		return NULL;
+	}
+
+	copy->ctx     = ctx;
+	copy->version = it->version;
+	copy->cursor  = ctx->backend->iter_clone(ctx->state, it->cursor);
+
+	if(copy->cursor == NULL) {
+		iter_error(it, ctx);
+		free(copy);
+		return NULL;
+	}
+
+	if(copy->version != NULL)
+		dtree_version_get(copy->version);
+
+	return copy;
+}
+
+void dtree_iter_destroy(dtree_iter_t *it)
+{
+	if(it == NULL)
+		return;
+
+	it->ctx->backend->iter_free(it->ctx->state, it->cursor);
+
+	if(it->version != NULL)
+		dtree_version_put(it->version);
+
+	free(it);
+}
+
+struct dtree_dev_t *dtree_iter_next(dtree_iter_t *it)
+{
+	return ctx_next(it->ctx, it->cursor);
+}
+
+struct dtree_dev_t *dtree_iter_byname(dtree_iter_t *it, const char *name)
+{
+	return ctx_byname(it->ctx, it->cursor, name);
+}
+
+struct dtree_dev_t *dtree_iter_bycompat(dtree_iter_t *it, const char *compat)
+{
+	return ctx_bycompat(it->ctx, it->cursor, compat);
+}
+
+struct dtree_dev_t *dtree_iter_byaddr(dtree_iter_t *it, dtree_addr_t addr)
+{
+	return ctx_byaddr(it->ctx, it->cursor, addr, 0);
+}
+
+struct dtree_dev_t *dtree_iter_bycpuaddr(dtree_iter_t *it, dtree_addr_t addr)
+{
+	return ctx_byaddr(it->ctx, it->cursor, addr, 1);
+}
+
+/**
+ * Does not move the cursor (as dtree_byphandle()), the iterator
+ * only keeps the snapshot of a shared context alive.
+ */
+struct dtree_dev_t *dtree_iter_byphandle(dtree_iter_t *it, uint32_t phandle)
+{
+	return dtree_ctx_byphandle(it->ctx, phandle);
+}
+
+int dtree_iter_set_filter(dtree_iter_t *it, const struct dtree_filter_t *filter)
+{
+	const struct dtree_filter_t none = {0, NULL, 0};
+	dtree_ctx_t *ctx = it->ctx;
+
+	if(ctx->backend->filter == NULL) {
+		errno = ENOTSUP;
+		iter_error(it, ctx);
+		return -1;
+	}
+
+	if(ctx->backend->filter(ctx->state, it->cursor, filter == NULL? &none : filter))
+		return -1;
+
+	return 0;
+}
+
+int dtree_iter_reset(dtree_iter_t *it)
+{
+	return ctx_reset(it->ctx, it->cursor);
+}
+
+void dtree_iter_dev_free(dtree_iter_t *it, struct dtree_dev_t *dev)
+{
+	dtree_ctx_dev_free(it->ctx, dev);
+}
+
+
+//
+// Functions of the default context
+//
+
+int dtree_open(const char *rootd)
+{
+	return dtree_ctx_open(&g_ctx, rootd);
+}
+
+int dtree_open_snapshot(const char *rootd)
+{
+	return dtree_ctx_open_snapshot(&g_ctx, rootd);
+}
+
+void dtree_set_threads(unsigned threads)
+{
+	dtree_ctx_set_threads(&g_ctx, threads);
+}
+
+void dtree_set_pipeline(unsigned depth)
+{
+	dtree_ctx_set_pipeline(&g_ctx, depth);
+}
+
+void dtree_set_uring(int enabled)
+{
+	dtree_ctx_set_uring(&g_ctx, enabled);
+}
+
+void dtree_set_props(int enabled)
+{
+	dtree_ctx_set_props(&g_ctx, enabled);
+}
+
+void dtree_set_filter(const struct dtree_filter_t *filter)
+{
+	dtree_ctx_set_filter(&g_ctx, filter);
+}
+
+void dtree_close(void)
+{
+	dtree_ctx_close(&g_ctx);
+}
+
+struct dtree_dev_t *dtree_next(void)
+{
+	return dtree_ctx_next(&g_ctx);
+}
+
+struct dtree_dev_t *dtree_byname(const char *name)
+{
+	return dtree_ctx_byname(&g_ctx, name);
+}
+
+size_t dtree_byname_all(const char *name, struct dtree_dev_t **devs, size_t max)
+{
+	return dtree_ctx_byname_all(&g_ctx, name, devs, max);
+}
+
+struct dtree_dev_t *dtree_bycompat(const char *compat)
+{
+	return dtree_ctx_bycompat(&g_ctx, compat);
+}
+
+size_t dtree_bycompat_all(const char *compat, struct dtree_dev_t **devs, size_t max)
+{
+	return dtree_ctx_bycompat_all(&g_ctx, compat, devs, max);
+}
+
+struct dtree_dev_t *dtree_byaddr(dtree_addr_t addr)
+{
+	return dtree_ctx_byaddr(&g_ctx, addr);
+}
+
+size_t dtree_byrange(dtree_addr_t lo, dtree_addr_t hi, struct dtree_dev_t **devs, size_t max)
+{
+	return dtree_ctx_byrange(&g_ctx, lo, hi, devs, max);
+}
+
+struct dtree_dev_t *dtree_bycpuaddr(dtree_addr_t addr)
+{
+	return dtree_ctx_bycpuaddr(&g_ctx, addr);
+}
+
+size_t dtree_bycpurange(dtree_addr_t lo, dtree_addr_t hi, struct dtree_dev_t **devs, size_t max)
+{
+	return dtree_ctx_bycpurange(&g_ctx, lo, hi, devs, max);
+}
+
+struct dtree_dev_t *dtree_byphandle(uint32_t phandle)
+{
+	return dtree_ctx_byphandle(&g_ctx, phandle);
+}
+
+size_t dtree_byphandle_list(const void *list, size_t len, const char *cells,
+		struct dtree_dev_t **devs, size_t max)
+{
+	return dtree_ctx_byphandle_list(&g_ctx, list, len, cells, devs, max);
+}
+
+int dtree_reset(void)
+{
+	return dtree_ctx_reset(&g_ctx);
+}
+
+void dtree_dev_free(struct dtree_dev_t *dev)
+{
+	dtree_ctx_dev_free(&g_ctx, dev);
+}
+
+void dtree_stats(struct dtree_stats_t *stats)
+{
+	dtree_ctx_stats(&g_ctx, stats);
+}
+
+int dtree_iserror(void)
+{
+	return dtree_ctx_iserror(&g_ctx);
+}
+
+const char *dtree_errstr(void)
+{
+	return dtree_ctx_errstr(&g_ctx);
+}
@@ -6,12 +6,18 @@
  * The main principle if to be able to iterate
  * over all devices or search among them.
  *
- * The library is not reentrant nor thread safe.
+ * The functions without a context argument work with
+ * a single default context and are not reentrant nor
+ * thread safe. Every dtree_ctx_*() function works with
+ * the given context only, independent contexts can be
+ * used from different threads concurrently (a single
+ * context must not be shared without locking).
  */
 
 #ifndef DTREE_H
 #define DTREE_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 //
@@ -23,6 +29,11 @@
  * (typically /proc/device-tree). Setups internal
  * structures. Clears error state.
  *
+ * When rootd is a regular file it is treated as
+ * a flattened device tree blob (eg. /sys/firmware/fdt
+ * or a .dtb file). The blob is mapped into memory and
+ * names and compatible strings point directly into it.
+ *
  * It is safe to call dtree_reset() after dtree_open()
  * but it has no effect.
  * It is an error to call dtree_open() twice (without
@@ -33,7 +44,110 @@
 int dtree_open(const char *rootd);
 
 /**
- * Free's resources of the module.
+ * Opens device tree like dtree_open() but loads all
+ * devices into memory at once. Iteration and look up
+ * routines then never touch the filesystem again and
+ * dtree_reset() is cheap. Useful when the tree is
+ * searched repeatedly.
+ *
+ * Devices returned in this mode are owned by the module
+ * and stay valid until dtree_close(). Calling
+ * dtree_dev_free() on them is allowed but has no effect.
+ *
+ * Returns 0 on success. On error sets error state.
+ */
+int dtree_open_snapshot(const char *rootd);
+
+/**
+ * Sets the number of threads loading the tree by the next
+ * dtree_open_snapshot(). Subtrees of a procfs tree are read
+ * in parallel, devices keep the order of the sequential walk.
+ * 0 or 1 (default) loads sequentially. A flattened device
+ * tree is always loaded sequentially.
+ */
+void dtree_set_threads(unsigned threads);
+
+/**
+ * Makes the next dtree_open() walk the tree in a background
+ * thread that prepares up to depth devices ahead of dtree_next().
+ * The devices, their order and the error reporting are the same
+ * as without it, the filesystem latency overlaps with processing
+ * of the devices by the caller. 0 (default) disables it.
+ *
+ * In this mode the tree can be walked by the shared iterator
+ * only (dtree_next(), dtree_byname(), dtree_bycompat(),
+ * dtree_byaddr(), dtree_bycpuaddr() and dtree_reset()). Other
+ * iterators can not be created, dtree_byname_all(), dtree_bycompat_all(),
+ * dtree_byrange() and dtree_bycpurange() fail with EBUSY. So do
+ * dtree_byphandle() and dtree_byphandle_list() (they walk
+ * a temporary iterator), every phandle resolves to NULL.
+ */
+void dtree_set_pipeline(unsigned depth);
+
+/**
+ * Enables or disables (default) batched reads of procfs
+ * properties by io_uring for the next open. Properties of
+ * a node are then opened, read and closed by a single system
+ * call. Kernels without io_uring (or without its direct
+ * descriptors, Linux 5.15) are read by the plain system calls
+ * regardless of this setting.
+ *
+ * Whether it pays off depends on the kernel and the machine,
+ * see `make -C test bench`.
+ */
+void dtree_set_uring(int enabled);
+
+/**
+ * Enables or disables (default) the property table of devices
+ * returned after the next open (see dtree_dev_prop()). A procfs
+ * device then reads all its properties while it is built (each
+ * of them once), a flattened tree points to them in the blob.
+ * Without it only the properties describing the device are read
+ * and a device having a phandle gets only its #*-cells properties
+ * (eg. #clock-cells, see dtree_byphandle_list()) into the table.
+ */
+void dtree_set_props(int enabled);
+
+/**
+ * Filter of the walk. A node it rejects is skipped together
+ * with its whole subtree: it is not built into a device and
+ * no property of it is read (except status when skip_disabled
+ * asks for it), nodes deeper than max_depth are not even listed.
+ * Look ups see the filtered tree only.
+ */
+struct dtree_filter_t {
+	/**
+	 * Skips nodes whose status is not "okay" (eg. "disabled").
+	 * A node without status is enabled.
+	 */
+	int skip_disabled;
+
+	/**
+	 * NULL-terminated list of names of the skipped nodes
+	 * matched as by dtree_byname() (eg. "cpus", "chosen"),
+	 * NULL skips none. It must stay valid while the filter
+	 * is used.
+	 */
+	const char *const *skip;
+
+	/**
+	 * The deepest level walked (children of the root
+	 * are at 1), 0 does not limit.
+	 */
+	unsigned max_depth;
+};
+
+/**
+ * Sets the filter of the walk of the next open, NULL (default)
+ * walks the whole tree. The filter is copied, all iterators of
+ * the opened tree start with it and a snapshot loads only the
+ * nodes it accepts.
+ */
+void dtree_set_filter(const struct dtree_filter_t *filter);
+
+/**
+ * Free's resources of the module including all
+ * devices that have not been free'd yet.
  * It is an error to call it when dtree_open()
  * has failed or to call it twice.
  */
@@ -47,19 +161,63 @@ void dtree_close(void);
 /**
  * Representation of address.
  */
-typedef uint32_t dtree_addr_t;
+typedef uint64_t dtree_addr_t;
+
+/**
+ * Address not mapped to the CPU (see dtree_dev_cpu_base()).
+ */
+#define DTREE_ADDR_NONE ((dtree_addr_t) -1)
+
+/**
+ * Address range of a device (an entry of its reg property).
+ */
+struct dtree_reg_t {
+	dtree_addr_t base;
+	dtree_addr_t size;
+};
+
+/**
+ * Property of a device: len bytes of value as stored in
+ * the tree (cells are big-endian).
+ */
+struct dtree_prop_t {
+	const char *name;
+	const void *value;
+	size_t      len;
+};
 
 /**
  * Device info representation.
  *
  * Consists of the name, address (base and highest address)
  * and array of compatible devices. Last pointer in compat is NULL.
+ *
+ * All address ranges of the device (reg decoded by #address-cells
+ * and #size-cells of the parent) are in reg, base and high describe
+ * the first one (both are 0 when there is none). A parent without the cells properties is assumed
+ * to have one cell of each.
+ *
+ * The addresses in reg are local to the parent bus. Their CPU
+ * addresses (translated through ranges of all ancestors) are in cpu.
+ *
+ * All properties of the node are in props (in the order of the
+ * tree) when enabled by dtree_set_props(), otherwise there are only
+ * the #*-cells properties of a device having a phandle.
  */
 struct dtree_dev_t {
 	const char  *name;
 	dtree_addr_t base;
 	dtree_addr_t high;
 	const char  **compat;
+
+	const struct dtree_reg_t *reg;
+	size_t nreg;
+	const dtree_addr_t *cpu;
+
+	uint32_t phandle; // 0 when the node has none
+
+	const struct dtree_prop_t *props;
+	size_t nprops;
 };
 
 #define DTREE_GETTER static inline
@@ -107,6 +265,112 @@ const char **dtree_dev_compat(const struct dtree_dev_t *d)
 	return d->compat;
 }
 
+/**
+ * Get the number of address ranges of the device (at least 1,
+ * 0 for a provider without reg found by dtree_byphandle()).
+ */
+DTREE_GETTER
+size_t dtree_dev_reg_count(const struct dtree_dev_t *d)
+{
+	return d->nreg;
+}
+
+/**
+ * Get the i-th address range of the device or NULL when
+ * there is no such range. The first one is at base.
+ */
+DTREE_GETTER
+const struct dtree_reg_t *dtree_dev_reg(const struct dtree_dev_t *d, size_t i)
+{
+	return i < d->nreg? &d->reg[i] : NULL;
+}
+
+/**
+ * Get the CPU address of the i-th range of the device (eg. to be
+ * mapped by /dev/mem). It is the base of the range translated
+ * through ranges of all parent buses. Returns DTREE_ADDR_NONE when
+ * there is no such range or a bus does not map it (eg. a device
+ * on I2C or a bus without ranges).
+ */
+DTREE_GETTER
+dtree_addr_t dtree_dev_cpu_addr(const struct dtree_dev_t *d, size_t i)
+{
+	return i < d->nreg? d->cpu[i] : DTREE_ADDR_NONE;
+}
+
+/**
+ * Get the CPU address of the device (of its first range).
+ */
+DTREE_GETTER
+dtree_addr_t dtree_dev_cpu_base(const struct dtree_dev_t *d)
+{
+	return dtree_dev_cpu_addr(d, 0);
+}
+
+/**
+ * Get the phandle of the device (the value other nodes refer
+ * to it by) or 0 when it has none.
+ */
+DTREE_GETTER
+uint32_t dtree_dev_phandle(const struct dtree_dev_t *d)
+{
+	return d->phandle;
+}
+
+/**
+ * Get the number of properties of the device
+ * (only the #*-cells of a device having a phandle unless
+ * enabled by dtree_set_props()).
+ */
+DTREE_GETTER
+size_t dtree_dev_prop_count(const struct dtree_dev_t *d)
+{
+	return d->nprops;
+}
+
+/**
+ * Get the i-th property of the device or NULL when
+ * there is no such property.
+ */
+DTREE_GETTER
+const struct dtree_prop_t *dtree_dev_prop_at(const struct dtree_dev_t *d, size_t i)
+{
+	return i < d->nprops? &d->props[i] : NULL;
+}
+
+/**
+ * Get the value of the property of the given name and store
+ * its length into len (when not NULL). Returns NULL when the
+ * device has no such property.
+ */
+const void *dtree_dev_prop(const struct dtree_dev_t *d, const char *name, size_t *len);
+
+/**
+ * Decode the property consisting of a single cell (u32) or
+ * of one or two cells (u64, eg. clock-frequency). Returns 0
+ * on success, non-zero when the property is missing or of
+ * another size (val is not changed then).
+ */
+int dtree_dev_prop_u32(const struct dtree_dev_t *d, const char *name, uint32_t *val);
+int dtree_dev_prop_u64(const struct dtree_dev_t *d, const char *name, uint64_t *val);
+
+/**
+ * Decode up to max cells of the property (eg. interrupts) into
+ * cells. Returns the number of whole cells of the property, 0 when
+ * it is missing.
+ */
+size_t dtree_dev_prop_cells(const struct dtree_dev_t *d, const char *name,
+		uint32_t *cells, size_t max);
+
+/**
+ * Split the string list property (eg. clock-names) and store
+ * pointers to up to max strings into strs. Returns the number
+ * of strings of the property (an unterminated tail is not
+ * a string), 0 when it is missing.
+ */
+size_t dtree_dev_prop_strings(const struct dtree_dev_t *d, const char *name,
+		const char **strs, size_t max);
+
 
 //
 // Iteration routines
@@ -126,17 +390,38 @@ struct dtree_dev_t *dtree_next(void);
 
 /**
  * Look up for device by name. Returns the first occurence
- * of device with the given name.
+ * of device with the given name. The name is either the full
+ * name of the device (eg. "ethernet@81000000") or the name
+ * without the unit address (eg. "ethernet") that matches
+ * the device at any address.
  * The entry should be free'd by dtree_dev_free().
  *
  * Uses shared internal iterator.
  * To search from beginning call dtree_reset().
  *
+ * In snapshot mode the look up is done by a hash index
+ * built in dtree_open_snapshot().
+ *
  * Returns NULL when not found or on error.
  * On error sets error state.
  */
 struct dtree_dev_t *dtree_byname(const char *name);
 
+/**
+ * Looks up for all devices with the given name (matching
+ * the same way as dtree_byname()). Stores up to max devices
+ * into devs in the order of iteration. Every stored entry
+ * should be free'd by dtree_dev_free().
+ *
+ * Does not use the shared internal iterator. In snapshot mode
+ * the look up takes constant time, otherwise the whole tree
+ * is walked by a temporary iterator.
+ *
+ * Returns the number of matching devices (which can be greater
+ * than max). On error sets error state.
+ */
+size_t dtree_byname_all(const char *name, struct dtree_dev_t **devs, size_t max);
+
 /**
  * Looks up for device compatible with the given type.
  * The entry should be free'd by dtree_dev_free().
@@ -144,11 +429,115 @@ struct dtree_dev_t *dtree_byname(const char *name);
  * Uses shared internal iterator.
  * To search from beginning call dtree_reset().
  *
+ * In snapshot mode the look up is done by an index
+ * built in dtree_open_snapshot().
+ *
  * Returns NULL when not found or on error.
  * On error sets error state.
  */
 struct dtree_dev_t *dtree_bycompat(const char *compat);
 
+/**
+ * Looks up for device one of whose address ranges (entries of
+ * reg, see dtree_dev_reg()) contains the given address of its
+ * bus. The address is not translated, devices of different buses
+ * may share it (use dtree_bycpuaddr() for CPU addresses). An empty
+ * range occupies only its base address.
+ * The entry should be free'd by dtree_dev_free().
+ *
+ * Uses shared internal iterator.
+ * To search from beginning call dtree_reset().
+ *
+ * In snapshot mode the look up is done by an interval
+ * index built in dtree_open_snapshot() in O(log n).
+ *
+ * Returns NULL when not found or on error.
+ * On error sets error state.
+ */
+struct dtree_dev_t *dtree_byaddr(dtree_addr_t addr);
+
+/**
+ * Looks up for all devices compatible with the given type.
+ * Stores up to max devices into devs in the order of iteration.
+ * Every stored entry should be free'd by dtree_dev_free().
+ *
+ * Does not use the shared internal iterator. In snapshot mode
+ * the look up costs O(matches) by an index built in
+ * dtree_open_snapshot(), otherwise the whole tree is walked
+ * by a temporary iterator.
+ *
+ * Returns the number of matching devices (which can be greater
+ * than max). On error sets error state.
+ */
+size_t dtree_bycompat_all(const char *compat, struct dtree_dev_t **devs, size_t max);
+
+/**
+ * Looks up for all devices one of whose address ranges intersects
+ * lo..hi (inclusive) of their bus (see dtree_byaddr()). Stores up to
+ * max devices into devs in the order of iteration. Every stored
+ * entry should be free'd by dtree_dev_free().
+ *
+ * Does not use the shared internal iterator. In snapshot mode
+ * the look up is done by the interval index, otherwise the whole
+ * tree is walked by a temporary iterator.
+ *
+ * Returns the number of matching devices (which can be greater
+ * than max). On error sets error state.
+ */
+size_t dtree_byrange(dtree_addr_t lo, dtree_addr_t hi, struct dtree_dev_t **devs, size_t max);
+
+/**
+ * The same as dtree_byaddr() and dtree_byrange() with addresses
+ * of the CPU: every range of a device is tested at its translated
+ * address (see dtree_dev_cpu_addr()), ranges not mapped to the CPU
+ * are never found. The snapshot has an interval index of them too.
+ */
+struct dtree_dev_t *dtree_bycpuaddr(dtree_addr_t addr);
+size_t dtree_bycpurange(dtree_addr_t lo, dtree_addr_t hi, struct dtree_dev_t **devs, size_t max);
+
+/**
+ * Looks up for device with the given phandle (the target
+ * of a reference like interrupt-parent or clocks). A node
+ * without reg (a provider like a fixed clock) is found too as
+ * a device with no address ranges, the walks never return it.
+ * The entry should be free'd by dtree_dev_free().
+ *
+ * Does not use the shared internal iterator. In snapshot mode
+ * and for flattened blobs the look up takes constant time by
+ * an index built when the tree is opened, otherwise the tree is
+ * walked by a temporary iterator reading only the phandles. The
+ * walks remember the paths of the phandles they pass (until the
+ * tree is closed), a known one is found along its path and walked
+ * for again only when the path has gone. A phandle missing in the
+ * whole tree is not walked for again until the tree is reopened.
+ * A pipelined walk (see dtree_set_pipeline()) can not be looked up
+ * this way, it fails with EBUSY.
+ *
+ * Returns NULL when not found or on error.
+ * On error sets error state.
+ */
+struct dtree_dev_t *dtree_byphandle(uint32_t phandle);
+
+/**
+ * Resolves a list of references (the big-endian value of len bytes
+ * of a property like pinctrl-0 or clocks). Stores the device referred
+ * by the i-th entry into devs[i] (up to max) or NULL when there is no
+ * such device (eg. an empty 0 entry).
+ * Every stored entry should be free'd by dtree_dev_free().
+ *
+ * Each phandle is followed by a specifier of as many cells as the
+ * property cells (eg. "#clock-cells") of the referred device says.
+ * With cells NULL every cell is a phandle (eg. pinctrl-0). The cells
+ * property is in the property table of the referred device whether
+ * the table is enabled or not. When the referred device or its cells
+ * property is missing the decoding stops after that (NULL) entry.
+ *
+ * Returns the number of entries of the list (which can be greater
+ * than max). On error sets error state.
+ */
+size_t dtree_byphandle_list(const void *list, size_t len, const char *cells,
+		struct dtree_dev_t **devs, size_t max);
+
 /**
  * Resets the iteration over devices.
  * Eg. after this call dtree_next() will return the first
@@ -167,9 +556,37 @@ int dtree_reset(void);
  * Frees the given device entry (returned mostly by iterators).
  * It is recommended to free every dev instance before next
  * iterator call (or as soon as possible).
+ *
+ * Devices are allocated from an arena of the opened tree.
+ * Their memory is reused when all of them have been free'd
+ * and it is released at once by dtree_close(). Thus no device
+ * can be used after dtree_close().
  */
 void dtree_dev_free(struct dtree_dev_t *dev);
 
+/**
+ * Statistics about the opened device tree.
+ */
+struct dtree_stats_t {
+	unsigned long devices;  // number of devices held in memory
+	unsigned long load_us;  // duration of dtree_open*() in microseconds
+	unsigned long memory;   // bytes held by the in-memory representation
+	unsigned long overlaps; // devices with overlapping address ranges
+};
+
+/**
+ * Fills the statistics of the currently opened device tree.
+ * The devices, memory and overlaps are zero unless the tree
+ * has been opened by dtree_open_snapshot().
+ *
+ * A device overlaps when one of its address ranges partially
+ * covers (or equals to) a range of another device in the CPU
+ * address space. Nested ranges (eg. a bus and its devices) are
+ * not considered overlapping, neither are ranges not mapped to
+ * the CPU (the same addresses of different buses).
+ */
+void dtree_stats(struct dtree_stats_t *stats);
+
 /**
  * Tests whether the module is in an error state.
  * When it is in an error state the behaviour of all
@@ -192,4 +609,206 @@ int dtree_iserror(void);
  */
 const char *dtree_errstr(void);
 
+
+//
+// Contexts
+//
+
+/**
+ * Opaque context. It owns an opened tree, its iterator
+ * and its error state.
+ */
+typedef struct dtree_ctx dtree_ctx_t;
+
+/**
+ * Allocates a new (closed) context.
+ * Returns NULL on error (errno is set).
+ */
+dtree_ctx_t *dtree_ctx_new(void);
+
+/**
+ * Closes the context (when opened) and frees it.
+ */
+void dtree_ctx_free(dtree_ctx_t *ctx);
+
+/**
+ * The following functions behave as their counterparts
+ * without the ctx_ infix (dtree_ctx_open() as dtree_open(),
+ * etc.) but operate on the given context only. Devices
+ * returned from a context must be free'd by dtree_ctx_dev_free()
+ * of the same context.
+ */
+int  dtree_ctx_open(dtree_ctx_t *ctx, const char *rootd);
+int  dtree_ctx_open_snapshot(dtree_ctx_t *ctx, const char *rootd);
+void dtree_ctx_set_threads(dtree_ctx_t *ctx, unsigned threads);
+void dtree_ctx_set_pipeline(dtree_ctx_t *ctx, unsigned depth);
+void dtree_ctx_set_uring(dtree_ctx_t *ctx, int enabled);
+void dtree_ctx_set_props(dtree_ctx_t *ctx, int enabled);
+void dtree_ctx_set_filter(dtree_ctx_t *ctx, const struct dtree_filter_t *filter);
+void dtree_ctx_close(dtree_ctx_t *ctx);
+
+struct dtree_dev_t *dtree_ctx_next(dtree_ctx_t *ctx);
+struct dtree_dev_t *dtree_ctx_byname(dtree_ctx_t *ctx, const char *name);
+size_t dtree_ctx_byname_all(dtree_ctx_t *ctx, const char *name,
+		struct dtree_dev_t **devs, size_t max);
+struct dtree_dev_t *dtree_ctx_bycompat(dtree_ctx_t *ctx, const char *compat);
+size_t dtree_ctx_bycompat_all(dtree_ctx_t *ctx, const char *compat,
+		struct dtree_dev_t **devs, size_t max);
+struct dtree_dev_t *dtree_ctx_byaddr(dtree_ctx_t *ctx, dtree_addr_t addr);
+size_t dtree_ctx_byrange(dtree_ctx_t *ctx, dtree_addr_t lo, dtree_addr_t hi,
+		struct dtree_dev_t **devs, size_t max);
+struct dtree_dev_t *dtree_ctx_bycpuaddr(dtree_ctx_t *ctx, dtree_addr_t addr);
+size_t dtree_ctx_bycpurange(dtree_ctx_t *ctx, dtree_addr_t lo, dtree_addr_t hi,
+		struct dtree_dev_t **devs, size_t max);
+struct dtree_dev_t *dtree_ctx_byphandle(dtree_ctx_t *ctx, uint32_t phandle);
+size_t dtree_ctx_byphandle_list(dtree_ctx_t *ctx, const void *list, size_t len,
+		const char *cells, struct dtree_dev_t **devs, size_t max);
+
+int  dtree_ctx_reset(dtree_ctx_t *ctx);
+void dtree_ctx_dev_free(dtree_ctx_t *ctx, struct dtree_dev_t *dev);
+void dtree_ctx_stats(dtree_ctx_t *ctx, struct dtree_stats_t *stats);
+
+int dtree_ctx_iserror(const dtree_ctx_t *ctx);
+const char *dtree_ctx_errstr(const dtree_ctx_t *ctx);
+
+
+//
+// Iterators
+//
+
+/**
+ * Opaque iterator over an opened context. Iterators of
+ * the same context are independent of each other and of
+ * the shared internal iterator. They share the opened
+ * tree: a procfs iterator keeps only its position and
+ * directories already opened by another iterator are
+ * not opened again.
+ *
+ * An iterator must be destroyed before its context is
+ * closed. Errors are reported by the error state of
+ * the context.
+ */
+typedef struct dtree_iter dtree_iter_t;
+
+/**
+ * Creates an iterator positioned at the beginning of
+ * the tree opened by ctx (NULL stands for the default
+ * context).
+ * Returns NULL on error. On error sets error state.
+ */
+dtree_iter_t *dtree_iter_create(dtree_ctx_t *ctx);
+
+/**
+ * Creates an iterator at the same position as it.
+ * Both continue with the same sequence of devices.
+ * Returns NULL on error. On error sets error state.
+ */
+dtree_iter_t *dtree_iter_clone(const dtree_iter_t *it);
+
+/**
+ * Frees the iterator. Devices returned by it stay valid
+ * until free'd by dtree_iter_dev_free().
+ */
+void dtree_iter_destroy(dtree_iter_t *it);
+
+/**
+ * The following functions behave as dtree_next(),
+ * dtree_byname(), dtree_bycompat(), dtree_byaddr(),
+ * dtree_bycpuaddr() and dtree_reset() but advance the given
+ * iterator only.
+ * Devices should be free'd by dtree_iter_dev_free().
+ */
+struct dtree_dev_t *dtree_iter_next(dtree_iter_t *it);
+struct dtree_dev_t *dtree_iter_byname(dtree_iter_t *it, const char *name);
+struct dtree_dev_t *dtree_iter_bycompat(dtree_iter_t *it, const char *compat);
+struct dtree_dev_t *dtree_iter_byaddr(dtree_iter_t *it, dtree_addr_t addr);
+struct dtree_dev_t *dtree_iter_bycpuaddr(dtree_iter_t *it, dtree_addr_t addr);
+struct dtree_dev_t *dtree_iter_byphandle(dtree_iter_t *it, uint32_t phandle);
+int  dtree_iter_reset(dtree_iter_t *it);
+void dtree_iter_dev_free(dtree_iter_t *it, struct dtree_dev_t *dev);
+
+/**
+ * Replaces the filter of the walk of the iterator (see
+ * dtree_set_filter(), NULL walks the whole tree). It applies
+ * to the nodes the iterator has not entered yet, set it right
+ * after the creation or a reset. Only the streaming walks
+ * (procfs and blobs) can filter their iterators.
+ *
+ * Returns 0 on success. On error sets error state
+ * (ENOTSUP when the tree does not support it).
+ */
+int dtree_iter_set_filter(dtree_iter_t *it, const struct dtree_filter_t *filter);
+
+
+//
+// Shared snapshots
+//
+
+/**
+ * Opaque snapshot shared by many threads. Readers query it
+ * without any locking by iterators from dtree_shared_iter().
+ * A reload builds a new snapshot off to the side and publishes
+ * it atomically, readers never wait for it and never see
+ * a partially loaded tree.
+ *
+ * Open, reload and free may be called from any thread, they
+ * are serialized among each other.
+ */
+typedef struct dtree_shared dtree_shared_t;
+
+/**
+ * Allocates a new (empty) shared snapshot.
+ * Returns NULL on error (errno is set).
+ */
+dtree_shared_t *dtree_shared_new(void);
+
+/**
+ * Drops the current snapshot and frees sh. Snapshots still
+ * held by iterators are freed by dtree_iter_destroy().
+ */
+void dtree_shared_free(dtree_shared_t *sh);
+
+/**
+ * Loads the tree at rootd (see dtree_open_snapshot())
+ * and publishes it.
+ * Returns 0 on success. On error sets error state of sh.
+ */
+int dtree_shared_open(dtree_shared_t *sh, const char *rootd);
+
+/**
+ * Loads the tree again and replaces the published snapshot.
+ * On failure the previous snapshot stays published.
+ * Returns 0 on success. On error sets error state of sh.
+ */
+int dtree_shared_reload(dtree_shared_t *sh);
+
+/**
+ * Sets the number of threads loading the tree by the next
+ * open or reload (see dtree_set_threads()).
+ */
+void dtree_shared_set_threads(dtree_shared_t *sh, unsigned threads);
+
+/**
+ * Creates an iterator over the currently published snapshot.
+ * The iterator keeps the snapshot alive until destroyed,
+ * reloads are not visible through it. Use the dtree_iter_*()
+ * functions to query it. Every thread needs its own iterator.
+ *
+ * Does not touch the error state of sh (errors of iterators
+ * over shared snapshots are not recorded anywhere).
+ * Returns NULL on error (errno is set).
+ */
+dtree_iter_t *dtree_shared_iter(dtree_shared_t *sh);
+
+/**
+ * Statistics of the currently published snapshot.
+ */
+void dtree_shared_stats(dtree_shared_t *sh, struct dtree_stats_t *stats);
+
+/**
+ * Error state of the last open or reload.
+ */
+int dtree_shared_iserror(const dtree_shared_t *sh);
+const char *dtree_shared_errstr(const dtree_shared_t *sh);
+
 #endif
@@ -0,0 +1,110 @@
+/**
+ * dtree_arena.c
+ */
+
+#include "dtree_arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_CHUNK_SIZE 4096
+#define ARENA_ALIGN      (2 * sizeof(void *))
+
+/**
+ * Every allocation is preceded by ARENA_ALIGN bytes holding
+ * the pointer to its chunk.
+ */
+struct dtree_arena_chunk {
+	struct dtree_arena_chunk *prev;
+	struct dtree_arena_chunk *next;
+	size_t size;
+	size_t used;
+	size_t live;
+	char  *data;
+};
+
+static inline
+size_t arena_align(size_t len)
+{
+	return (len + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+static
+struct dtree_arena_chunk *chunk_new(struct dtree_arena *a, size_t len)
+{
+	const size_t head = arena_align(sizeof(struct dtree_arena_chunk));
+	const size_t size = len > ARENA_CHUNK_SIZE - head? len : ARENA_CHUNK_SIZE - head;
+
+	struct dtree_arena_chunk *chunk = malloc(head + size);
+	if(chunk == NULL)
+		return NULL;
+
+	chunk->prev = a->chunk;
+	chunk->next = NULL;
+	chunk->size = size;
+	chunk->used = 0;
+	chunk->live = 0;
+	chunk->data = (char *) chunk + head;
+
+	if(a->chunk != NULL)
+		a->chunk->next = chunk;
+
+	a->chunk = chunk;
+	return chunk;
+}
+
+void *dtree_arena_alloc(struct dtree_arena *a, size_t len)
+{
+	struct dtree_arena_chunk *chunk = a->chunk;
+	len = ARENA_ALIGN + arena_align(len);
+
+	if(chunk == NULL || chunk->size - chunk->used < len) {
+		chunk = chunk_new(a, len);
+		if(chunk == NULL)
+			return NULL;
+	}
+
+	char *p = chunk->data + chunk->used;
+	chunk->used += len;
+	chunk->live += 1;
+
+	*(struct dtree_arena_chunk **) p = chunk;
+	return p + ARENA_ALIGN;
+}
+
+void dtree_arena_release(struct dtree_arena *a, void *p)
+{
+	if(p == NULL)
+		return;
+
+	struct dtree_arena_chunk *chunk = *(struct dtree_arena_chunk **) ((char *) p - ARENA_ALIGN);
+
+	chunk->live -= 1;
+	if(chunk->live > 0)
+		return;
+
+	if(chunk == a->chunk) {
+		chunk->used = 0;
+		return;
+	}
+
+	// not the newest one, thus chunk->next is set
+	chunk->next->prev = chunk->prev;
+	if(chunk->prev != NULL)
+		chunk->prev->next = chunk->next;
+
+	free(chunk);
+}
+
+void dtree_arena_free(struct dtree_arena *a)
+{
+	struct dtree_arena_chunk *chunk = a->chunk;
+
+	while(chunk != NULL) {
+		struct dtree_arena_chunk *prev = chunk->prev;
+		free(chunk);
+		chunk = prev;
+	}
+
+	memset(a, 0, sizeof(struct dtree_arena));
+}
@@ -0,0 +1,43 @@
+/**
+ * Internal arena allocator of device records.
+ * Non-public API.
+ */
+
+#ifndef DTREE_ARENA
+#define DTREE_ARENA
+
+#include <stddef.h>
+
+struct dtree_arena_chunk;
+
+/**
+ * Bump allocator backed by a list of chunks. Allocations
+ * are not freed one by one. Every chunk counts its live
+ * allocations and when the last one is released the chunk
+ * is freed (the newest chunk is rewound and kept for reuse).
+ * Thus the common pattern (next, use, free) runs in a single
+ * chunk without touching malloc at all and a kept allocation
+ * pins only its own chunk.
+ */
+struct dtree_arena {
+	struct dtree_arena_chunk *chunk;
+};
+
+/**
+ * Allocates len bytes aligned for any type.
+ * Returns NULL on error (errno is set).
+ */
+void *dtree_arena_alloc(struct dtree_arena *a, size_t len);
+
+/**
+ * Releases an allocation. The memory is reclaimed when
+ * all allocations of its chunk have been released.
+ */
+void dtree_arena_release(struct dtree_arena *a, void *p);
+
+/**
+ * Frees all the memory of the arena at once.
+ */
+void dtree_arena_free(struct dtree_arena *a);
+
+#endif
@@ -0,0 +1,127 @@
+/**
+ * Internal interface of device tree implementations.
+ * Non-public API.
+ */
+
+#ifndef DTREE_BACKEND
+#define DTREE_BACKEND
+
+#include "dtree.h"
+#include "dtree_error.h"
+
+/**
+ * Returned by byrange on an error not stored
+ * into the error state (errno is set).
+ */
+#define DTREE_RANGE_FAILED ((size_t) -1)
+
+/**
+ * Options of an open. They are kept by the context
+ * and passed to every open.
+ */
+struct dtree_opts {
+	/**
+	 * Number of threads loading a snapshot,
+	 * 0 or 1 loads sequentially.
+	 */
+	unsigned threads;
+
+	/**
+	 * Number of devices the pipelined walk prepares
+	 * ahead of the consumer, 0 walks synchronously.
+	 */
+	unsigned pipeline;
+
+	/**
+	 * Enables batched property reads by io_uring
+	 * in procfs, 0 uses the plain syscalls.
+	 */
+	int uring;
+
+	/**
+	 * Fills the property table of devices,
+	 * 0 leaves it empty.
+	 */
+	int props;
+
+	/**
+	 * Walks return nodes without reg that have a phandle
+	 * (providers like fixed clocks) as devices with no
+	 * ranges, 0 returns only nodes with reg.
+	 */
+	int providers;
+
+	/**
+	 * Filter of the walk, the zeroed one
+	 * walks the whole tree.
+	 */
+	struct dtree_filter_t filter;
+};
+
+/**
+ * Operations of an implementation (backend).
+ *
+ * Every opened tree is an instance (state) of a backend,
+ * the open returns it and all other operations get it.
+ * Errors are reported into the error state given to open.
+ * On failure open returns NULL having released everything.
+ *
+ * Iteration is driven by cursors (iter). A cursor is created
+ * at the beginning of the tree by iter_new or as a copy of
+ * another one by iter_clone (both return NULL on error with
+ * errno set). Cursors of the same state are independent,
+ * they must be free'd before close. The shared iterator
+ * of a context is just one of them.
+ *
+ * The open, close, iter_*, next, reset and dev_free are
+ * mandatory. The lookup operations are optional (can be NULL).
+ * When present they replace the generic linear search over next
+ * and must have the same semantics (advance the given cursor,
+ * the *_all variants and byphandle do not use any). The address
+ * lookups test all ranges of a device in the address space of its
+ * bus or (cpu non-zero) in the CPU address space. The byrange of a
+ * state shared by threads returns DTREE_RANGE_FAILED with errno set
+ * instead of touching the error state, the caller reports it.
+ * The stats fills the backend specific statistics (optional).
+ * The filter replaces the filter of the cursor (optional, the cursors
+ * can not be filtered when NULL, returns non-zero with the error set).
+ */
+struct dtree_backend {
+	const char *name;
+
+	void *(*open)(const char *rootd, const struct dtree_opts *opts, struct dtree_error *err);
+	void  (*close)(void *state);
+
+	void *(*iter_new)(void *state);
+	void *(*iter_clone)(void *state, const void *iter);
+	void  (*iter_free)(void *state, void *iter);
+
+	struct dtree_dev_t *(*next)(void *state, void *iter);
+	int   (*reset)(void *state, void *iter);
+	void  (*dev_free)(void *state, struct dtree_dev_t *dev);
+
+	struct dtree_dev_t *(*byname)(void *state, void *iter, const char *name);
+	size_t (*byname_all)(void *state, const char *name, struct dtree_dev_t **devs, size_t max);
+	struct dtree_dev_t *(*bycompat)(void *state, void *iter, const char *compat);
+	size_t (*bycompat_all)(void *state, const char *compat, struct dtree_dev_t **devs, size_t max);
+	struct dtree_dev_t *(*byaddr)(void *state, void *iter, dtree_addr_t addr, int cpu);
+	size_t (*byrange)(void *state, dtree_addr_t lo, dtree_addr_t hi, int cpu,
+			struct dtree_dev_t **devs, size_t max);
+	struct dtree_dev_t *(*byphandle)(void *state, uint32_t phandle);
+
+	void (*stats)(void *state, struct dtree_stats_t *stats);
+	int  (*filter)(void *state, void *iter, const struct dtree_filter_t *filter);
+};
+
+extern const struct dtree_backend dtree_procfs_backend;
+extern const struct dtree_backend dtree_fdt_backend;
+extern const struct dtree_backend dtree_snapshot_backend;
+extern const struct dtree_backend dtree_pipe_backend;
+
+/**
+ * Chooses the backend able to read the given path:
+ * fdt for regular files, procfs otherwise.
+ */
+const struct dtree_backend *dtree_backend_detect(const char *rootd);
+
+#endif
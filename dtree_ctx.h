@@ -0,0 +1,58 @@
+/**
+ * Internal representation of a context.
+ * Non-public API.
+ */
+
+#ifndef DTREE_CTX
+#define DTREE_CTX
+
+#include "dtree.h"
+#include "dtree_error.h"
+#include "dtree_backend.h"
+
+/**
+ * A context is an opened tree (the backend and its state)
+ * together with its error state. Contexts are independent
+ * of each other.
+ */
+struct dtree_ctx {
+	const struct dtree_backend *backend;
+	void *state; // NULL when not opened
+	void *iter;  // cursor used by dtree_ctx_next() and friends
+
+	/**
+	 * Duration of the last successful open in microseconds.
+	 */
+	unsigned long open_us;
+
+	struct dtree_opts opts;
+
+	struct dtree_error err;
+};
+
+struct dtree_version;
+
+/**
+ * Independent iterator over an opened context.
+ * The cursor belongs to the backend of the context.
+ */
+struct dtree_iter {
+	dtree_ctx_t *ctx;
+	void *cursor;
+
+	/**
+	 * Version of a shared snapshot the iterator keeps
+	 * alive (ctx is its context), NULL otherwise.
+	 */
+	struct dtree_version *version;
+};
+
+/**
+ * Creates an iterator over the opened ctx holding the given
+ * version (it takes over the reference). Does not touch
+ * the error state of ctx.
+ * Returns NULL on error (errno is set).
+ */
+dtree_iter_t *dtree_ctx_iter_new(dtree_ctx_t *ctx, struct dtree_version *version);
+
+#endif
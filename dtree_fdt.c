@@ -0,0 +1,944 @@
+/**
+ * dtree_fdt.c
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "dtree.h"
+#include "dtree_error.h"
+#include "dtree_fdt.h"
+#include "dtree_backend.h"
+#include "dtree_arena.h"
+#include "dtree_reg.h"
+#include "dtree_filter.h"
+#include "dtree_util.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define FDT_MAGIC       0xD00DFEED
+#define FDT_HEADER_LEN  40
+#define FDT_BEGIN_NODE  0x1
+#define FDT_END_NODE    0x2
+#define FDT_PROP        0x3
+#define FDT_NOP         0x4
+#define FDT_END         0x9
+#define FDT_MAX_DEPTH   64
+
+/**
+ * The blob is mapped into memory (or read when the file
+ * can not be mapped, eg. /sys/firmware/fdt) and walked
+ * in place. Names and compatible strings of devices
+ * point directly into the blob, devices themselves are
+ * allocated from the arena.
+ */
+struct fdt {
+	const char *blob;
+	size_t      size;
+	int         mapped;
+
+	const char *dt_struct;
+	size_t      struct_size;
+	const char *dt_strings;
+	size_t      strings_size;
+
+	/**
+	 * Translations of the buses mapping anything, in the order
+	 * of their nodes in the structure block. Created at open.
+	 */
+	struct fdt_bus *bus;
+	size_t nbus;
+
+	/**
+	 * Nodes having a phandle (devices and providers without reg)
+	 * sorted by the phandle (and by the order in the structure
+	 * block). Created at open.
+	 */
+	struct fdt_phandle *phandle;
+	size_t nphandle;
+
+	/**
+	 * Devices get the table of all their properties.
+	 */
+	int props;
+
+	/**
+	 * Walks return the providers (nodes without
+	 * reg that have a phandle) too.
+	 */
+	int providers;
+
+	/**
+	 * Filter every new cursor starts with. The table of phandles
+	 * has no device rejected by it.
+	 */
+	struct dtree_filter_t filter;
+
+	struct dtree_arena arena;
+	struct dtree_error *err;
+};
+
+/**
+ * Translation of the addresses of children of the node at pos
+ * (offset of its FDT_BEGIN_NODE).
+ */
+struct fdt_bus {
+	size_t pos;
+	const struct dtree_xlat *xlat;
+};
+
+/**
+ * Bus properties of an open node: cells laying out reg of its
+ * children and the translation of their addresses.
+ */
+struct fdt_level {
+	unsigned char cells[2];
+	const struct dtree_xlat *xlat;
+};
+
+/**
+ * Device at pos (offset of its FDT_BEGIN_NODE) having the phandle
+ * and the bus properties of its parent.
+ */
+struct fdt_phandle {
+	uint32_t phandle;
+	size_t   pos;
+	struct fdt_level parent;
+};
+
+/**
+ * Cursor of the walk over the structure block.
+ */
+struct fdt_iter {
+	size_t pos;   // offset of the next token in the structure block
+	size_t depth; // depth of the node at pos (root is 1)
+	int    done;
+	size_t bus;   // next of fdt->bus
+
+	struct fdt_level level[FDT_MAX_DEPTH]; // of the open nodes (by depth - 1)
+
+	struct dtree_filter_t filter;
+};
+
+static inline
+uint32_t fdt32(const void *p)
+{
+	const unsigned char *b = (const unsigned char *) p;
+	return ((uint32_t) b[0] << 24) | ((uint32_t) b[1] << 16)
+	     | ((uint32_t) b[2] << 8)  |  (uint32_t) b[3];
+}
+
+static inline
+size_t fdt_align(size_t off)
+{
+	return (off + 3) & ~((size_t) 3);
+}
+
+static
+int fdt_bad(struct fdt *fdt)
+{
+	dtree_error_set(fdt->err, DTREE_EBAD_FDT);
+	return 1;
+}
+
+static
+void *blob_read(int fd, size_t *size)
+{
+	size_t cap = *size > 0? *size : 4096;
+	size_t len = 0;
+	char *m = NULL;
+
+	for(;;) {
+		char *tmp = realloc(m, cap);
+		if(tmp == NULL) {
+			free(m);
+			return NULL;
+		}
+		m = tmp;
+
+		ssize_t rlen = read(fd, m + len, cap - len);
+		if(rlen < 0) {
+			free(m);
+			return NULL;
+		}
+		if(rlen == 0)
+			break;
+
+		len += rlen;
+		if(len == cap)
+			cap *= 2;
+	}
+
+	*size = len;
+	return m;
+}
+
+static
+int blob_load(struct fdt *fdt, const char *path)
+{
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+		return 1;
+
+	struct stat st;
+	if(fstat(fd, &st)) {
+		close(fd);
+		return 1;
+	}
+
+	fdt->size = st.st_size;
+
+	if(fdt->size > 0) {
+		void *m = mmap(NULL, fdt->size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(m != MAP_FAILED) {
+			close(fd);
+			fdt->blob   = m;
+			fdt->mapped = 1;
+			return 0;
+		}
+	}
+
+	// eg. sysfs binary attributes can not be mapped
+	fdt->blob   = blob_read(fd, &fdt->size);
+	fdt->mapped = 0;
+	close(fd);
+
+	return fdt->blob == NULL;
+}
+
+static
+void blob_unload(struct fdt *fdt)
+{
+	if(fdt->blob == NULL)
+		return;
+
+	if(fdt->mapped)
+		munmap((void *) fdt->blob, fdt->size);
+	else
+		free((void *) fdt->blob);
+
+	fdt->blob = NULL;
+}
+
+static
+int header_check(struct fdt *fdt)
+{
+	if(fdt->size < FDT_HEADER_LEN || fdt32(fdt->blob) != FDT_MAGIC)
+		return fdt_bad(fdt);
+
+	const uint32_t totalsize  = fdt32(fdt->blob + 4);
+	const uint32_t off_struct = fdt32(fdt->blob + 8);
+	const uint32_t off_string = fdt32(fdt->blob + 12);
+	const uint32_t version    = fdt32(fdt->blob + 20);
+	const uint32_t last_comp  = fdt32(fdt->blob + 24);
+	const uint32_t size_str   = fdt32(fdt->blob + 32);
+
+	if(totalsize > fdt->size || version < 16 || last_comp > 17)
+		return fdt_bad(fdt);
+
+	if(off_struct >= totalsize || off_string > totalsize || size_str > totalsize - off_string)
+		return fdt_bad(fdt);
+
+	size_t size_struct = totalsize - off_struct;
+	if(version >= 17) {
+		size_struct = fdt32(fdt->blob + 36);
+		if(size_struct > totalsize - off_struct)
+			return fdt_bad(fdt);
+	}
+
+	fdt->dt_struct    = fdt->blob + off_struct;
+	fdt->struct_size  = size_struct;
+	fdt->dt_strings   = fdt->blob + off_string;
+	fdt->strings_size = size_str;
+	return 0;
+}
+
+static
+int fdt_index(struct fdt *fdt);
+
+void *dtree_fdt_open(const char *path, const struct dtree_opts *opts, struct dtree_error *err)
+{
+	if(path == NULL) {
+		dtree_error_set(err, EINVAL);
+		return NULL;
+	}
+
+	struct fdt *fdt = calloc(1, sizeof(struct fdt));
+	if(fdt == NULL) {
+		dtree_error_from_errno(err);
+		return NULL;
+	}
+
+	fdt->err    = err;
+	fdt->props  = opts->props;
+	fdt->providers = opts->providers;
+	fdt->filter = opts->filter;
+
+	if(blob_load(fdt, path)) {
+		dtree_error_from_errno(err);
+		free(fdt);
+		return NULL;
+	}
+
+	if(header_check(fdt) || fdt_index(fdt)) {
+		dtree_fdt_close(fdt);
+		return NULL;
+	}
+
+	return fdt;
+}
+
+void dtree_fdt_close(void *state)
+{
+	struct fdt *fdt = (struct fdt *) state;
+
+	for(size_t i = 0; i < fdt->nbus; ++i)
+		dtree_xlat_free(fdt->bus[i].xlat);
+
+	free(fdt->bus);
+	free(fdt->phandle);
+	blob_unload(fdt);
+	dtree_arena_free(&fdt->arena);
+	free(fdt);
+}
+
+void *dtree_fdt_iter_new(void *state)
+{
+	struct fdt *fdt = (struct fdt *) state;
+
+	struct fdt_iter *it = calloc(1, sizeof(struct fdt_iter));
+	if(it != NULL)
+		it->filter = fdt->filter;
+
+	return it;
+}
+
+void *dtree_fdt_iter_clone(void *state, const void *iter)
+{
+	(void) state;
+
+	struct fdt_iter *it = malloc(sizeof(struct fdt_iter));
+	if(it != NULL)
+		memcpy(it, iter, sizeof(struct fdt_iter));
+
+	return it;
+}
+
+void dtree_fdt_iter_free(void *state, void *iter)
+{
+	(void) state;
+	free(iter);
+}
+
+int dtree_fdt_reset(void *state, void *iter)
+{
+	struct fdt_iter *it = (struct fdt_iter *) iter;
+	(void) state;
+
+	it->pos   = 0;
+	it->depth = 0;
+	it->done  = 0;
+	it->bus   = 0;
+	return 0;
+}
+
+static
+int fdt_token(struct fdt *fdt, struct fdt_iter *it, uint32_t *tok)
+{
+	if(it->pos + 4 > fdt->struct_size)
+		return fdt_bad(fdt);
+
+	*tok = fdt32(fdt->dt_struct + it->pos);
+	it->pos += 4;
+	return 0;
+}
+
+/**
+ * Reads the name of a node starting at pos.
+ */
+static
+const char *fdt_node_name(struct fdt *fdt, struct fdt_iter *it)
+{
+	const char *name = fdt->dt_struct + it->pos;
+	const size_t max = fdt->struct_size - it->pos;
+	const size_t len = strnlen(name, max);
+
+	if(len == max) {
+		fdt_bad(fdt);
+		return NULL;
+	}
+
+	it->pos = fdt_align(it->pos + len + 1);
+	return name;
+}
+
+/**
+ * Property of a node (pointing into the blob, data is NULL
+ * when the node does not have it).
+ */
+struct fdt_prop {
+	const char *data;
+	uint32_t    len;
+};
+
+/**
+ * Properties of a node the library is interested in.
+ */
+struct fdt_props {
+	struct fdt_prop reg;
+	struct fdt_prop compat;
+	struct fdt_prop ranges;
+	struct fdt_prop status;
+	uint32_t phandle; // 0 when the node has none
+
+	size_t first; // offset of the first property
+	size_t count; // number of properties
+	size_t cells; // number of #*-cells properties
+};
+
+/**
+ * Consumes all properties of the node at pos and remembers
+ * reg, compatible, ranges, status and the phandle. The cells of the node (the layout
+ * of reg of its children) are stored into cells.
+ */
+static
+int fdt_node_props(struct fdt *fdt, struct fdt_iter *it,
+		struct fdt_props *props, unsigned char cells[2])
+{
+	memset(props, 0, sizeof(struct fdt_props));
+	cells[0] = DTREE_ADDR_CELLS;
+	cells[1] = DTREE_SIZE_CELLS;
+	props->first = it->pos;
+
+	while(it->pos + 4 <= fdt->struct_size) {
+		const uint32_t tok = fdt32(fdt->dt_struct + it->pos);
+
+		if(tok == FDT_NOP) {
+			it->pos += 4;
+			continue;
+		}
+
+		if(tok != FDT_PROP)
+			return 0;
+
+		if(it->pos + 12 > fdt->struct_size)
+			return fdt_bad(fdt);
+
+		const uint32_t len     = fdt32(fdt->dt_struct + it->pos + 4);
+		const uint32_t nameoff = fdt32(fdt->dt_struct + it->pos + 8);
+		const size_t   data    = it->pos + 12;
+
+		if(len > fdt->struct_size - data || nameoff >= fdt->strings_size)
+			return fdt_bad(fdt);
+
+		const char *name = fdt->dt_strings + nameoff;
+		if(strnlen(name, fdt->strings_size - nameoff) == fdt->strings_size - nameoff)
+			return fdt_bad(fdt);
+
+		props->count += 1;
+
+		if(prop_is_cells(name))
+			props->cells += 1;
+
+		if(!strcmp(name, "reg")) {
+			props->reg.data = fdt->dt_struct + data;
+			props->reg.len  = len;
+		}
+		else if(!strcmp(name, "compatible")) {
+			props->compat.data = fdt->dt_struct + data;
+			props->compat.len  = len;
+		}
+		else if(!strcmp(name, "ranges")) {
+			props->ranges.data = fdt->dt_struct + data;
+			props->ranges.len  = len;
+		}
+		else if(!strcmp(name, "status")) {
+			props->status.data = fdt->dt_struct + data;
+			props->status.len  = len;
+		}
+		else if(len == 4 && (!strcmp(name, "phandle")
+					|| (!strcmp(name, "linux,phandle") && props->phandle == 0))) {
+			props->phandle = fdt32(fdt->dt_struct + data);
+		}
+		else if(!strcmp(name, "#address-cells")) {
+			cells[0] = (unsigned char) dtree_cells_decode(fdt->dt_struct + data, len, DTREE_ADDR_CELLS);
+		}
+		else if(!strcmp(name, "#size-cells")) {
+			cells[1] = (unsigned char) dtree_cells_decode(fdt->dt_struct + data, len, DTREE_SIZE_CELLS);
+		}
+
+		it->pos = fdt_align(data + len);
+	}
+
+	return fdt_bad(fdt);
+}
+
+/**
+ * Whether the node of the name at the depth (root is 1) and
+ * its subtree are rejected by the filter. Props are NULL
+ * when they were not read yet (only the name is tested).
+ */
+static
+int fdt_filtered(const struct dtree_filter_t *f, const char *name, size_t depth,
+		const struct fdt_props *props)
+{
+	if(depth <= 1)
+		return 0;
+
+	if(props == NULL)
+		return dtree_filter_skips(f, name, depth - 1);
+
+	return dtree_filter_disabled(f, props->status.data, props->status.len);
+}
+
+/**
+ * Skips the rest of the node the cursor stands in (behind its
+ * name or properties) with all its children, their properties
+ * are not even looked at. Translations of the skipped buses
+ * are passed over.
+ */
+static
+int fdt_skip_node(struct fdt *fdt, struct fdt_iter *it)
+{
+	size_t open = 1;
+
+	while(open > 0) {
+		uint32_t tok;
+		if(fdt_token(fdt, it, &tok))
+			return 1;
+
+		switch(tok) {
+		case FDT_BEGIN_NODE:
+			if(fdt_node_name(fdt, it) == NULL)
+				return 1;
+			open += 1;
+			break;
+
+		case FDT_END_NODE:
+			open -= 1;
+			break;
+
+		case FDT_PROP: {
+			if(it->pos + 8 > fdt->struct_size)
+				return fdt_bad(fdt);
+
+			const uint32_t len = fdt32(fdt->dt_struct + it->pos);
+			if(len > fdt->struct_size - it->pos - 8)
+				return fdt_bad(fdt);
+
+			it->pos = fdt_align(it->pos + 8 + len);
+			break;
+		}
+
+		case FDT_NOP:
+			break;
+
+		default:
+			return fdt_bad(fdt);
+		}
+	}
+
+	while(it->bus < fdt->nbus && fdt->bus[it->bus].pos < it->pos)
+		it->bus += 1;
+
+	return 0;
+}
+
+/**
+ * Fills the table of all properties of the node (validated
+ * by fdt_node_props() already) pointing into the blob, or
+ * only of its #*-cells when not all.
+ */
+static
+void fdt_fill_props(struct fdt *fdt, const struct fdt_props *props, int all,
+		struct dtree_prop_t *table)
+{
+	size_t pos = props->first;
+
+	for(size_t i = 0, p = 0; i < props->count; ) {
+		if(fdt32(fdt->dt_struct + pos) == FDT_NOP) {
+			pos += 4;
+			continue;
+		}
+
+		const uint32_t len = fdt32(fdt->dt_struct + pos + 4);
+		const char *name = fdt->dt_strings + fdt32(fdt->dt_struct + pos + 8);
+
+		if(all || prop_is_cells(name)) {
+			table[p].name  = name;
+			table[p].value = fdt->dt_struct + pos + 12;
+			table[p].len   = len;
+			p += 1;
+		}
+
+		pos = fdt_align(pos + 12 + len);
+		i += 1;
+	}
+}
+
+/**
+ * Builds the device of nreg ranges of reg laid out and translated
+ * by the parent bus. Only the ranges, their CPU addresses, the array
+ * of compat pointers and the property table are allocated (together
+ * with the dev itself) in the arena, strings and values point into
+ * the blob. Without the table (disabled) a device having a phandle
+ * still gets its #*-cells there.
+ */
+static
+struct dtree_dev_t *dev_from_node(struct fdt *fdt, const char *name,
+		const struct fdt_props *props, size_t nreg, const struct fdt_level *parent)
+{
+	const struct fdt_prop *reg    = &props->reg;
+	const struct fdt_prop *compat = &props->compat;
+
+	size_t entries = 0;
+	for(uint32_t i = 0; i < compat->len; ++i) {
+		if(compat->data[i] == '\0')
+			entries += 1;
+	}
+
+	const size_t nprops = fdt->props? props->count : props->phandle != 0? props->cells : 0;
+	const size_t len = sizeof(struct dtree_dev_t) + nreg * sizeof(struct dtree_reg_t)
+	                 + nreg * sizeof(dtree_addr_t) + (entries + 1) * sizeof(char *)
+	                 + nprops * sizeof(struct dtree_prop_t);
+	struct dtree_dev_t *dev = dtree_arena_alloc(&fdt->arena, len);
+	if(dev == NULL) {
+		dtree_error_from_errno(fdt->err);
+		return NULL;
+	}
+
+	struct dtree_reg_t *ranges = (struct dtree_reg_t *) (dev + 1);
+	dtree_addr_t *cpu = (dtree_addr_t *) (ranges + nreg);
+	const char **array = (const char **) (cpu + nreg);
+	struct dtree_prop_t *table = (struct dtree_prop_t *) (array + entries + 1);
+
+	dtree_reg_decode(reg->data, nreg, parent->cells[0], parent->cells[1], ranges);
+
+	for(size_t i = 0; i < nreg; ++i)
+		cpu[i] = dtree_xlat_addr(parent->xlat, ranges[i].base);
+
+	size_t off = 0;
+
+	for(size_t i = 0; i < entries; ++i) {
+		array[i] = compat->data + off;
+		off += strlen(array[i]) + 1;
+	}
+	array[entries] = NULL;
+
+	dev->name   = name;
+	dev->base   = nreg > 0? ranges[0].base : 0;
+	dev->high   = nreg > 0? ranges[0].base + ranges[0].size - 1 : 0;
+	dev->compat = array;
+	dev->reg    = ranges;
+	dev->nreg   = nreg;
+	dev->cpu    = cpu;
+	dev->phandle = props->phandle;
+	dev->props  = nprops > 0? table : NULL;
+	dev->nprops = nprops;
+
+	if(nprops > 0)
+		fdt_fill_props(fdt, props, fdt->props, table);
+
+	return dev;
+}
+
+static
+int bus_add(struct fdt *fdt, size_t pos, const struct dtree_xlat *xlat, size_t *cap)
+{
+	if(fdt->nbus == *cap) {
+		const size_t ncap = *cap > 0? 2 * *cap : 16;
+		struct fdt_bus *bus = realloc(fdt->bus, ncap * sizeof(struct fdt_bus));
+		if(bus == NULL)
+			return 1;
+
+		fdt->bus = bus;
+		*cap     = ncap;
+	}
+
+	fdt->bus[fdt->nbus].pos  = pos;
+	fdt->bus[fdt->nbus].xlat = xlat;
+	fdt->nbus += 1;
+	return 0;
+}
+
+static
+int phandle_add(struct fdt *fdt, uint32_t phandle, size_t pos,
+		const struct fdt_level *parent, size_t *cap)
+{
+	if(fdt->nphandle == *cap) {
+		const size_t ncap = *cap > 0? 2 * *cap : 16;
+		struct fdt_phandle *ph = realloc(fdt->phandle, ncap * sizeof(struct fdt_phandle));
+		if(ph == NULL)
+			return 1;
+
+		fdt->phandle = ph;
+		*cap         = ncap;
+	}
+
+	fdt->phandle[fdt->nphandle].phandle = phandle;
+	fdt->phandle[fdt->nphandle].pos     = pos;
+	fdt->phandle[fdt->nphandle].parent  = *parent;
+	fdt->nphandle += 1;
+	return 0;
+}
+
+static
+int phandle_cmp(const void *a, const void *b)
+{
+	const struct fdt_phandle *x = (const struct fdt_phandle *) a;
+	const struct fdt_phandle *y = (const struct fdt_phandle *) b;
+
+	if(x->phandle != y->phandle)
+		return x->phandle < y->phandle? -1 : 1;
+
+	return x->pos < y->pos? -1 : x->pos > y->pos;
+}
+
+/**
+ * Walks the whole structure block once and creates the translations
+ * of all buses (composed with their ancestors) and the table of nodes
+ * having a phandle. A malformed block is reported by the walk when
+ * it gets there, the index just stops.
+ */
+static
+int fdt_index(struct fdt *fdt)
+{
+	struct fdt_iter it;
+	size_t cap = 0;
+	size_t phcap = 0;
+	size_t skip = 0; // depth of the filtered subtree
+
+	memset(&it, 0, sizeof(it));
+
+	while(!it.done) {
+		uint32_t tok;
+		if(fdt_token(fdt, &it, &tok))
+			break;
+
+		if(tok == FDT_BEGIN_NODE) {
+			struct fdt_props props;
+			const size_t pos = it.pos - 4;
+
+			const char *name = fdt_node_name(fdt, &it);
+			if(name == NULL || ++it.depth > FDT_MAX_DEPTH)
+				break;
+
+			struct fdt_level *level = &it.level[it.depth - 1];
+			if(fdt_node_props(fdt, &it, &props, level->cells))
+				break;
+
+			// buses are indexed whole, cursors may filter another way
+			if(skip == 0 && (fdt_filtered(&fdt->filter, name, it.depth, NULL)
+						|| fdt_filtered(&fdt->filter, name, it.depth, &props)))
+				skip = it.depth;
+
+			// children of the root use CPU addresses
+			level->xlat = &dtree_xlat_identity;
+
+			if(it.depth > 1) {
+				const struct fdt_level *parent = &it.level[it.depth - 2];
+
+				level->xlat = dtree_xlat_new(parent->xlat, props.ranges.data, props.ranges.len,
+						level->cells[0], parent->cells[0], level->cells[1]);
+				if(level->xlat == NULL) {
+					dtree_error_from_errno(fdt->err);
+					return 1;
+				}
+			}
+
+			if(level->xlat != &dtree_xlat_none && bus_add(fdt, pos, level->xlat, &cap)) {
+				dtree_xlat_free(level->xlat);
+				dtree_error_from_errno(fdt->err);
+				return 1;
+			}
+
+			// the nodes dtree_fdt_next() passes, with reg or without
+			if(skip == 0 && it.depth > 1 && props.phandle != 0
+					&& phandle_add(fdt, props.phandle, pos, &it.level[it.depth - 2], &phcap)) {
+				dtree_error_from_errno(fdt->err);
+				return 1;
+			}
+		}
+		else if(tok == FDT_END_NODE) {
+			if(it.depth == 0)
+				break;
+
+			if(it.depth == skip)
+				skip = 0;
+
+			it.depth -= 1;
+		}
+		else if(tok == FDT_END) {
+			it.done = 1;
+		}
+		else if(tok != FDT_NOP) {
+			break;
+		}
+	}
+
+	if(fdt->nphandle > 1)
+		qsort(fdt->phandle, fdt->nphandle, sizeof(struct fdt_phandle), phandle_cmp);
+
+	dtree_error_clear(fdt->err);
+	return 0;
+}
+
+struct dtree_dev_t *dtree_fdt_next(void *state, void *iter)
+{
+	struct fdt *fdt = (struct fdt *) state;
+	struct fdt_iter *it = (struct fdt_iter *) iter;
+	struct dtree_dev_t *dev = NULL;
+
+	while(dev == NULL && !it->done) {
+		uint32_t tok;
+		if(fdt_token(fdt, it, &tok))
+			return NULL;
+
+		switch(tok) {
+		case FDT_BEGIN_NODE: {
+			struct fdt_props props;
+			const size_t pos = it->pos - 4;
+
+			const char *name = fdt_node_name(fdt, it);
+			if(name == NULL)
+				return NULL;
+
+			// rejected by name or depth before any property is read
+			if(fdt_filtered(&it->filter, name, it->depth + 1, NULL)) {
+				if(fdt_skip_node(fdt, it))
+					return NULL;
+				break;
+			}
+
+			it->depth += 1;
+			if(it->depth > FDT_MAX_DEPTH) {
+				fdt_bad(fdt);
+				return NULL;
+			}
+
+			struct fdt_level *level = &it->level[it->depth - 1];
+			if(fdt_node_props(fdt, it, &props, level->cells))
+				return NULL;
+
+			if(fdt_filtered(&it->filter, name, it->depth, &props)) {
+				it->depth -= 1;
+				if(fdt_skip_node(fdt, it))
+					return NULL;
+				break;
+			}
+
+			// prepared by fdt_index() in the same order
+			level->xlat = &dtree_xlat_none;
+			if(it->bus < fdt->nbus && fdt->bus[it->bus].pos == pos)
+				level->xlat = fdt->bus[it->bus++].xlat;
+
+			// the root is never a device, reg is laid out by the parent
+			if(it->depth > 1) {
+				const struct fdt_level *parent = &it->level[it->depth - 2];
+				const size_t nreg = props.reg.data == NULL? 0
+					: dtree_reg_count(props.reg.len, parent->cells[0], parent->cells[1]);
+
+				if(nreg > 0 || (fdt->providers && props.phandle != 0)) {
+					dev = dev_from_node(fdt, name, &props, nreg, parent);
+					if(dev == NULL)
+						return NULL;
+				}
+			}
+			break;
+		}
+
+		case FDT_END_NODE:
+			if(it->depth == 0) {
+				fdt_bad(fdt);
+				return NULL;
+			}
+
+			it->depth -= 1;
+			break;
+
+		case FDT_NOP:
+			break;
+
+		case FDT_END:
+			it->done = 1;
+			break;
+
+		default:
+			fdt_bad(fdt);
+			return NULL;
+		}
+	}
+
+	return dev;
+}
+
+struct dtree_dev_t *dtree_fdt_byphandle(void *state, uint32_t phandle)
+{
+	struct fdt *fdt = (struct fdt *) state;
+	size_t lo = 0;
+	size_t hi = fdt->nphandle;
+
+	// the first of the devices having the phandle
+	while(lo < hi) {
+		const size_t mid = lo + (hi - lo) / 2;
+
+		if(fdt->phandle[mid].phandle < phandle)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if(lo == fdt->nphandle || fdt->phandle[lo].phandle != phandle)
+		return NULL;
+
+	const struct fdt_phandle *ph = &fdt->phandle[lo];
+	struct fdt_iter it;
+	struct fdt_props props;
+	unsigned char cells[2];
+
+	// validated by fdt_index() already
+	it.pos = ph->pos + 4;
+	const char *name = fdt_node_name(fdt, &it);
+	fdt_node_props(fdt, &it, &props, cells);
+
+	// a provider has no reg
+	const size_t nreg = props.reg.data == NULL? 0
+		: dtree_reg_count(props.reg.len, ph->parent.cells[0], ph->parent.cells[1]);
+	return dev_from_node(fdt, name, &props, nreg, &ph->parent);
+}
+
+int dtree_fdt_filter(void *state, void *iter, const struct dtree_filter_t *filter)
+{
+	(void) state;
+
+	((struct fdt_iter *) iter)->filter = *filter;
+	return 0;
+}
+
+void dtree_fdt_dev_free(void *state, struct dtree_dev_t *dev)
+{
+	struct fdt *fdt = (struct fdt *) state;
+
+	assert(dev != NULL);
+	dtree_arena_release(&fdt->arena, dev);
+}
+
+const struct dtree_backend dtree_fdt_backend = {
+	.name       = "fdt",
+	.open       = dtree_fdt_open,
+	.close      = dtree_fdt_close,
+	.iter_new   = dtree_fdt_iter_new,
+	.iter_clone = dtree_fdt_iter_clone,
+	.iter_free  = dtree_fdt_iter_free,
+	.next       = dtree_fdt_next,
+	.reset      = dtree_fdt_reset,
+	.dev_free   = dtree_fdt_dev_free,
+	.byphandle  = dtree_fdt_byphandle,
+	.filter     = dtree_fdt_filter,
+};
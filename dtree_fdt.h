@@ -0,0 +1,62 @@
+/**
+ * Internal flattened device tree (FDT) implementation.
+ * Non-public API.
+ */
+
+#ifndef DTREE_FDT
+#define DTREE_FDT
+
+#include <stdint.h>
+
+struct dtree_opts;
+struct dtree_error;
+
+/**
+ * Opens the flattened device tree blob at the given
+ * path (eg. /sys/firmware/fdt or a .dtb file).
+ *
+ * Initializes internal structures. Does not
+ * clear error flag. Returns the state of the
+ * opened blob or NULL on error (set in err).
+ */
+void *dtree_fdt_open(const char *path, const struct dtree_opts *opts, struct dtree_error *err);
+
+/**
+ * Free's all resources.
+ */
+void dtree_fdt_close(void *state);
+
+/**
+ * Cursors over the blob (an offset into it).
+ */
+void *dtree_fdt_iter_new(void *state);
+void *dtree_fdt_iter_clone(void *state, const void *iter);
+void dtree_fdt_iter_free(void *state, void *iter);
+
+/**
+ * Traversing over the blob.
+ */
+struct dtree_dev_t *dtree_fdt_next(void *state, void *iter);
+
+/**
+ * Looks up the device by the table of phandles created at open.
+ */
+struct dtree_dev_t *dtree_fdt_byphandle(void *state, uint32_t phandle);
+
+/**
+ * Sets the filter of the cursor. Rejected subtrees are passed
+ * over token by token without looking at their properties.
+ */
+int dtree_fdt_filter(void *state, void *iter, const struct dtree_filter_t *filter);
+
+/**
+ * Free of dtree_dev_t returned by fdt functions.
+ */
+void dtree_fdt_dev_free(void *state, struct dtree_dev_t *dev);
+
+/**
+ * Reset of iteration over the blob.
+ */
+int dtree_fdt_reset(void *state, void *iter);
+
+#endif
@@ -0,0 +1,36 @@
+/**
+ * dtree_filter.c
+ */
+
+#include "dtree_filter.h"
+#include "dtree_util.h"
+
+#include <string.h>
+
+int dtree_filter_none(const struct dtree_filter_t *f)
+{
+	return !f->skip_disabled && f->skip == NULL && f->max_depth == 0;
+}
+
+int dtree_filter_skips(const struct dtree_filter_t *f, const char *name, size_t depth)
+{
+	if(f->max_depth > 0 && depth > f->max_depth)
+		return 1;
+
+	for(size_t i = 0; f->skip != NULL && f->skip[i] != NULL; ++i) {
+		if(name_matches(f->skip[i], name))
+			return 1;
+	}
+
+	return 0;
+}
+
+int dtree_filter_disabled(const struct dtree_filter_t *f, const char *status, size_t len)
+{
+	if(!f->skip_disabled || status == NULL)
+		return 0;
+
+	// "ok" is the older spelling of "okay"
+	const size_t n = strnlen(status, len);
+	return !((n == 4 && !memcmp(status, "okay", 4)) || (n == 2 && !memcmp(status, "ok", 2)));
+}
@@ -0,0 +1,31 @@
+/**
+ * Internal filter of the walk.
+ * Non-public API.
+ */
+
+#ifndef DTREE_FILTER
+#define DTREE_FILTER
+
+#include "dtree.h"
+
+#include <stddef.h>
+
+/**
+ * Whether the filter walks the whole tree (nothing to test).
+ */
+int dtree_filter_none(const struct dtree_filter_t *f);
+
+/**
+ * Tests the node of the name at the depth (children of the root
+ * are at 1) against the skipped names and the depth limit. Returns
+ * non-zero when the node (and its subtree) is skipped.
+ */
+int dtree_filter_skips(const struct dtree_filter_t *f, const char *name, size_t depth);
+
+/**
+ * Whether the status property (len bytes, NULL when the node
+ * has none) makes the node skipped by the filter.
+ */
+int dtree_filter_disabled(const struct dtree_filter_t *f, const char *status, size_t len);
+
+#endif
@@ -0,0 +1,203 @@
+/**
+ * dtree_index.c
+ */
+
+#include "dtree_index.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/**
+ * The idx[off .. off + len - 1] holds the devices of key.
+ * While building, len counts pairs of the slot and last
+ * is the last device added (to avoid duplicates).
+ */
+struct dtree_index_slot {
+	const char *key;
+	uint32_t keylen;
+	uint32_t hash;
+	uint32_t off;
+	uint32_t len;
+	uint32_t last;
+};
+
+struct dtree_index_pair {
+	uint32_t slot;
+	uint32_t dev;
+};
+
+static
+uint32_t index_hash(const char *key, size_t keylen)
+{
+	uint32_t h = 2166136261u; // FNV-1a
+
+	for(size_t i = 0; i < keylen; ++i) {
+		h ^= (unsigned char) key[i];
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+/**
+ * Returns position of the key or of the empty slot
+ * where it should be placed.
+ */
+static
+size_t index_probe(const struct dtree_index_slot *slot, size_t cap,
+		const char *key, size_t keylen, uint32_t hash)
+{
+	size_t i = hash & (cap - 1);
+
+	while(slot[i].key != NULL) {
+		if(slot[i].hash == hash && slot[i].keylen == keylen
+				&& !memcmp(slot[i].key, key, keylen))
+			break;
+
+		i = (i + 1) & (cap - 1);
+	}
+
+	return i;
+}
+
+static
+int index_grow(struct dtree_index *ix)
+{
+	const size_t cap = ix->cap == 0? 64 : ix->cap * 2;
+
+	struct dtree_index_slot *slot = calloc(cap, sizeof(struct dtree_index_slot));
+	if(slot == NULL)
+		return 1;
+
+	uint32_t *moved = malloc((ix->cap + 1) * sizeof(uint32_t));
+	if(moved == NULL) {
+		free(slot);
+		return 1;
+	}
+
+	for(size_t i = 0; i < ix->cap; ++i) {
+		if(ix->slot[i].key == NULL)
+			continue;
+
+		size_t j = index_probe(slot, cap, ix->slot[i].key,
+				ix->slot[i].keylen, ix->slot[i].hash);
+		slot[j]  = ix->slot[i];
+		moved[i] = j;
+	}
+
+	for(size_t p = 0; p < ix->pairs; ++p)
+		ix->pair[p].slot = moved[ix->pair[p].slot];
+
+	free(moved);
+	free(ix->slot);
+	ix->slot = slot;
+	ix->cap  = cap;
+	return 0;
+}
+
+static
+int index_push_pair(struct dtree_index *ix, uint32_t slot, uint32_t dev)
+{
+	if(ix->pairs == ix->pairs_cap) {
+		size_t cap = ix->pairs_cap == 0? 64 : ix->pairs_cap * 2;
+
+		struct dtree_index_pair *pair = realloc(ix->pair, cap * sizeof(struct dtree_index_pair));
+		if(pair == NULL)
+			return 1;
+
+		ix->pair      = pair;
+		ix->pairs_cap = cap;
+	}
+
+	ix->pair[ix->pairs].slot = slot;
+	ix->pair[ix->pairs].dev  = dev;
+	ix->pairs += 1;
+	return 0;
+}
+
+int dtree_index_add(struct dtree_index *ix, const char *key, size_t keylen, uint32_t dev)
+{
+	assert(ix->idx == NULL); // not finished yet
+
+	if(2 * (ix->used + 1) > ix->cap && index_grow(ix))
+		return 1;
+
+	const uint32_t hash = index_hash(key, keylen);
+	const size_t i = index_probe(ix->slot, ix->cap, key, keylen, hash);
+	struct dtree_index_slot *s = &ix->slot[i];
+
+	if(s->key == NULL) {
+		s->key    = key;
+		s->keylen = (uint32_t) keylen;
+		s->hash   = hash;
+		ix->used += 1;
+	}
+	else if(s->last == dev) {
+		return 0;
+	}
+
+	assert(s->len == 0 || s->last < dev);
+	s->last = dev;
+	s->len += 1;
+
+	return index_push_pair(ix, (uint32_t) i, dev);
+}
+
+int dtree_index_finish(struct dtree_index *ix)
+{
+	ix->idx   = malloc((ix->pairs + 1) * sizeof(uint32_t));
+	ix->count = ix->pairs;
+	if(ix->idx == NULL)
+		return 1;
+
+	uint32_t off = 0;
+	for(size_t i = 0; i < ix->cap; ++i) {
+		ix->slot[i].off = off;
+		off += ix->slot[i].len;
+		ix->slot[i].len = 0;
+	}
+
+	// pairs are in ascending order of devices, keep it
+	for(size_t p = 0; p < ix->pairs; ++p) {
+		struct dtree_index_slot *s = &ix->slot[ix->pair[p].slot];
+		ix->idx[s->off + s->len] = ix->pair[p].dev;
+		s->len += 1;
+	}
+
+	free(ix->pair);
+	ix->pair      = NULL;
+	ix->pairs     = 0;
+	ix->pairs_cap = 0;
+	return 0;
+}
+
+const uint32_t *dtree_index_find(const struct dtree_index *ix,
+		const char *key, size_t keylen, size_t *count)
+{
+	if(ix->cap == 0 || ix->idx == NULL)
+		return NULL;
+
+	const uint32_t hash = index_hash(key, keylen);
+	const size_t i = index_probe(ix->slot, ix->cap, key, keylen, hash);
+
+	if(ix->slot[i].key == NULL)
+		return NULL;
+
+	*count = ix->slot[i].len;
+	return ix->idx + ix->slot[i].off;
+}
+
+size_t dtree_index_memory(const struct dtree_index *ix)
+{
+	return ix->cap * sizeof(struct dtree_index_slot)
+	     + ix->count * sizeof(uint32_t);
+}
+
+void dtree_index_free(struct dtree_index *ix)
+{
+	free(ix->slot);
+	free(ix->idx);
+	free(ix->pair);
+	memset(ix, 0, sizeof(struct dtree_index));
+}
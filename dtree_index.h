@@ -0,0 +1,69 @@
+/**
+ * Internal string index of devices.
+ * Non-public API.
+ */
+
+#ifndef DTREE_INDEX
+#define DTREE_INDEX
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct dtree_index_slot;
+struct dtree_index_pair;
+
+/**
+ * Hash table mapping strings (keys) to lists of device
+ * numbers. Lists are sorted in ascending order.
+ *
+ * Keys are not copied, they must live as long as the index.
+ */
+struct dtree_index {
+	struct dtree_index_slot *slot;
+	size_t    cap;
+	size_t    used;
+
+	uint32_t *idx;
+	size_t    count;
+
+	// used while building only
+	struct dtree_index_pair *pair;
+	size_t    pairs;
+	size_t    pairs_cap;
+};
+
+/**
+ * Adds the device number dev under the key. Devices must be
+ * added in ascending order. Adding the same device under the
+ * same key twice has no effect.
+ *
+ * Returns 0 on success, on error (errno is set) non-zero.
+ */
+int dtree_index_add(struct dtree_index *ix, const char *key, size_t keylen, uint32_t dev);
+
+/**
+ * Finishes building of the index. No dtree_index_add()
+ * is allowed then.
+ *
+ * Returns 0 on success, on error (errno is set) non-zero.
+ */
+int dtree_index_finish(struct dtree_index *ix);
+
+/**
+ * Looks up the key. Returns the list of devices and stores
+ * its length into count. Returns NULL when not found.
+ */
+const uint32_t *dtree_index_find(const struct dtree_index *ix,
+		const char *key, size_t keylen, size_t *count);
+
+/**
+ * Memory occupied by the index in bytes.
+ */
+size_t dtree_index_memory(const struct dtree_index *ix);
+
+/**
+ * Frees the index.
+ */
+void dtree_index_free(struct dtree_index *ix);
+
+#endif
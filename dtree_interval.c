@@ -0,0 +1,200 @@
+/**
+ * dtree_interval.c
+ */
+
+#include "dtree_interval.h"
+#include "dtree_reg.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct dtree_interval {
+	dtree_addr_t base;
+	dtree_addr_t high;
+	uint32_t     dev;
+};
+
+static
+int interval_cmp(const void *a, const void *b)
+{
+	const struct dtree_interval *l = (const struct dtree_interval *) a;
+	const struct dtree_interval *r = (const struct dtree_interval *) b;
+
+	if(l->base != r->base)
+		return l->base < r->base? -1 : 1;
+
+	// the wider first, so an enclosing range precedes the enclosed one
+	if(l->high != r->high)
+		return l->high > r->high? -1 : 1;
+
+	return l->dev < r->dev? -1 : (l->dev > r->dev);
+}
+
+static
+dtree_addr_t interval_maxhigh(struct dtree_interval_index *ix, size_t lo, size_t hi)
+{
+	if(lo >= hi)
+		return 0;
+
+	const size_t mid = lo + (hi - lo) / 2;
+	dtree_addr_t max = ix->iv[mid].high;
+
+	const dtree_addr_t left  = interval_maxhigh(ix, lo, mid);
+	const dtree_addr_t right = interval_maxhigh(ix, mid + 1, hi);
+
+	if(left > max)
+		max = left;
+	if(right > max)
+		max = right;
+
+	ix->maxhigh[mid] = max;
+	return max;
+}
+
+/**
+ * Sweeps the sorted intervals keeping all open ones (those
+ * reaching the base of the current one). The current interval
+ * overlaps every open one ending inside it (it is not enclosed)
+ * and the identical ones, both of a pair are marked. Returns
+ * non-zero on error (errno is set).
+ */
+static
+int interval_overlaps(struct dtree_interval_index *ix, size_t ndev)
+{
+	size_t *open = malloc((ix->count + 1) * sizeof(size_t));
+	unsigned char *mark = calloc(ndev + 1, 1);
+	size_t nopen = 0;
+
+	if(open == NULL || mark == NULL) {
+		free(open);
+		free(mark);
+		return 1;
+	}
+
+	for(size_t i = 0; i < ix->count; ++i) {
+		const struct dtree_interval *curr = &ix->iv[i];
+		size_t keep = 0;
+
+		for(size_t j = 0; j < nopen; ++j) {
+			const struct dtree_interval *prev = &ix->iv[open[j]];
+
+			// bases only grow, a closed interval is never open again
+			if(prev->high < curr->base)
+				continue;
+
+			open[keep++] = open[j];
+
+			// ranges of the same device are not compared
+			if(prev->dev == curr->dev)
+				continue;
+
+			if(curr->high > prev->high
+					|| (curr->base == prev->base && curr->high == prev->high)) {
+				mark[prev->dev] = 1;
+				mark[curr->dev] = 1;
+			}
+		}
+
+		nopen = keep;
+		open[nopen++] = i;
+	}
+
+	ix->overlaps = 0;
+	for(size_t d = 0; d < ndev; ++d)
+		ix->overlaps += mark[d];
+
+	free(open);
+	free(mark);
+	return 0;
+}
+
+int dtree_interval_build(struct dtree_interval_index *ix,
+		const struct dtree_dev_t *dev, size_t count, int cpu)
+{
+	size_t n = 0;
+
+	memset(ix, 0, sizeof(struct dtree_interval_index));
+
+	for(size_t i = 0; i < count; ++i) {
+		for(size_t r = 0; r < dev[i].nreg; ++r)
+			n += !cpu || dev[i].cpu[r] != DTREE_ADDR_NONE;
+	}
+
+	ix->iv      = malloc((n + 1) * sizeof(struct dtree_interval));
+	ix->maxhigh = malloc((n + 1) * sizeof(dtree_addr_t));
+	if(ix->iv == NULL || ix->maxhigh == NULL) {
+		dtree_interval_free(ix);
+		return 1;
+	}
+
+	for(size_t i = 0; i < count; ++i) {
+		for(size_t r = 0; r < dev[i].nreg; ++r) {
+			const dtree_addr_t base = cpu? dev[i].cpu[r] : dev[i].reg[r].base;
+
+			if(cpu && base == DTREE_ADDR_NONE)
+				continue;
+
+			ix->iv[ix->count].base = base;
+			ix->iv[ix->count].high = dtree_reg_high(base, dev[i].reg[r].size);
+			ix->iv[ix->count].dev  = (uint32_t) i;
+			ix->count += 1;
+		}
+	}
+
+	qsort(ix->iv, ix->count, sizeof(struct dtree_interval), interval_cmp);
+	interval_maxhigh(ix, 0, ix->count);
+
+	// buses reuse their (local) addresses, only CPU addresses overlap
+	if(cpu && interval_overlaps(ix, count)) {
+		dtree_interval_free(ix);
+		return 1;
+	}
+
+	return 0;
+}
+
+static
+void interval_query(const struct dtree_interval_index *ix, size_t lo, size_t hi,
+		dtree_addr_t qlo, dtree_addr_t qhi,
+		void (*hit)(uint32_t dev, void *arg), void *arg)
+{
+	while(lo < hi) {
+		const size_t mid = lo + (hi - lo) / 2;
+
+		if(ix->maxhigh[mid] < qlo)
+			return;
+
+		interval_query(ix, lo, mid, qlo, qhi, hit, arg);
+
+		// bases on the right are not lower
+		if(ix->iv[mid].base > qhi)
+			return;
+
+		if(ix->iv[mid].high >= qlo)
+			hit(ix->iv[mid].dev, arg);
+
+		lo = mid + 1;
+	}
+}
+
+void dtree_interval_query(const struct dtree_interval_index *ix,
+		dtree_addr_t lo, dtree_addr_t hi,
+		void (*hit)(uint32_t dev, void *arg), void *arg)
+{
+	if(lo > hi)
+		return;
+
+	interval_query(ix, 0, ix->count, lo, hi, hit, arg);
+}
+
+size_t dtree_interval_memory(const struct dtree_interval_index *ix)
+{
+	return ix->count * (sizeof(struct dtree_interval) + sizeof(dtree_addr_t));
+}
+
+void dtree_interval_free(struct dtree_interval_index *ix)
+{
+	free(ix->iv);
+	free(ix->maxhigh);
+	memset(ix, 0, sizeof(struct dtree_interval_index));
+}
@@ -0,0 +1,65 @@
+/**
+ * Internal address interval index of devices.
+ * Non-public API.
+ */
+
+#ifndef DTREE_INTERVAL
+#define DTREE_INTERVAL
+
+#include "dtree.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct dtree_interval;
+
+/**
+ * Static interval tree over address ranges (all entries of reg)
+ * of devices.
+ * Intervals are sorted by base and the maximal high of every
+ * (implicit) subtree is kept to prune the search.
+ */
+struct dtree_interval_index {
+	struct dtree_interval *iv;
+	dtree_addr_t *maxhigh;
+	size_t count;
+
+	unsigned long overlaps;
+};
+
+/**
+ * Builds the index over the ranges of the given devices at their
+ * addresses in the bus or (cpu non-zero) in the CPU address space
+ * (ranges not mapped to the CPU are left out). An empty range
+ * occupies only its base.
+ *
+ * In the CPU address space, devices with a range that partially
+ * overlaps (or is identical to) a range of another device are counted
+ * in overlaps. Nesting of ranges (eg. a bus and its devices) is not
+ * an overlap.
+ *
+ * Returns 0 on success, on error (errno is set) non-zero.
+ */
+int dtree_interval_build(struct dtree_interval_index *ix,
+		const struct dtree_dev_t *dev, size_t count, int cpu);
+
+/**
+ * Calls hit for every range intersecting lo..hi with the number
+ * of its device. The order is unspecified, a device with several
+ * such ranges is hit several times.
+ */
+void dtree_interval_query(const struct dtree_interval_index *ix,
+		dtree_addr_t lo, dtree_addr_t hi,
+		void (*hit)(uint32_t dev, void *arg), void *arg);
+
+/**
+ * Memory occupied by the index in bytes.
+ */
+size_t dtree_interval_memory(const struct dtree_interval_index *ix);
+
+/**
+ * Frees the index.
+ */
+void dtree_interval_free(struct dtree_interval_index *ix);
+
+#endif
@@ -0,0 +1,408 @@
+/**
+ * dtree_pipe.c
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "dtree.h"
+#include "dtree_error.h"
+#include "dtree_pipe.h"
+#include "dtree_backend.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#define PIPE_MAX  65536
+#define PIPE_SPIN 64
+
+/**
+ * Bounded single-producer single-consumer queue. Devices live
+ * in slot[head..tail) (indices wrap). The end of the walk is
+ * marked by NULL. Only the producer moves tail, only the consumer
+ * moves head, neither takes a lock.
+ *
+ * A side finding the queue empty (full) spins for a while and then
+ * sleeps on a futex. The consumer sleeps on tail; the producer
+ * sleeps on wake, bumped by the consumer whenever it frees a slot
+ * or asks the producer to stop (so no wake up can be lost).
+ */
+struct pipe_ring {
+	struct dtree_dev_t **slot;
+	unsigned mask;
+	unsigned head;
+	unsigned tail;
+	unsigned wake;
+
+	int consumer_waits;
+	int producer_waits;
+};
+
+/**
+ * A device returned by the consumer is linked by its own
+ * memory into the freed stack until the producer (the owner
+ * of the wrapped backend) releases it.
+ */
+struct pipe_free {
+	struct pipe_free *next;
+};
+
+struct pipe {
+	const struct dtree_backend *inner;
+	void *state;
+	void *cursor; // of inner, NULL when there is no cursor
+
+	struct pipe_ring  ring;
+	struct pipe_free *freed;
+
+	pthread_t thread;
+	int running; // producer not joined yet
+	int stop;
+	int ended;   // end of the walk taken by the consumer
+
+	/**
+	 * The wrapped backend reports into inner_err. The consumer
+	 * copies it into err when it reaches the end of the walk.
+	 */
+	struct dtree_error  inner_err;
+	struct dtree_error *err;
+};
+
+static
+void futex_wait(unsigned *addr, unsigned val)
+{
+	syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static
+void futex_wake(unsigned *addr)
+{
+	syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+/**
+ * Waits until *word differs from seen (or may differ, the caller
+ * checks again).
+ */
+static
+void ring_wait(unsigned *word, unsigned seen, int *waits)
+{
+	for(int i = 0; i < PIPE_SPIN; ++i) {
+		if(__atomic_load_n(word, __ATOMIC_ACQUIRE) != seen)
+			return;
+	}
+
+	__atomic_store_n(waits, 1, __ATOMIC_SEQ_CST);
+
+	if(__atomic_load_n(word, __ATOMIC_SEQ_CST) == seen)
+		futex_wait(word, seen);
+
+	__atomic_store_n(waits, 0, __ATOMIC_RELAXED);
+}
+
+static
+void producer_wake(struct pipe *p)
+{
+	__atomic_add_fetch(&p->ring.wake, 1, __ATOMIC_SEQ_CST);
+
+	if(__atomic_load_n(&p->ring.producer_waits, __ATOMIC_SEQ_CST))
+		futex_wake(&p->ring.wake);
+}
+
+/**
+ * Appends the device (NULL marks the end). Returns 1 when
+ * the producer has been asked to stop meanwhile.
+ */
+static
+int ring_push(struct pipe *p, struct dtree_dev_t *dev)
+{
+	struct pipe_ring *r = &p->ring;
+	const unsigned tail = r->tail;
+
+	for(;;) {
+		const unsigned wake = __atomic_load_n(&r->wake, __ATOMIC_SEQ_CST);
+
+		if(__atomic_load_n(&p->stop, __ATOMIC_ACQUIRE))
+			return 1;
+		if(tail - __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) <= r->mask)
+			break;
+
+		ring_wait(&r->wake, wake, &r->producer_waits);
+	}
+
+	r->slot[tail & r->mask] = dev;
+	__atomic_store_n(&r->tail, tail + 1, __ATOMIC_SEQ_CST);
+
+	if(__atomic_load_n(&r->consumer_waits, __ATOMIC_SEQ_CST))
+		futex_wake(&r->tail);
+
+	return 0;
+}
+
+static
+struct dtree_dev_t *ring_pop(struct pipe *p)
+{
+	struct pipe_ring *r = &p->ring;
+	const unsigned head = r->head;
+
+	while(__atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == head)
+		ring_wait(&r->tail, head, &r->consumer_waits);
+
+	struct dtree_dev_t *dev = r->slot[head & r->mask];
+	__atomic_store_n(&r->head, head + 1, __ATOMIC_SEQ_CST);
+
+	producer_wake(p);
+	return dev;
+}
+
+/**
+ * Releases all devices returned by the consumer. Called
+ * by the producer or when the producer is not running.
+ */
+static
+void pipe_release_freed(struct pipe *p)
+{
+	struct pipe_free *f = __atomic_exchange_n(&p->freed, NULL, __ATOMIC_ACQUIRE);
+
+	while(f != NULL) {
+		struct pipe_free *next = f->next;
+		p->inner->dev_free(p->state, (struct dtree_dev_t *) f);
+		f = next;
+	}
+}
+
+static
+void *pipe_produce(void *arg)
+{
+	struct pipe *p = (struct pipe *) arg;
+
+	while(!__atomic_load_n(&p->stop, __ATOMIC_ACQUIRE)) {
+		pipe_release_freed(p);
+
+		struct dtree_dev_t *dev = p->inner->next(p->state, p->cursor);
+		if(dev == NULL) {
+			ring_push(p, NULL);
+			break;
+		}
+
+		if(ring_push(p, dev)) {
+			p->inner->dev_free(p->state, dev);
+			break;
+		}
+	}
+
+	pipe_release_freed(p);
+	return NULL;
+}
+
+static
+int pipe_start(struct pipe *p)
+{
+	p->ring.head = 0;
+	p->ring.tail = 0;
+	p->stop  = 0;
+	p->ended = 0;
+	dtree_error_clear(&p->inner_err);
+
+	int err = pthread_create(&p->thread, NULL, pipe_produce, p);
+	if(err) {
+		errno = err;
+		p->ended = 1;
+		return 1;
+	}
+
+	p->running = 1;
+	return 0;
+}
+
+/**
+ * Stops and joins the producer and releases all
+ * devices it has prepared.
+ */
+static
+void pipe_stop(struct pipe *p)
+{
+	if(p->running) {
+		__atomic_store_n(&p->stop, 1, __ATOMIC_SEQ_CST);
+		producer_wake(p);
+
+		pthread_join(p->thread, NULL);
+		p->running = 0;
+	}
+
+	for(unsigned i = p->ring.head; i != p->ring.tail; ++i) {
+		struct dtree_dev_t *dev = p->ring.slot[i & p->ring.mask];
+		if(dev != NULL)
+			p->inner->dev_free(p->state, dev);
+	}
+
+	p->ring.head = p->ring.tail;
+	pipe_release_freed(p);
+}
+
+void *dtree_pipe_open(const char *rootd, const struct dtree_opts *opts, struct dtree_error *err)
+{
+	struct pipe *p = calloc(1, sizeof(struct pipe));
+	if(p == NULL) {
+		dtree_error_from_errno(err);
+		return NULL;
+	}
+
+	unsigned cap = 1;
+	while(cap < opts->pipeline && cap < PIPE_MAX)
+		cap *= 2;
+
+	p->ring.slot = malloc(cap * sizeof(struct dtree_dev_t *));
+	if(p->ring.slot == NULL) {
+		dtree_error_from_errno(err);
+		free(p);
+		return NULL;
+	}
+
+	p->ring.mask = cap - 1;
+	p->err   = err;
+	p->inner = dtree_backend_detect(rootd);
+	p->state = p->inner->open(rootd, opts, &p->inner_err);
+
+	if(p->state == NULL) {
+		*err = p->inner_err;
+		free(p->ring.slot);
+		free(p);
+		return NULL;
+	}
+
+	return p;
+}
+
+void dtree_pipe_close(void *state)
+{
+	struct pipe *p = (struct pipe *) state;
+
+	assert(p->cursor == NULL);
+
+	p->inner->close(p->state);
+	free(p->ring.slot);
+	free(p);
+}
+
+void *dtree_pipe_iter_new(void *state)
+{
+	struct pipe *p = (struct pipe *) state;
+
+	if(p->cursor != NULL) {
+		errno = EBUSY; // the walk can not be shared
+		return NULL;
+	}
+
+	p->cursor = p->inner->iter_new(p->state);
+	if(p->cursor == NULL)
+		return NULL;
+
+	if(pipe_start(p)) {
+		p->inner->iter_free(p->state, p->cursor);
+		p->cursor = NULL;
+		return NULL;
+	}
+
+	return p->cursor;
+}
+
+void *dtree_pipe_iter_clone(void *state, const void *iter)
+{
+	(void) state;
+	(void) iter;
+
+	errno = EBUSY;
+	return NULL;
+}
+
+void dtree_pipe_iter_free(void *state, void *iter)
+{
+	struct pipe *p = (struct pipe *) state;
+
+	assert(iter == p->cursor);
+	pipe_stop(p);
+
+	p->inner->iter_free(p->state, iter);
+	p->cursor = NULL;
+}
+
+struct dtree_dev_t *dtree_pipe_next(void *state, void *iter)
+{
+	struct pipe *p = (struct pipe *) state;
+	(void) iter;
+
+	if(p->ended)
+		return NULL;
+
+	struct dtree_dev_t *dev = ring_pop(p);
+	if(dev != NULL)
+		return dev;
+
+	// the producer has finished, the error state is final
+	pipe_stop(p);
+	p->ended = 1;
+
+	if(dtree_error_isset(&p->inner_err))
+		*p->err = p->inner_err;
+
+	return NULL;
+}
+
+int dtree_pipe_reset(void *state, void *iter)
+{
+	struct pipe *p = (struct pipe *) state;
+
+	pipe_stop(p);
+	dtree_error_clear(&p->inner_err);
+
+	int err = p->inner->reset(p->state, iter);
+	if(err) {
+		*p->err  = p->inner_err;
+		p->ended = 1;
+		return err;
+	}
+
+	if(pipe_start(p)) {
+		dtree_error_from_errno(p->err);
+		return -1;
+	}
+
+	return 0;
+}
+
+void dtree_pipe_dev_free(void *state, struct dtree_dev_t *dev)
+{
+	struct pipe *p = (struct pipe *) state;
+
+	assert(dev != NULL);
+
+	if(!p->running) {
+		p->inner->dev_free(p->state, dev);
+		return;
+	}
+
+	struct pipe_free *f = (struct pipe_free *) dev;
+	f->next = __atomic_load_n(&p->freed, __ATOMIC_RELAXED);
+
+	while(!__atomic_compare_exchange_n(&p->freed, &f->next, f, 1,
+				__ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		;
+}
+
+const struct dtree_backend dtree_pipe_backend = {
+	.name       = "pipe",
+	.open       = dtree_pipe_open,
+	.close      = dtree_pipe_close,
+	.iter_new   = dtree_pipe_iter_new,
+	.iter_clone = dtree_pipe_iter_clone,
+	.iter_free  = dtree_pipe_iter_free,
+	.next       = dtree_pipe_next,
+	.reset      = dtree_pipe_reset,
+	.dev_free   = dtree_pipe_dev_free,
+};
@@ -0,0 +1,51 @@
+/**
+ * Internal pipelined traversal.
+ * Non-public API.
+ */
+
+#ifndef DTREE_PIPE
+#define DTREE_PIPE
+
+struct dtree_opts;
+struct dtree_error;
+struct dtree_dev_t;
+
+/**
+ * Opens the tree by the backend chosen by dtree_backend_detect()
+ * and wraps it. The walk is done by a background thread (started
+ * by iter_new) that stays up to opts->pipeline devices ahead of
+ * the consumer.
+ *
+ * Only one cursor can exist at a time (another iter_new fails
+ * with EBUSY). Returns the state or NULL on error (set in err).
+ */
+void *dtree_pipe_open(const char *rootd, const struct dtree_opts *opts, struct dtree_error *err);
+
+/**
+ * Stops the producer and free's all resources.
+ */
+void dtree_pipe_close(void *state);
+
+void *dtree_pipe_iter_new(void *state);
+void *dtree_pipe_iter_clone(void *state, const void *iter);
+void dtree_pipe_iter_free(void *state, void *iter);
+
+/**
+ * Takes the next device prepared by the producer.
+ * Waits when there is none yet.
+ */
+struct dtree_dev_t *dtree_pipe_next(void *state, void *iter);
+
+/**
+ * Stops the producer, drops the prepared devices
+ * and starts again from the beginning.
+ */
+int dtree_pipe_reset(void *state, void *iter);
+
+/**
+ * Returns the device to the producer (which owns the
+ * memory of the wrapped backend).
+ */
+void dtree_pipe_dev_free(void *state, struct dtree_dev_t *dev);
+
+#endif
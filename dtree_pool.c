@@ -0,0 +1,225 @@
+/**
+ * dtree_pool.c
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "dtree_pool.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct pool_task {
+	dtree_task_fn fn;
+	void *arg;
+};
+
+/**
+ * Deque of a worker. Tasks live in task[head..tail). The owner
+ * pushes and pops at the tail, thieves take from the head. The
+ * critical sections are a few instructions, a spin lock is enough.
+ */
+struct pool_deque {
+	struct pool_task *task;
+	size_t head;
+	size_t tail;
+	size_t cap;
+	int    lock;
+};
+
+struct pool_worker {
+	struct dtree_pool *pool;
+	unsigned id;
+	pthread_t thread;
+};
+
+struct dtree_pool {
+	unsigned threads;
+	void    *data;
+	struct pool_deque  *deque;
+	struct pool_worker *worker;
+
+	/**
+	 * Number of spawned tasks not finished yet.
+	 */
+	unsigned long pending;
+};
+
+static
+void deque_lock(struct pool_deque *d)
+{
+	while(__atomic_exchange_n(&d->lock, 1, __ATOMIC_ACQUIRE))
+		sched_yield();
+}
+
+static
+void deque_unlock(struct pool_deque *d)
+{
+	__atomic_store_n(&d->lock, 0, __ATOMIC_RELEASE);
+}
+
+static
+int deque_push(struct pool_deque *d, dtree_task_fn fn, void *arg)
+{
+	int err = 0;
+	deque_lock(d);
+
+	if(d->head > 0 && d->tail == d->cap) {
+		memmove(d->task, d->task + d->head, (d->tail - d->head) * sizeof(struct pool_task));
+		d->tail -= d->head;
+		d->head  = 0;
+	}
+
+	if(d->tail == d->cap) {
+		size_t cap = d->cap == 0? 64 : d->cap * 2;
+
+		struct pool_task *task = realloc(d->task, cap * sizeof(struct pool_task));
+		if(task == NULL)
+			err = 1;
+		else {
+			d->task = task;
+			d->cap  = cap;
+		}
+	}
+
+	if(!err) {
+		d->task[d->tail].fn  = fn;
+		d->task[d->tail].arg = arg;
+		d->tail += 1;
+	}
+
+	deque_unlock(d);
+	return err;
+}
+
+/**
+ * Takes a task from the back (owner) or from the front (thief).
+ */
+static
+int deque_take(struct pool_deque *d, int steal, struct pool_task *t)
+{
+	int found = 0;
+	deque_lock(d);
+
+	if(d->head < d->tail) {
+		*t = steal? d->task[d->head++] : d->task[--d->tail];
+		found = 1;
+
+		if(d->head == d->tail)
+			d->head = d->tail = 0;
+	}
+
+	deque_unlock(d);
+	return found;
+}
+
+static
+int pool_find(struct dtree_pool *pool, unsigned id, struct pool_task *t)
+{
+	if(deque_take(&pool->deque[id], 0, t))
+		return 1;
+
+	for(unsigned i = 1; i < pool->threads; ++i) {
+		const unsigned victim = (id + i) % pool->threads;
+
+		if(deque_take(&pool->deque[victim], 1, t))
+			return 1;
+	}
+
+	return 0;
+}
+
+static
+void *pool_work(void *arg)
+{
+	struct pool_worker *w = (struct pool_worker *) arg;
+	struct dtree_pool *pool = w->pool;
+	struct pool_task t;
+
+	while(__atomic_load_n(&pool->pending, __ATOMIC_ACQUIRE) != 0) {
+		if(!pool_find(pool, w->id, &t)) {
+			sched_yield();
+			continue;
+		}
+
+		t.fn(pool, w->id, t.arg);
+		__atomic_sub_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL);
+	}
+
+	return NULL;
+}
+
+void dtree_pool_spawn(struct dtree_pool *pool, unsigned worker, dtree_task_fn fn, void *arg)
+{
+	__atomic_add_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL);
+
+	if(deque_push(&pool->deque[worker], fn, arg)) {
+		fn(pool, worker, arg);
+		__atomic_sub_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL);
+	}
+}
+
+void *dtree_pool_data(const struct dtree_pool *pool)
+{
+	return pool->data;
+}
+
+static
+void pool_free(struct dtree_pool *pool)
+{
+	for(unsigned i = 0; pool->deque != NULL && i < pool->threads; ++i)
+		free(pool->deque[i].task);
+
+	free(pool->deque);
+	free(pool->worker);
+}
+
+int dtree_pool_run(unsigned threads, void *data, dtree_task_fn fn, void *arg)
+{
+	struct dtree_pool pool;
+
+	if(threads == 0)
+		threads = 1;
+	if(threads > DTREE_POOL_MAX)
+		threads = DTREE_POOL_MAX;
+
+	memset(&pool, 0, sizeof(struct dtree_pool));
+	pool.threads = threads;
+	pool.data    = data;
+	pool.deque   = calloc(threads, sizeof(struct pool_deque));
+	pool.worker  = calloc(threads, sizeof(struct pool_worker));
+
+	if(pool.deque == NULL || pool.worker == NULL) {
+		pool_free(&pool);
+		return 1;
+	}
+
+	pool.pending = 1;
+	if(deque_push(&pool.deque[0], fn, arg)) {
+		pool_free(&pool);
+		return 1;
+	}
+
+	unsigned started = 1;
+	for(; started < threads; ++started) {
+		struct pool_worker *w = &pool.worker[started];
+		w->pool = &pool;
+		w->id   = started;
+
+		if(pthread_create(&w->thread, NULL, pool_work, w))
+			break;
+	}
+
+	// the caller is the worker 0, the others steal from it
+	pool.worker[0].pool = &pool;
+	pool.worker[0].id   = 0;
+	pool_work(&pool.worker[0]);
+
+	for(unsigned i = 1; i < started; ++i)
+		pthread_join(pool.worker[i].thread, NULL);
+
+	pool_free(&pool);
+	return 0;
+}
@@ -0,0 +1,46 @@
+/**
+ * Internal work-stealing thread pool.
+ * Non-public API.
+ */
+
+#ifndef DTREE_POOL
+#define DTREE_POOL
+
+/**
+ * Upper limit of the number of threads of a pool.
+ */
+#define DTREE_POOL_MAX 64
+
+struct dtree_pool;
+
+/**
+ * A task is run by one of the workers (numbered from 0 to
+ * threads - 1), it can spawn further tasks.
+ */
+typedef void (*dtree_task_fn)(struct dtree_pool *pool, unsigned worker, void *arg);
+
+/**
+ * Runs the task fn(arg) and all the tasks it spawns (recursively)
+ * by the given number of threads (the caller is one of them).
+ * Every worker owns a deque: its own tasks are taken from the back
+ * (depth first), idle workers steal from the front of the others.
+ * Returns when all tasks have finished.
+ *
+ * When threads can not be started the work is done by less of
+ * them. Returns 0 on success, 1 when the pool can not be allocated
+ * (errno is set, nothing has been run).
+ */
+int dtree_pool_run(unsigned threads, void *data, dtree_task_fn fn, void *arg);
+
+/**
+ * Schedules fn(arg) to the deque of the worker. When the task
+ * can not be queued (out of memory) it is run immediately.
+ */
+void dtree_pool_spawn(struct dtree_pool *pool, unsigned worker, dtree_task_fn fn, void *arg);
+
+/**
+ * Returns data passed to dtree_pool_run().
+ */
+void *dtree_pool_data(const struct dtree_pool *pool);
+
+#endif
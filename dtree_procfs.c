@@ -3,552 +3,2166 @@
  * Copyright (C) 2013 Jan Viktorin
  */
 
-#define _BSD_SOURCE
+#define _DEFAULT_SOURCE
 
 #include "dtree.h"
 #include "dtree_error.h"
 #include "dtree_util.h"
 #include "dtree_procfs.h"
+#include "dtree_backend.h"
+#include "dtree_ctx.h"
+#include "dtree_arena.h"
+#include "dtree_pool.h"
+#include "dtree_uring.h"
+#include "dtree_reg.h"
+#include "dtree_filter.h"
 #include "stack.h"
 
 #include <errno.h>
 #include <dirent.h>
-#include <stdio.h>
+#include <fcntl.h>
 #include <string.h>
+#include <unistd.h>
 #include <sys/stat.h>
 
-static struct stack *g_path = NULL;
-static DIR *g_dir = NULL;
+/**
+ * Sizes of buffers of the batched reads. A longer
+ * property is read again by the plain syscalls.
+ */
+#define PROCFS_BATCH_REG    64
+#define PROCFS_BATCH_COMPAT 512
 
-static const char *NULL_ENTRY = NULL;
+/**
+ * Initial size of the property buffer.
+ */
+#define PROCFS_PROP_MIN 256
 
-static
-int stack_push_fname(struct stack **path, const char *fname)
-{
-	return stack_push_dup(path, fname, strlen(fname) + 1);
-}
+/**
+ * Kind of a directory entry found by node_scan().
+ */
+enum procfs_kind {
+	PROCFS_PROP,
+	PROCFS_NODE
+};
 
-static
-void *stack_pop_fname(struct stack **path)
-{
-	return stack_pop(path);
-}
+/**
+ * Classified directory entry. The name is an offset
+ * into the names buffer of the scan. The size of
+ * a property is known only after it has been read
+ * (-1 until then), it is never stat'ed just for that.
+ * Its data are at off in the property buffer while
+ * gen equals the generation of the buffer.
+ */
+struct procfs_entry {
+	size_t name;
+	long   size;
+	enum procfs_kind kind;
+
+	size_t off;
+	unsigned long gen;
+};
 
 /**
- * This implementation doesn't accept a regular
- * file as rootd.
+ * Result of a single pass over a node directory.
+ * Entries are kept in the readdir order. Indices
+ * reg and compat point to the respective properties
+ * or are -1 when the node does not have them.
  */
-int dtree_procfs_open(const char *rootd)
-{
-	if(rootd == NULL) {
-		dtree_error_set(EINVAL);
-		return -1;
-	}
+struct procfs_scan {
+	char  *names;
+	size_t names_len;
+	size_t names_cap;
+
+	struct procfs_entry *entry;
+	size_t count;
+	size_t cap;
+
+	long reg;
+	long compat;
+	long acells; // #address-cells
+	long scells; // #size-cells
+	long ranges;
+	long phandle;
+	long status;
+};
 
-	if(!stack_empty(&g_path)) {
-		dtree_error_set(EBUSY); // call close first
-		return -1;
-	}
+/**
+ * An opened node directory: its directory stream and the scan
+ * of its entries. Nodes are shared by all cursors standing in
+ * them and counted by refs. Every node holds a reference of
+ * its parent and is remembered by the parent (child, indexed
+ * by the entry) while alive, so a cursor descending into
+ * a node that is already opened by another cursor just takes
+ * a reference and no directory is opened (and read) twice.
+ *
+ * Released nodes are kept in the spare list (linked by spare)
+ * together with their buffers and reused by the next descent.
+ */
+struct procfs_node {
+	DIR   *dir;
+	struct procfs_scan scan;
+	unsigned long refs;
 
-	g_dir = opendir(rootd);
-	if(g_dir == NULL) {
-		dtree_error_from_errno();
-		return -1;
-	}
+	struct procfs_node  *parent;
+	size_t index; // entry of the node in the parent
 
-	if(stack_push_fname(&g_path, rootd)) {
-		dtree_error_from_errno();
-		closedir(g_dir);
-		g_dir = NULL;
-		return -1;
-	}
+	// layout of reg of the children and their CPU addresses
+	unsigned acells;
+	unsigned scells;
+	const struct dtree_xlat *xlat;
 
-	return 0;
-}
+	// status is not okay, -1 until read (by a filter)
+	int disabled;
 
-void dtree_procfs_close(void)
-{
-	if(g_dir != NULL) {
-		closedir(g_dir);
-		g_dir = NULL;
-	}
+	struct procfs_node **child;
+	size_t child_cap;
 
-	while(!stack_empty(&g_path)) {
-		void *d = stack_pop_fname(&g_path);
-		free(d);
-	}
-}
+	struct procfs_node *spare;
+};
 
-int dtree_procfs_reset(void)
-{
-	if(g_dir != NULL) {
-		closedir(g_dir);
-		g_dir = NULL;
-	}
+/**
+ * Cursor of the depth-first walk. Every level of the path
+ * stack holds a reference of its node. The node on the top
+ * is the one to be visited, next is the position of the walk
+ * in its entries. Positions of the lower levels need not to be
+ * stored: a walk returning from a child continues just behind
+ * the child's entry. The cursor never reads a directory twice.
+ * Nodes rejected by its filter are never pushed.
+ */
+struct procfs_iter {
+	struct path_stack path;
+	size_t next;
+	int    end;
 
-	while(stack_depth(&g_path) > 1) {
-		void *p = stack_pop_fname(&g_path);
-		free(p);
-	}
+	struct dtree_filter_t filter;
+};
 
-	assert(!stack_empty(&g_path));
-	g_dir = opendir(stack_top(&g_path));
+/**
+ * Path of a device (an offset into paths of the phandle
+ * cache, relative to rootd) having the phandle.
+ */
+struct procfs_phandle {
+	uint32_t phandle;
+	size_t   path;
+};
 
-	return g_dir == NULL;
-}
+/**
+ * Phandles of the devices passed by the walks (sorted) and
+ * their paths. A look up by phandle descends along the path
+ * instead of walking the tree. When all is set a look up has
+ * walked the whole tree, a phandle not here is not of a device.
+ */
+struct procfs_phandles {
+	struct procfs_phandle *entry;
+	size_t count;
+	size_t cap;
+
+	char  *paths;
+	size_t paths_len;
+	size_t paths_cap;
+
+	int all;
+};
+
+/**
+ * State of an opened tree. The root node is referenced
+ * by the state during the whole life.
+ */
+struct procfs {
+	struct procfs_node *root;
+	struct procfs_node *spare;
+	char *rootd;
+
+	/**
+	 * Devices are allocated from the arena, it is
+	 * freed at once by dtree_procfs_close().
+	 */
+	struct dtree_arena arena;
+
+	/**
+	 * Number of readdir() calls since open.
+	 */
+	unsigned long readdir_count;
+
+	/**
+	 * Number of properties read since open.
+	 */
+	unsigned long prop_count;
+
+	/**
+	 * Number of live cursors.
+	 */
+	unsigned long iters;
+
+	/**
+	 * Reader of reg and compatible of a node by a single
+	 * batch. NULL when io_uring is unavailable or disabled.
+	 */
+	struct dtree_uring *uring;
+	unsigned char batch_reg[PROCFS_BATCH_REG];
+	char batch_compat[PROCFS_BATCH_COMPAT];
+
+	/**
+	 * Every property is read here by prop_read(), behind
+	 * the ones of prop_node read since prop_begin() (prop_len
+	 * bytes). Each prop_begin() of another node starts a new
+	 * generation, the buffer only grows.
+	 */
+	unsigned char *prop;
+	size_t prop_cap;
+	size_t prop_len;
+	unsigned long prop_gen;
+	const struct procfs_node *prop_node;
+
+	/**
+	 * Devices get the table of all their properties.
+	 */
+	int props;
+
+	/**
+	 * Walks return the providers (nodes without
+	 * reg that have a phandle) too.
+	 */
+	int providers;
+
+	/**
+	 * Filter every new cursor starts with.
+	 */
+	struct dtree_filter_t filter;
+
+	/**
+	 * Ranges of the device being built.
+	 */
+	struct dtree_reg_t *regs;
+	size_t regs_cap;
+
+	/**
+	 * Kept until close, a path that has gone stale is
+	 * detected by procfs_find_path() (the tree is walked).
+	 */
+	struct procfs_phandles phandles;
+
+	struct dtree_error *err;
+};
 
 static inline
-int st_is_dir(int st_mode)
+const char *scan_name(const struct procfs_scan *scan, size_t i)
 {
-	return S_ISDIR(st_mode);
+	return scan->names + scan->entry[i].name;
 }
 
-static inline
-int st_is_file(int st_mode)
+static
+void scan_clear(struct procfs_scan *scan)
+{
+	scan->names_len = 0;
+	scan->count     = 0;
+	scan->reg       = -1;
+	scan->compat    = -1;
+	scan->acells    = -1;
+	scan->scells    = -1;
+	scan->ranges    = -1;
+	scan->phandle   = -1;
+	scan->status    = -1;
+}
+
+static
+void scan_free(struct procfs_scan *scan)
 {
-	return S_ISREG(st_mode);
+	free(scan->names);
+	free(scan->entry);
+	memset(scan, 0, sizeof(struct procfs_scan));
 }
 
 static
-const char *file_path_from_stack(struct stack **path, const char *fname)
+int scan_add(struct procfs_scan *scan, const char *name, enum procfs_kind kind)
 {
-	assert(fname != NULL);
+	const size_t nlen = strlen(name) + 1;
 
-	const size_t fnamelen = strlen(fname);
-	struct stack *tmp = NULL;
-	size_t plen  = 0;
+	if(scan->names_len + nlen > scan->names_cap) {
+		size_t cap = scan->names_cap == 0? 256 : scan->names_cap;
+		while(scan->names_len + nlen > cap)
+			cap *= 2;
 
-	while(!stack_empty(path)) {
-		const void *frag = stack_move(path, &tmp);
-		assert(frag != NULL);
+		char *names = realloc(scan->names, cap);
+		if(names == NULL)
+			return 1;
 
-		plen  += strlen((const char *) frag) + 1;
+		scan->names     = names;
+		scan->names_cap = cap;
 	}
 
-	char *full = malloc(plen + fnamelen + 1);
-	if(full == NULL) {
-		while(!stack_empty(&tmp))
-			stack_move(&tmp, path);
+	if(scan->count == scan->cap) {
+		size_t cap = scan->cap == 0? 16 : scan->cap * 2;
 
-		return NULL;
+		struct procfs_entry *entry = realloc(scan->entry, cap * sizeof(struct procfs_entry));
+		if(entry == NULL)
+			return 1;
+
+		scan->entry = entry;
+		scan->cap   = cap;
 	}
 
-	char *p = full;
-	while(!stack_empty(&tmp)) {
-		const void *frag  = stack_move(&tmp, path);
-		const size_t flen = strlen((const char *) frag);
+	struct procfs_entry *e = &scan->entry[scan->count];
+	e->name = scan->names_len;
+	e->size = -1;
+	e->kind = kind;
+	e->gen  = 0;
+
+	memcpy(scan->names + scan->names_len, name, nlen);
+	scan->names_len += nlen;
+
+	if(kind == PROCFS_PROP && !strcmp(name, "reg"))
+		scan->reg = scan->count;
+	if(kind == PROCFS_PROP && !strcmp(name, "compatible"))
+		scan->compat = scan->count;
+	if(kind == PROCFS_PROP && !strcmp(name, "#address-cells"))
+		scan->acells = scan->count;
+	if(kind == PROCFS_PROP && !strcmp(name, "#size-cells"))
+		scan->scells = scan->count;
+	if(kind == PROCFS_PROP && !strcmp(name, "ranges"))
+		scan->ranges = scan->count;
+	// the older linux,phandle only when there is no phandle
+	if(kind == PROCFS_PROP && (!strcmp(name, "phandle")
+				|| (!strcmp(name, "linux,phandle") && scan->phandle < 0)))
+		scan->phandle = scan->count;
+	if(kind == PROCFS_PROP && !strcmp(name, "status"))
+		scan->status = scan->count;
+
+	scan->count += 1;
+	return 0;
+}
 
-		memcpy(p, frag, flen);
-		p[flen] = '/';
-		p += flen + 1;
+static
+void node_spare_free(struct procfs *pfs)
+{
+	while(pfs->spare != NULL) {
+		struct procfs_node *node = pfs->spare;
+		pfs->spare = node->spare;
+
+		scan_free(&node->scan);
+		dtree_xlat_free(node->xlat);
+		free(node->child);
+		free(node);
 	}
+}
 
-	assert((size_t) (p - full) == plen);
+/**
+ * Takes a node from the spare list (or allocates
+ * a new one).
+ */
+static
+struct procfs_node *node_get(struct procfs *pfs)
+{
+	struct procfs_node *node = pfs->spare;
 
-	if(fnamelen > 0) {
-		memcpy(p, fname, fnamelen);
-		p[fnamelen] = '\0';
+	if(node != NULL) {
+		pfs->spare = node->spare;
 	}
 	else {
-		full[plen - 1] = '\0';
+		node = calloc(1, sizeof(struct procfs_node));
+		if(node == NULL)
+			return NULL;
 	}
 
-	return full;
+	node->refs     = 1;
+	node->parent   = NULL;
+	node->index    = 0;
+	node->spare    = NULL;
+	node->disabled = -1;
+	return node;
 }
 
+/**
+ * Drops a reference of the node. The last one closes
+ * the node, moves it to the spare list and drops the
+ * reference of its parent.
+ */
 static
-FILE *path_fopen(struct stack **path, const char *fname, const char *mode)
+void node_put(struct procfs *pfs, struct procfs_node *node)
 {
-	const char *fpath = file_path_from_stack(path, fname);
-	if(fpath == NULL)
-		goto clean_and_exit;
+	while(node != NULL && --node->refs == 0) {
+		struct procfs_node *parent = node->parent;
 
-	FILE *file = fopen(fpath, mode);
-	if(file == NULL)
-		goto clean_and_exit;
+		if(parent != NULL)
+			parent->child[node->index] = NULL;
 
-	free((void *) fpath);
-	return file;
+		if(node->dir != NULL)
+			closedir(node->dir);
 
-clean_and_exit:
-	dtree_error_from_errno();
-	if(fpath != NULL)
-		free((void *) fpath);
-	return NULL;
+		dtree_xlat_free(node->xlat);
+		node->xlat  = NULL;
+		node->dir   = NULL;
+		node->spare = pfs->spare;
+		pfs->spare  = node;
+
+		node = parent;
+	}
+}
+
+static inline
+struct procfs_node *iter_top(struct procfs_iter *it)
+{
+	return (struct procfs_node *) path_stack_top(&it->path);
 }
 
+/**
+ * Index of the first entry of the cache with phandle
+ * greater or equal to the given one.
+ */
 static
-int path_stat(struct stack **path, const char *fname, struct stat *st)
+size_t phandles_lower(const struct procfs_phandles *ph, uint32_t phandle)
 {
-	const char *fpath = file_path_from_stack(path, fname);
-	if(fpath == NULL)
-		goto clean_and_exit;
+	size_t lo = 0;
+	size_t hi = ph->count;
 
-	if(stat(fpath, st))
-		goto clean_and_exit;
+	while(lo < hi) {
+		const size_t mid = lo + (hi - lo) / 2;
 
-	free((void *) fpath);
-	return 0;
+		if(ph->entry[mid].phandle < phandle)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
 
-clean_and_exit:
-	dtree_error_from_errno();
-	if(fpath != NULL)
-		free((void *) fpath);
-	return 1;
+	return lo;
 }
 
+/**
+ * Path of the device with the phandle or NULL when
+ * it is not in the cache.
+ */
 static
-int path_is_file(struct stack **path, const char *fname)
+const char *phandles_path(const struct procfs_phandles *ph, uint32_t phandle)
 {
-	struct stat st;
-	if(path_stat(path, fname, &st))
-		return 0;
+	const size_t i = phandles_lower(ph, phandle);
+
+	if(i == ph->count || ph->entry[i].phandle != phandle)
+		return NULL;
 
-	return st_is_file(st.st_mode);
+	return ph->paths + ph->entry[i].path;
 }
 
+/**
+ * Remembers the path of the device with the phandle (a known
+ * one is replaced when the device has moved). Returns non-zero
+ * on error (errno is set).
+ */
 static
-int path_is_dir(struct stack **path, const char *fname)
+int phandles_add(struct procfs_phandles *ph, uint32_t phandle, const char *path)
 {
-	struct stat st;
-	if(path_stat(path, fname, &st))
+	const size_t i = phandles_lower(ph, phandle);
+	const int known = i < ph->count && ph->entry[i].phandle == phandle;
+
+	if(known && !strcmp(ph->paths + ph->entry[i].path, path))
 		return 0;
 
-	return st_is_dir(st.st_mode);
-}
+	const size_t len = strlen(path) + 1;
 
-static
-DIR *opendir_on_stack(struct stack **path)
-{
-	const char *fpath = file_path_from_stack(path, "");
-	if(fpath == NULL)
-		goto clean_and_exit;
+	if(ph->paths_len + len > ph->paths_cap) {
+		size_t cap = ph->paths_cap == 0? 256 : ph->paths_cap;
+		while(ph->paths_len + len > cap)
+			cap *= 2;
+
+		char *paths = realloc(ph->paths, cap);
+		if(paths == NULL)
+			return 1;
+
+		ph->paths     = paths;
+		ph->paths_cap = cap;
+	}
 
-	DIR *dir = opendir(fpath);
-	if(dir == NULL)
-		goto clean_and_exit;
+	if(!known && ph->count == ph->cap) {
+		const size_t cap = ph->cap == 0? 16 : ph->cap * 2;
 
-	free((void *) fpath);
-	return dir;
+		struct procfs_phandle *entry = realloc(ph->entry, cap * sizeof(struct procfs_phandle));
+		if(entry == NULL)
+			return 1;
+
+		ph->entry = entry;
+		ph->cap   = cap;
+	}
+
+	if(!known) {
+		memmove(ph->entry + i + 1, ph->entry + i, (ph->count - i) * sizeof(struct procfs_phandle));
+		ph->entry[i].phandle = phandle;
+		ph->count += 1;
+	}
 
-clean_and_exit:
-	dtree_error_from_errno();
-	if(fpath != NULL)
-		free((void *) fpath);
-	return NULL;
+	memcpy(ph->paths + ph->paths_len, path, len);
+	ph->entry[i].path = ph->paths_len;
+	ph->paths_len += len;
+	return 0;
 }
 
 static
-int dir_has_file(DIR *curr, struct stack **path, const char *fname)
+void phandles_free(struct procfs_phandles *ph)
 {
-	rewinddir(curr);
-	struct dirent *d;
+	free(ph->entry);
+	free(ph->paths);
+	memset(ph, 0, sizeof(struct procfs_phandles));
+}
 
-	while((d = readdir(curr)) != NULL) {
-		if(strcmp(d->d_name, fname))
-			continue;
+static inline
+struct dirent *dir_read(struct procfs *pfs, DIR *dir)
+{
+	pfs->readdir_count += 1;
+	return readdir(dir);
+}
 
-		if(path_is_file(path, fname))
-			return 1;
+static
+DIR *opendir_at(struct procfs *pfs, int fd, const char *name)
+{
+	int dfd = openat(fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if(dfd < 0) {
+		dtree_error_from_errno(pfs->err);
+		return NULL;
+	}
 
-		if(dtree_iserror())
-			return 0;
+	DIR *dir = fdopendir(dfd);
+	if(dir == NULL) {
+		dtree_error_from_errno(pfs->err);
+		close(dfd);
 	}
 
-	return 0;
+	return dir;
 }
 
+/**
+ * Determines type of the entry (DT_DIR, DT_REG, ...).
+ * The d_type is trusted when the filesystem provides it,
+ * otherwise (or for symlinks) the entry is stat'ed relative
+ * to the directory. Returns DT_UNKNOWN on error.
+ */
 static
-DIR *open_dir_from_dirent(struct dirent *d, struct stack **path)
+int dirent_type(struct procfs *pfs, DIR *curr, const struct dirent *d)
 {
-	if(d == NULL)
-		return NULL;
+	if(d->d_type != DT_UNKNOWN && d->d_type != DT_LNK)
+		return d->d_type;
 
-	if(stack_push_fname(path, d->d_name)) {
-		dtree_error_from_errno();
-		return NULL;
+	struct stat st;
+	if(fstatat(dirfd(curr), d->d_name, &st, 0)) {
+		dtree_error_from_errno(pfs->err);
+		return DT_UNKNOWN;
 	}
 
-	return opendir_on_stack(path);
+	if(S_ISDIR(st.st_mode))
+		return DT_DIR;
+	if(S_ISREG(st.st_mode))
+		return DT_REG;
+
+	return DT_UNKNOWN;
 }
 
+/**
+ * Reads the whole directory once and classifies
+ * its entries into properties and child nodes.
+ */
 static
-DIR *go_next_dir(DIR *curr, struct stack **path)
+int node_scan(struct procfs *pfs, DIR *curr, struct procfs_scan *scan)
 {
 	struct dirent *d;
+	scan_clear(scan);
 
-	while((d = readdir(curr)) != NULL) {
+	while((d = dir_read(pfs, curr)) != NULL) {
 		if(!strcmp(d->d_name, ".") || !strcmp(d->d_name, ".."))
 			continue;
 
-		if(path_is_dir(path, d->d_name))
-			break;
+		int type = dirent_type(pfs, curr, d);
+		if(type == DT_UNKNOWN && dtree_error_isset(pfs->err))
+			return 1;
 
-		if(dtree_iserror())
-			return NULL;
+		if(type != DT_DIR && type != DT_REG)
+			continue;
+
+		if(scan_add(scan, d->d_name, type == DT_DIR? PROCFS_NODE : PROCFS_PROP)) {
+			dtree_error_from_errno(pfs->err);
+			return 1;
+		}
 	}
 
-	return open_dir_from_dirent(d, path);
+	return 0;
 }
 
 static
-DIR *go_up_next_dir(struct stack **path)
+void prop_begin(struct procfs *pfs, const struct procfs_node *node);
+static
+long prop_read(struct procfs *pfs, struct procfs_node *node, long i);
+static
+const void *prop_data(const struct procfs *pfs, const struct procfs_node *node, long i);
+static
+int node_disabled(struct procfs *pfs, struct procfs_node *node, const struct dtree_filter_t *f);
+
+/**
+ * Reads #address-cells and #size-cells of the node (the layout
+ * of reg of its children), defaults are used when it has none.
+ * Creates the translation of the addresses of its children from
+ * its ranges and the translation of the parent (NULL for the root,
+ * whose children use CPU addresses).
+ */
+static
+int node_read_bus(struct procfs *pfs, struct procfs_node *node,
+		const struct procfs_node *parent)
 {
-	DIR *next = NULL;
+	node->acells = DTREE_ADDR_CELLS;
+	node->scells = DTREE_SIZE_CELLS;
+	prop_begin(pfs, node);
 
-	do {
-		if(stack_depth(path) == 1) // never loose the rootd
-			return NULL;
+	if(node->scan.acells >= 0) {
+		const long len = prop_read(pfs, node, node->scan.acells);
+		if(len < 0)
+			return 1;
 
-		const char *dname = (const char *) stack_pop_fname(path);
+		node->acells = dtree_cells_decode(prop_data(pfs, node, node->scan.acells),
+				(size_t) len, DTREE_ADDR_CELLS);
+	}
 
-		DIR *dir = opendir_on_stack(path);
-		if(dir == NULL) {
-			dtree_error_from_errno();
-			free((void *) dname);
-			return NULL;
-		}
+	if(node->scan.scells >= 0) {
+		const long len = prop_read(pfs, node, node->scan.scells);
+		if(len < 0)
+			return 1;
 
-		struct dirent *d;
-		while((d = readdir(dir)) != NULL) {
-			if(!strcmp(d->d_name, dname))
-				break;
-		}
-		free((void *) dname);
+		node->scells = dtree_cells_decode(prop_data(pfs, node, node->scan.scells),
+				(size_t) len, DTREE_SIZE_CELLS);
+	}
 
-		next = go_next_dir(dir, path);
-		if(next == NULL && dtree_iserror()) {
-			closedir(dir);
-			return NULL;
-		}
+	if(parent == NULL) {
+		node->xlat = &dtree_xlat_identity;
+		return 0;
+	}
 
-		closedir(dir);
-	} while(next == NULL);
+	const void *ranges = NULL;
+	long len = 0;
 
-	return next;
+	if(node->scan.ranges >= 0) {
+		len = prop_read(pfs, node, node->scan.ranges);
+		if(len < 0)
+			return 1;
+
+		ranges = prop_data(pfs, node, node->scan.ranges);
+	}
+
+	node->xlat = dtree_xlat_new(parent->xlat, ranges, (size_t) len,
+			node->acells, parent->acells, node->scells);
+	if(node->xlat == NULL) {
+		dtree_error_from_errno(pfs->err);
+		return 1;
+	}
+
+	return 0;
 }
 
+/**
+ * Opens and scans the node directory name relative to fd.
+ * No property is read, see node_read_bus().
+ */
 static
-void *file_read_and_close(FILE *file, size_t *flen)
+struct procfs_node *node_open(struct procfs *pfs, int fd, const char *name)
 {
-	struct stat file_stat;
-	if(fstat(fileno(file), &file_stat)) {
-		dtree_error_from_errno();
-		fclose(file);
+	struct procfs_node *node = node_get(pfs);
+	if(node == NULL) {
+		dtree_error_from_errno(pfs->err);
 		return NULL;
 	}
 
-	const size_t fsize = file_stat.st_size;
-
-	void *m = malloc(fsize + 1);
-	if(m == NULL) {
-		dtree_error_from_errno();
-		fclose(file);
-		return NULL;
-	}
-	
-	size_t rlen = fread(m, 1, fsize, file);
-	if(rlen < fsize) {
-		dtree_error_from_errno();
-		free(m);
-		fclose(file);
+	node->dir = opendir_at(pfs, fd, name);
+	if(node->dir == NULL) {
+		node_put(pfs, node);
 		return NULL;
 	}
 
-	((char *) m)[fsize] = '\0';
-	fclose(file);
-
-	*flen = fsize;
-	return m;
-}
-
-static
-uint32_t convert_raw32(const char *s) {
-	uint32_t value = 0;
-
-	for(int i = 0; i < 4; ++i) {
-		uint32_t val = (uint32_t) s[3 - i];	
-		val &= 0xFF;
-		value += val << i * 8;
+	if(node_scan(pfs, node->dir, &node->scan)) {
+		node_put(pfs, node);
+		return NULL;
 	}
 
-	return value;
+	return node;
 }
 
+/**
+ * Returns (a new reference of) the child node at the given
+ * entry of parent. The child is opened only when no other
+ * cursor holds it. Its bus is read by the first cursor that
+ * accepts it (xlat is NULL until then).
+ */
 static
-int dev_parse_reg(struct dtree_dev_t *dev, struct stack **path, const char *fname)
+struct procfs_node *node_child(struct procfs *pfs, struct procfs_node *parent, size_t i)
 {
-	FILE *regf = path_fopen(path, fname, "r");
-	if(regf == NULL)
-		return 1;
+	if(parent->child_cap < parent->scan.count) {
+		struct procfs_node **child = realloc(parent->child,
+				parent->scan.count * sizeof(struct procfs_node *));
+		if(child == NULL) {
+			dtree_error_from_errno(pfs->err);
+			return NULL;
+		}
 
-	size_t length = 0;
-	const char *content = file_read_and_close(regf, &length);
-	if(content == NULL)
-		return 2;
+		memset(child + parent->child_cap, 0,
+				(parent->scan.count - parent->child_cap) * sizeof(struct procfs_node *));
+		parent->child     = child;
+		parent->child_cap = parent->scan.count;
+	}
 
-	if(length != 8) {
-		dtree_error_clear();
-		free((void *) content);
-		return 3;
+	struct procfs_node *node = parent->child[i];
+	if(node != NULL) {
+		node->refs += 1;
+		return node;
 	}
 
-	dev->base = convert_raw32(content);
-	dev->high = dev->base + convert_raw32(content + 4) - 1;
+	node = node_open(pfs, dirfd(parent->dir), scan_name(&parent->scan, i));
+	if(node == NULL)
+		return NULL;
 
-	free((void *) content);
-	return 0;
+	node->parent = parent;
+	node->index  = i;
+	parent->refs += 1;
+	parent->child[i] = node;
+	return node;
 }
 
-static
-const char **convert_compat(const char *compat, const size_t len)
+/**
+ * This implementation doesn't accept a regular
+ * file as rootd.
+ */
+void *dtree_procfs_open(const char *rootd, const struct dtree_opts *opts, struct dtree_error *err)
 {
-	// count entries
-	int entries = 0;
-
-	// each '\0' is end of an entry
-	for(const char *p = compat; (size_t) (p - compat) < len; ++p) {
-		if(*p == '\0')
-			entries += 1;
+	if(rootd == NULL) {
+		dtree_error_set(err, EINVAL);
+		return NULL;
 	}
 
-	// alloc pointers for entries and one pointer for last NULL
-	const char **array = (const char **) malloc((entries + 1) * sizeof(char *));
-	if(array == NULL)
+	struct procfs *pfs = calloc(1, sizeof(struct procfs));
+	if(pfs == NULL) {
+		dtree_error_from_errno(err);
 		return NULL;
+	}
 
-	// assign pointers to point into the compat string
-	int off = 0;
+	pfs->err   = err;
+	pfs->props  = opts->props;
+	pfs->providers = opts->providers;
+	pfs->filter = opts->filter;
+	pfs->rootd = strdup(rootd);
+	if(pfs->rootd == NULL) {
+		dtree_error_from_errno(err);
+		dtree_procfs_close(pfs);
+		return NULL;
+	}
 
-	for(int i = 0; i < entries; ++i) {
-		array[i] = compat + off;
+	pfs->root = node_open(pfs, AT_FDCWD, rootd);
+	if(pfs->root == NULL || node_read_bus(pfs, pfs->root, NULL)) {
+		dtree_procfs_close(pfs);
+		return NULL;
+	}
 
-		// find next end of entry
-		while(compat[off] != '\0')
-			off += 1;
+	// falls back to the plain syscalls on failure
+	if(opts->uring)
+		pfs->uring = dtree_uring_new(2);
 
-		off += 1; // skip '\0', point to the next entry
-	}
+	return pfs;
+}
 
-	array[entries] = NULL;
-	return array;
+void dtree_procfs_close(void *state)
+{
+	struct procfs *pfs = (struct procfs *) state;
+
+	assert(pfs->iters == 0);
+
+	node_put(pfs, pfs->root);
+	node_spare_free(pfs);
+	dtree_arena_free(&pfs->arena);
+	dtree_uring_free(pfs->uring);
+	free(pfs->prop);
+	free(pfs->regs);
+	phandles_free(&pfs->phandles);
+	free(pfs->rootd);
+	free(pfs);
 }
 
-static
-int dev_parse_compat(struct dtree_dev_t *dev, struct stack **path, const char *fname)
+void *dtree_procfs_iter_new(void *state)
 {
-	FILE *regf = path_fopen(path, fname, "r");
-	if(regf == NULL)
-		return 1;
+	struct procfs *pfs = (struct procfs *) state;
 
-	size_t length = 0;
-	const char *content = file_read_and_close(regf, &length);
-	if(content == NULL)
-		return 2;
+	struct procfs_iter *it = calloc(1, sizeof(struct procfs_iter));
+	if(it == NULL)
+		return NULL;
 
-	dev->compat = convert_compat(content, length);
-	if(dev->compat == NULL) {
-		dtree_error_from_errno();
-		return 1;
+	if(path_stack_push(&it->path, pfs->rootd, pfs->root)) {
+		free(it);
+		return NULL;
 	}
 
-	return 0;
+	it->filter = pfs->filter;
+	pfs->root->refs += 1;
+	pfs->iters += 1;
+	return it;
 }
 
-static
-struct dtree_dev_t *dev_from_dir(DIR *curr, struct stack **path)
+void *dtree_procfs_iter_clone(void *state, const void *iter)
 {
-	struct dtree_dev_t *dev = malloc(sizeof(struct dtree_dev_t));
-	if(dev == NULL) {
-		dtree_error_from_errno();
-		return NULL;
-	}
+	struct procfs *pfs = (struct procfs *) state;
+	const struct procfs_iter *src = (const struct procfs_iter *) iter;
 
-	assert(stack_depth(path) > 1); // the root is never a device
-
-	dev->compat = &NULL_ENTRY;
-	dev->name = strdup((char *) stack_top(path));
-	if(dev->name == NULL) {
-		dtree_error_from_errno();
-		free(dev);
+	struct procfs_iter *it = calloc(1, sizeof(struct procfs_iter));
+	if(it == NULL)
 		return NULL;
-	}
 
-	struct dirent *d;
-	rewinddir(curr);
-	while((d = readdir(curr)) != NULL) {
-		if(!path_is_file(path, d->d_name))
-			continue;
+	for(size_t i = 0; i < path_stack_depth(&src->path); ++i) {
+		const struct path_level *l = &src->path.level[i];
 
-		if(!strcmp(d->d_name, "reg")) {
-			if(dev_parse_reg(dev, path, "reg"))
-				goto clean_and_exit;
-		}
-		if(!strcmp(d->d_name, "compatible")) {
-			if(dev_parse_compat(dev, path, "compatible"))
-				goto clean_and_exit;
+		if(path_stack_push(&it->path, src->path.path + l->name, l->data)) {
+			path_stack_free(&it->path);
+			free(it);
+			return NULL;
 		}
 	}
 
-	return dev;
+	// all pushed, take the references
+	for(size_t i = 0; i < path_stack_depth(&it->path); ++i)
+		((struct procfs_node *) it->path.level[i].data)->refs += 1;
 
-clean_and_exit:
-	dtree_procfs_dev_free(dev);
-	return NULL;
+	it->next   = src->next;
+	it->end    = src->end;
+	it->filter = src->filter;
+	pfs->iters += 1;
+	return it;
 }
 
-struct dtree_dev_t *dtree_procfs_next(void)
+void dtree_procfs_iter_free(void *state, void *iter)
 {
-	if(g_dir == NULL)
-		return NULL;
+	struct procfs *pfs = (struct procfs *) state;
+	struct procfs_iter *it = (struct procfs_iter *) iter;
 
-	struct dtree_dev_t *dev = NULL;
+	while(!path_stack_empty(&it->path))
+		node_put(pfs, path_stack_pop(&it->path));
 
-	while(dev == NULL && g_dir != NULL) {
-		if(dir_has_file(g_dir, &g_path, "reg")) {
-			dev = dev_from_dir(g_dir, &g_path);
+	path_stack_free(&it->path);
+	free(it);
+	pfs->iters -= 1;
+}
 
-			if(dev == NULL && dtree_iserror())
-				return NULL;
-		}
+/**
+ * Returns the cursor to the root. When no other cursor
+ * exists the root is read again to reflect changes.
+ */
+int dtree_procfs_reset(void *state, void *iter)
+{
+	struct procfs *pfs = (struct procfs *) state;
+	struct procfs_iter *it = (struct procfs_iter *) iter;
 
-		rewinddir(g_dir);
-		DIR *dir = go_next_dir(g_dir, &g_path);
-		if(dir == NULL && dtree_iserror()) {
-			return NULL;
-		}
-		
-		if(dir == NULL)
-			dir = go_up_next_dir(&g_path);
+	while(path_stack_depth(&it->path) > 1)
+		node_put(pfs, path_stack_pop(&it->path));
 
-		if(dir == NULL && dtree_iserror()) {
-			return NULL;
-		}
+	assert(iter_top(it) == pfs->root);
+	it->next = 0;
+	it->end  = 0;
 
-		closedir(g_dir);
-		g_dir = dir;
+	if(pfs->iters > 1)
+		return 0;
+
+	// no child is referenced by now
+	struct procfs_node *root = pfs->root;
+	rewinddir(root->dir);
+
+	if(node_scan(pfs, root->dir, &root->scan)) {
+		it->end = 1;
+		return 1;
 	}
 
-	return dev;
+	if(root->child != NULL)
+		memset(root->child, 0, root->child_cap * sizeof(struct procfs_node *));
+
+	return 0;
 }
 
-void dtree_procfs_dev_free(struct dtree_dev_t *dev)
+unsigned long dtree_procfs_readdir_count(const struct dtree_ctx *ctx)
 {
-	assert(dev != NULL);
+	assert(ctx->backend == &dtree_procfs_backend);
+	return ((const struct procfs *) ctx->state)->readdir_count;
+}
 
-	if(dev->name != NULL)
-		free((void *) dev->name);
+unsigned long dtree_procfs_prop_count(const struct dtree_ctx *ctx)
+{
+	assert(ctx->backend == &dtree_procfs_backend);
+	return ((const struct procfs *) ctx->state)->prop_count;
+}
 
-	assert(dev->compat != NULL);
-	if(dev->compat != &NULL_ENTRY) {
-		free((void *) dev->compat[0]);
-		free((void *) dev->compat);
-	}
+/**
+ * Takes (a new reference of) the child node at the i-th entry
+ * of the top of the cursor into node when the filter of the
+ * cursor accepts it, its bus is read then. Returns 0 when
+ * accepted, 1 when rejected and -1 on error.
+ */
+static
+int iter_child(struct procfs *pfs, struct procfs_iter *it, size_t i,
+		struct procfs_node **node)
+{
+	struct procfs_node *curr = iter_top(it);
+	const size_t depth = path_stack_depth(&it->path); // of the children
 
-	dev->name   = NULL;
-	dev->compat = NULL;
-	dev->base = 0;
-	dev->high = 0;
+	// rejected by name or depth, the node is not even opened
+	if(dtree_filter_skips(&it->filter, scan_name(&curr->scan, i), depth))
+		return 1;
 
-	free(dev);
-}
+	*node = node_child(pfs, curr, i);
+	if(*node == NULL)
+		return -1;
+
+	// the bus of a rejected node is not read
+	int disabled = node_disabled(pfs, *node, &it->filter);
+	if(disabled == 0 && (*node)->xlat == NULL && node_read_bus(pfs, *node, curr))
+		disabled = -1;
+
+	if(disabled != 0) {
+		node_put(pfs, *node);
+		*node = NULL;
+	}
+
+	return disabled;
+}
+
+/**
+ * Descends into the next child node of the top of the cursor
+ * accepted by its filter. Returns NULL when there is no more child.
+ */
+static
+struct procfs_node *go_next_node(struct procfs *pfs, struct procfs_iter *it)
+{
+	const struct procfs_scan *scan = &iter_top(it)->scan;
+	struct procfs_node *node = NULL;
+
+	for(; it->next < scan->count; it->next += 1) {
+		if(scan->entry[it->next].kind != PROCFS_NODE)
+			continue;
+
+		const int rejected = iter_child(pfs, it, it->next, &node);
+		if(rejected == 0)
+			break;
+		if(rejected < 0)
+			return NULL;
+	}
+
+	if(node == NULL)
+		return NULL;
+
+	if(path_stack_push(&it->path, scan_name(scan, it->next), node)) {
+		dtree_error_from_errno(pfs->err);
+		node_put(pfs, node);
+		return NULL;
+	}
+
+	it->next = 0;
+	return node;
+}
+
+/**
+ * Leaves the current (fully traversed) node and
+ * continues in its parent at the position where it
+ * stopped.
+ */
+static
+struct procfs_node *go_up_next_node(struct procfs *pfs, struct procfs_iter *it)
+{
+	struct procfs_node *next = NULL;
+
+	do {
+		if(path_stack_depth(&it->path) == 1) // never loose the rootd
+			return NULL;
+
+		struct procfs_node *node = path_stack_pop(&it->path);
+		it->next = node->index + 1;
+		node_put(pfs, node);
+
+		next = go_next_node(pfs, it);
+		if(next == NULL && dtree_error_isset(pfs->err))
+			return NULL;
+	} while(next == NULL);
+
+	return next;
+}
+
+static
+int prop_grow(struct procfs *pfs)
+{
+	const size_t cap = pfs->prop_cap == 0? PROCFS_PROP_MIN : pfs->prop_cap * 2;
+
+	unsigned char *prop = realloc(pfs->prop, cap);
+	if(prop == NULL)
+		return 1;
+
+	pfs->prop     = prop;
+	pfs->prop_cap = cap;
+	return 0;
+}
+
+/**
+ * Starts reading properties of the node. Unless they are the last
+ * node's, a new generation of the property buffer starts and the
+ * properties read before are read again when asked. (A released node
+ * reused for another one has no property of an old generation.)
+ */
+static
+void prop_begin(struct procfs *pfs, const struct procfs_node *node)
+{
+	if(pfs->prop_node == node)
+		return;
+
+	pfs->prop_node = node;
+	pfs->prop_len  = 0;
+	pfs->prop_gen += 1;
+}
+
+/**
+ * Reads the whole i-th property of the node into the property
+ * buffer (by openat and read, the file is not stat'ed) and stores
+ * its size into the scan. A property read since prop_begin() is
+ * not read again. The data (see prop_data()) stay valid until the
+ * next read. Returns the size or -1 on error.
+ */
+static
+long prop_read(struct procfs *pfs, struct procfs_node *node, long i)
+{
+	struct procfs_entry *e = &node->scan.entry[i];
+
+	if(e->gen == pfs->prop_gen)
+		return e->size;
+
+	pfs->prop_count += 1;
+
+	int fd = openat(dirfd(node->dir), scan_name(&node->scan, i), O_RDONLY | O_CLOEXEC);
+	if(fd < 0) {
+		dtree_error_from_errno(pfs->err);
+		return -1;
+	}
+
+	const size_t off = pfs->prop_len;
+	size_t len = off;
+
+	for(;;) {
+		if(len == pfs->prop_cap && prop_grow(pfs))
+			break;
+
+		ssize_t rlen = read(fd, pfs->prop + len, pfs->prop_cap - len);
+		if(rlen < 0 && errno == EINTR)
+			continue;
+		if(rlen < 0)
+			break;
+
+		len += rlen;
+
+		// a short read of a regular file is its end
+		if(rlen == 0 || len < pfs->prop_cap) {
+			close(fd);
+			e->size = (long) (len - off);
+			e->off  = off;
+			e->gen  = pfs->prop_gen;
+			pfs->prop_len = len;
+			return e->size;
+		}
+	}
+
+	dtree_error_from_errno(pfs->err);
+	close(fd);
+	return -1;
+}
+
+/**
+ * Data of the i-th property of the node read by prop_read().
+ */
+static
+const void *prop_data(const struct procfs *pfs, const struct procfs_node *node, long i)
+{
+	return pfs->prop + node->scan.entry[i].off;
+}
+
+/**
+ * Stores the i-th property of the node read by other means
+ * (the batch) as if it was read by prop_read().
+ */
+static
+int prop_store(struct procfs *pfs, struct procfs_node *node, long i, const void *data, size_t len)
+{
+	struct procfs_entry *e = &node->scan.entry[i];
+
+	while(pfs->prop_len + len > pfs->prop_cap) {
+		if(prop_grow(pfs)) {
+			dtree_error_from_errno(pfs->err);
+			return 1;
+		}
+	}
+
+	memcpy(pfs->prop + pfs->prop_len, data, len);
+	e->size = (long) len;
+	e->off  = pfs->prop_len;
+	e->gen  = pfs->prop_gen;
+	pfs->prop_len += len;
+	return 0;
+}
+
+/**
+ * Tests the node against the status part of the filter. The status
+ * is read only once and only when the filter asks for it. Returns 1
+ * when the node is to be skipped, 0 when not and -1 on error.
+ */
+static
+int node_disabled(struct procfs *pfs, struct procfs_node *node, const struct dtree_filter_t *f)
+{
+	if(!f->skip_disabled || node->scan.status < 0)
+		return 0;
+
+	if(node->disabled < 0) {
+		prop_begin(pfs, node);
+
+		const long len = prop_read(pfs, node, node->scan.status);
+		if(len < 0)
+			return -1;
+
+		node->disabled = dtree_filter_disabled(f, prop_data(pfs, node, node->scan.status), (size_t) len);
+	}
+
+	return node->disabled;
+}
+
+/**
+ * Whether the i-th entry of the node of the phandle goes into
+ * the property table. Without the table (disabled) a node having
+ * a phandle still gets its #*-cells there (see prop_is_cells()).
+ */
+static
+int prop_in_table(const struct procfs *pfs, const struct procfs_node *node,
+		size_t i, uint32_t phandle)
+{
+	if(node->scan.entry[i].kind != PROCFS_PROP)
+		return 0;
+
+	return pfs->props || (phandle != 0 && prop_is_cells(scan_name(&node->scan, i)));
+}
+
+/**
+ * Reads all properties of the table of the node (see
+ * prop_in_table()), each of them once.
+ */
+static
+int node_read_props(struct procfs *pfs, struct procfs_node *node, uint32_t phandle)
+{
+	if(!pfs->props && phandle == 0)
+		return 0;
+
+	for(size_t i = 0; i < node->scan.count; ++i) {
+		if(prop_in_table(pfs, node, i, phandle) && prop_read(pfs, node, (long) i) < 0)
+			return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Keys of a lookup. Each of them is tested as soon as the data it
+ * needs are known: the name before any property is read, the address
+ * range right after reg (compatible of a device out of the range is
+ * not read) and compatible before the device is built. A NULL key
+ * (or has_range 0) matches anything, so does a NULL match.
+ */
+struct procfs_match {
+	const char  *name;
+	const char  *compat;
+	int          has_range;
+	int          cpu; // lo..hi are CPU addresses
+	dtree_addr_t lo;
+	dtree_addr_t hi;
+	uint32_t     phandle; // 0 matches anything
+};
+
+/**
+ * Tells whether the node may be a device: it has reg, or it has
+ * a phandle and the walk returns providers or looks up a phandle.
+ */
+static
+int match_kind(const struct procfs_match *m, const struct procfs *pfs,
+		const struct procfs_node *node)
+{
+	if(node->scan.reg >= 0)
+		return 1;
+
+	return node->scan.phandle >= 0 && (pfs->providers || (m != NULL && m->phandle != 0));
+}
+
+static
+int match_name(const struct procfs_match *m, const char *node_name)
+{
+	return m == NULL || m->name == NULL || name_matches(m->name, node_name);
+}
+
+/**
+ * Tests all nreg ranges in pfs->regs (translated by the bus
+ * of the parent when the key is a CPU address).
+ */
+static
+int match_range(const struct procfs_match *m, const struct procfs *pfs,
+		const struct procfs_node *parent, size_t nreg)
+{
+	if(m == NULL || !m->has_range)
+		return 1;
+
+	for(size_t i = 0; i < nreg; ++i) {
+		const struct dtree_reg_t *r = &pfs->regs[i];
+		const dtree_addr_t base = m->cpu? dtree_xlat_addr(parent->xlat, r->base) : r->base;
+
+		if(m->cpu && base == DTREE_ADDR_NONE)
+			continue;
+
+		if(base <= m->hi && dtree_reg_high(base, r->size) >= m->lo)
+			return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Tests the raw compatible property (len bytes, entries
+ * terminated by '\0') for the compatible key.
+ */
+static
+int match_compat(const struct procfs_match *m, const char *compat, size_t len)
+{
+	if(m == NULL || m->compat == NULL)
+		return 1;
+
+	const size_t klen = strlen(m->compat);
+
+	for(size_t off = 0; off < len; ) {
+		const char *end = memchr(compat + off, '\0', len - off);
+		if(end == NULL)
+			break; // unterminated entry is not an entry
+
+		const size_t elen = (size_t) (end - (compat + off));
+		if(elen == klen && !memcmp(compat + off, m->compat, klen))
+			return 1;
+
+		off += elen + 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Reads the phandle of the node (0 when it has none or it
+ * is not a single cell). Returns 0 on success, 1 on error.
+ */
+static
+int node_read_phandle(struct procfs *pfs, struct procfs_node *node, uint32_t *phandle)
+{
+	*phandle = 0;
+
+	if(node->scan.phandle < 0)
+		return 0;
+
+	const long len = prop_read(pfs, node, node->scan.phandle);
+	if(len < 0)
+		return 1;
+
+	if(len == 4)
+		dtree_cells_read32(prop_data(pfs, node, node->scan.phandle), 1, phandle);
+
+	return 0;
+}
+
+/**
+ * Decodes reg (len bytes) by the cells of the parent into the ranges
+ * buffer. Returns 0 when the reg describes a device (nreg is set),
+ * 1 on error and 2 when the node is not a device.
+ */
+static
+int reg_decode(struct procfs *pfs, const void *reg, size_t len,
+		const struct procfs_node *parent, size_t *nreg)
+{
+	const size_t count = dtree_reg_count(len, parent->acells, parent->scells);
+	if(count == 0)
+		return 2;
+
+	if(count > pfs->regs_cap) {
+		struct dtree_reg_t *regs = realloc(pfs->regs, count * sizeof(struct dtree_reg_t));
+		if(regs == NULL) {
+			dtree_error_from_errno(pfs->err);
+			return 1;
+		}
+
+		pfs->regs     = regs;
+		pfs->regs_cap = count;
+	}
+
+	dtree_reg_decode(reg, count, parent->acells, parent->scells, pfs->regs);
+	*nreg = count;
+	return 0;
+}
+
+/**
+ * Reads and decodes reg of the node (see reg_decode()).
+ */
+static
+int node_parse_reg(struct procfs *pfs, struct procfs_node *node,
+		const struct procfs_node *parent, size_t *nreg)
+{
+	const long len = prop_read(pfs, node, node->scan.reg);
+	if(len < 0)
+		return 1;
+
+	return reg_decode(pfs, prop_data(pfs, node, node->scan.reg), (size_t) len, parent, nreg);
+}
+
+/**
+ * Reads reg and compatible of the node into the batch buffers
+ * by a single dtree_uring_read() and decodes reg. Returns 0 when
+ * the node is a device (compatible is rd[1] when present), 1 on
+ * error, 2 when the node is not a device and 3 when the node
+ * must be read by the plain syscalls (a property is longer
+ * than its buffer or the ring has failed).
+ */
+static
+int node_read_batch(struct procfs *pfs, struct procfs_node *node,
+		const struct procfs_node *parent, struct dtree_uring_read *rd, size_t *nreg)
+{
+	size_t n = 0;
+
+	rd[n].name = scan_name(&node->scan, node->scan.reg);
+	rd[n].buf  = pfs->batch_reg;
+	rd[n].len  = sizeof(pfs->batch_reg);
+	n += 1;
+
+	if(node->scan.compat >= 0) {
+		rd[n].name = scan_name(&node->scan, node->scan.compat);
+		rd[n].buf  = pfs->batch_compat;
+		rd[n].len  = sizeof(pfs->batch_compat);
+		n += 1;
+	}
+
+	pfs->prop_count += n;
+
+	if(dtree_uring_read(pfs->uring, dirfd(node->dir), rd, n)) {
+		dtree_uring_free(pfs->uring); // do not try it again
+		pfs->uring = NULL;
+		return 3;
+	}
+
+	// reg decides first, as node_parse_reg() does
+	for(size_t i = 0; i < n; ++i) {
+		if(rd[i].res < 0) {
+			dtree_errno_set(pfs->err, (int) -rd[i].res);
+			return 1;
+		}
+
+		if((size_t) rd[i].res == rd[i].len)
+			return 3; // may be longer
+
+		node->scan.entry[i == 0? node->scan.reg : node->scan.compat].size = rd[i].res;
+
+		if(i > 0)
+			continue;
+
+		int err = reg_decode(pfs, rd[0].buf, (size_t) rd[0].res, parent, nreg);
+		if(err)
+			return err;
+	}
+
+	return 0;
+}
+
+static
+size_t compat_entries(const char *compat, size_t len)
+{
+	size_t entries = 0;
+
+	// each '\0' is end of an entry
+	for(size_t i = 0; i < len; ++i) {
+		if(compat[i] == '\0')
+			entries += 1;
+	}
+
+	return entries;
+}
+
+static inline
+size_t ptr_align(size_t off)
+{
+	return (off + sizeof(char *) - 1) & ~(sizeof(char *) - 1);
+}
+
+/**
+ * Size of the names and values of the property table of the node
+ * (its properties are read) and the number of its properties.
+ */
+static
+size_t props_size(const struct procfs *pfs, const struct procfs_node *node,
+		uint32_t phandle, size_t *nprops)
+{
+	size_t size = 0;
+	*nprops = 0;
+
+	for(size_t i = 0; (pfs->props || phandle != 0) && i < node->scan.count; ++i) {
+		const struct procfs_entry *e = &node->scan.entry[i];
+		if(!prop_in_table(pfs, node, i, phandle))
+			continue;
+
+		size    += strlen(scan_name(&node->scan, i)) + 1 + (size_t) e->size;
+		*nprops += 1;
+	}
+
+	return size;
+}
+
+/**
+ * Builds the device in a single arena block:
+ *
+ *   [struct dtree_dev_t][ranges][CPU addresses][name][compatible]
+ *   [compat pointers][property table][property names and values]
+ *
+ * The nreg ranges are taken from the ranges buffer and translated
+ * by the parent, compatible (clen bytes) is copied from compat.
+ * The property table is filled from the property buffer.
+ */
+static
+struct dtree_dev_t *dev_build(struct procfs *pfs, const struct procfs_node *parent,
+		const struct procfs_node *node, const char *node_name, uint32_t phandle,
+		size_t nreg, const char *compat, size_t clen)
+{
+	size_t nprops = 0;
+
+	const size_t regoff   = sizeof(struct dtree_dev_t);
+	const size_t cpuoff   = regoff + nreg * sizeof(struct dtree_reg_t);
+	const size_t nameoff  = cpuoff + nreg * sizeof(dtree_addr_t);
+	const size_t compoff  = nameoff + strlen(node_name) + 1;
+	const size_t entries  = compat_entries(compat, clen);
+	const size_t arrayoff = ptr_align(compoff + clen + 1);
+	const size_t propoff  = arrayoff + (entries + 1) * sizeof(char *);
+	const size_t datalen  = props_size(pfs, node, phandle, &nprops);
+	const size_t dataoff  = propoff + nprops * sizeof(struct dtree_prop_t);
+
+	char *block = dtree_arena_alloc(&pfs->arena, dataoff + datalen);
+	if(block == NULL) {
+		dtree_error_from_errno(pfs->err);
+		return NULL;
+	}
+
+	struct dtree_dev_t *dev = (struct dtree_dev_t *) block;
+	struct dtree_reg_t *reg = (struct dtree_reg_t *) (block + regoff);
+	dtree_addr_t *cpu = (dtree_addr_t *) (block + cpuoff);
+	const char **array = (const char **) (block + arrayoff);
+	struct dtree_prop_t *props = (struct dtree_prop_t *) (block + propoff);
+	char *data = block + dataoff;
+
+	// a provider has no ranges (nor the buffer of them)
+	if(nreg > 0)
+		memcpy(reg, pfs->regs, nreg * sizeof(struct dtree_reg_t));
+
+	for(size_t i = 0; i < nreg; ++i)
+		cpu[i] = dtree_xlat_addr(parent->xlat, reg[i].base);
+
+	memcpy(block + nameoff, node_name, compoff - nameoff);
+
+	if(clen > 0)
+		memcpy(block + compoff, compat, clen);
+	block[compoff + clen] = '\0';
+
+	for(size_t i = 0, off = 0; i < entries; ++i) {
+		array[i] = block + compoff + off;
+		off += strlen(array[i]) + 1;
+	}
+	array[entries] = NULL;
+
+	for(size_t i = 0, p = 0; p < nprops; ++i) {
+		const struct procfs_entry *e = &node->scan.entry[i];
+		if(!prop_in_table(pfs, node, i, phandle))
+			continue;
+
+		const char *name = scan_name(&node->scan, i);
+		const size_t nlen = strlen(name) + 1;
+
+		memcpy(data, name, nlen);
+		memcpy(data + nlen, prop_data(pfs, node, i), (size_t) e->size);
+
+		props[p].name  = data;
+		props[p].value = data + nlen;
+		props[p].len   = (size_t) e->size;
+		data += nlen + (size_t) e->size;
+		p += 1;
+	}
+
+	dev->name   = block + nameoff;
+	dev->base   = nreg > 0? reg[0].base : 0;
+	dev->high   = nreg > 0? reg[0].base + reg[0].size - 1 : 0;
+	dev->compat = array;
+	dev->reg    = reg;
+	dev->nreg   = nreg;
+	dev->cpu    = cpu;
+	dev->phandle = phandle;
+	dev->props  = nprops > 0? props : NULL;
+	dev->nprops = nprops;
+	return dev;
+}
+
+/**
+ * Builds the device of the node. The phandle (when the node has
+ * any) is read first, so look ups by phandle skip other nodes after
+ * a single read. reg and compatible are read by a single batch when
+ * io_uring is enabled, otherwise into the property buffer. reg is
+ * decoded by the cells of the parent. All other properties are read
+ * only for the property table of an accepted device.
+ *
+ * Returns NULL when the node is not a device, when the device is
+ * rejected by the match (m can be NULL) or on error (set).
+ */
+static
+struct dtree_dev_t *dev_from_node(struct procfs *pfs, struct procfs_node *node,
+		const struct procfs_node *parent, const char *node_name,
+		const struct procfs_match *m)
+{
+	uint32_t phandle = 0;
+	size_t nreg = 0;
+
+	if(m != NULL && m->phandle != 0 && node->scan.phandle < 0)
+		return NULL;
+
+	prop_begin(pfs, node);
+
+	if(node_read_phandle(pfs, node, &phandle))
+		return NULL;
+
+	if(m != NULL && m->phandle != 0 && phandle != m->phandle)
+		return NULL;
+
+	// a provider has no ranges to read
+	if(node->scan.reg < 0 && phandle == 0)
+		return NULL;
+
+	if(pfs->uring != NULL && node->scan.reg >= 0) {
+		struct dtree_uring_read rd[2];
+
+		int err = node_read_batch(pfs, node, parent, rd, &nreg);
+		if(err != 0 && err != 3)
+			return NULL; // not a device or error (set)
+
+		if(err == 0) {
+			const size_t clen = node->scan.compat >= 0? (size_t) rd[1].res : 0;
+
+			if(!match_range(m, pfs, parent, nreg) || !match_compat(m, pfs->batch_compat, clen))
+				return NULL;
+
+			if(pfs->props) {
+				if(prop_store(pfs, node, node->scan.reg, rd[0].buf, (size_t) rd[0].res))
+					return NULL;
+				if(clen > 0 && prop_store(pfs, node, node->scan.compat, rd[1].buf, clen))
+					return NULL;
+			}
+
+			if(node_read_props(pfs, node, phandle))
+				return NULL;
+
+			return dev_build(pfs, parent, node, node_name, phandle, nreg, pfs->batch_compat, clen);
+		}
+	}
+
+	if(node->scan.reg >= 0 && node_parse_reg(pfs, node, parent, &nreg))
+		return NULL; // not a device or error (set)
+
+	if(!match_range(m, pfs, parent, nreg))
+		return NULL;
+
+	size_t clen = 0;
+
+	if(node->scan.compat >= 0) {
+		const long len = prop_read(pfs, node, node->scan.compat);
+		if(len < 0)
+			return NULL;
+
+		clen = (size_t) len;
+	}
+
+	const char *compat = clen > 0? prop_data(pfs, node, node->scan.compat) : "";
+	if(!match_compat(m, compat, clen))
+		return NULL;
+
+	if(node_read_props(pfs, node, phandle))
+		return NULL;
+
+	// the buffer may have moved
+	if(clen > 0)
+		compat = prop_data(pfs, node, node->scan.compat);
+
+	return dev_build(pfs, parent, node, node_name, phandle, nreg, compat, clen);
+}
+
+/**
+ * Remembers the path of the node on the top of the cursor by
+ * its phandle. The phandle has been read by dev_from_node()
+ * already (when the node has any). Returns non-zero on error.
+ */
+static
+int phandle_record(struct procfs *pfs, struct procfs_iter *it)
+{
+	uint32_t phandle = 0;
+
+	if(node_read_phandle(pfs, iter_top(it), &phandle))
+		return 1;
+
+	if(phandle == 0)
+		return 0;
+
+	// behind the rootd
+	const char *path = it->path.path + it->path.level[1].name;
+
+	if(phandles_add(&pfs->phandles, phandle, path)) {
+		dtree_error_from_errno(pfs->err);
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Walks to the next device accepted by the match (NULL
+ * accepts all devices).
+ */
+static
+struct dtree_dev_t *procfs_find(struct procfs *pfs, struct procfs_iter *it,
+		const struct procfs_match *m)
+{
+	struct dtree_dev_t *dev = NULL;
+
+	while(dev == NULL && !it->end) {
+		struct procfs_node *curr = iter_top(it);
+		const char *name = path_stack_name(&it->path);
+
+		// the root is never a device
+		if(match_kind(m, pfs, curr) && path_stack_depth(&it->path) > 1 && match_name(m, name)) {
+			dev = dev_from_node(pfs, curr, curr->parent, name, m);
+
+			if(dev == NULL && dtree_error_isset(pfs->err))
+				return NULL;
+
+			if(phandle_record(pfs, it)) {
+				if(dev != NULL)
+					dtree_procfs_dev_free(pfs, dev);
+
+				return NULL;
+			}
+		}
+
+		struct procfs_node *node = go_next_node(pfs, it);
+		if(node == NULL && dtree_error_isset(pfs->err)) {
+			return NULL;
+		}
+		
+		if(node == NULL)
+			node = go_up_next_node(pfs, it);
+
+		if(node == NULL && dtree_error_isset(pfs->err)) {
+			return NULL;
+		}
+
+		it->end = node == NULL;
+	}
+
+	return dev;
+}
+
+/**
+ * Walks the whole tree by a temporary cursor and collects
+ * devices accepted by the match (see dtree_byname_all()).
+ */
+static
+size_t procfs_find_all(struct procfs *pfs, const struct procfs_match *m,
+		struct dtree_dev_t **devs, size_t max)
+{
+	struct dtree_dev_t *dev = NULL;
+	size_t count = 0;
+
+	struct procfs_iter *it = dtree_procfs_iter_new(pfs);
+	if(it == NULL) {
+		dtree_error_from_errno(pfs->err);
+		return 0;
+	}
+
+	while((dev = procfs_find(pfs, it, m)) != NULL) {
+		if(count < max)
+			devs[count] = dev;
+		else
+			dtree_procfs_dev_free(pfs, dev);
+
+		count += 1;
+	}
+
+	dtree_procfs_iter_free(pfs, it);
+	return count;
+}
+
+struct dtree_dev_t *dtree_procfs_next(void *state, void *iter)
+{
+	return procfs_find((struct procfs *) state, (struct procfs_iter *) iter, NULL);
+}
+
+struct dtree_dev_t *dtree_procfs_byname(void *state, void *iter, const char *name)
+{
+	const struct procfs_match m = {.name = name};
+	return procfs_find((struct procfs *) state, (struct procfs_iter *) iter, &m);
+}
+
+size_t dtree_procfs_byname_all(void *state, const char *name,
+		struct dtree_dev_t **devs, size_t max)
+{
+	const struct procfs_match m = {.name = name};
+	return procfs_find_all((struct procfs *) state, &m, devs, max);
+}
+
+struct dtree_dev_t *dtree_procfs_bycompat(void *state, void *iter, const char *compat)
+{
+	const struct procfs_match m = {.compat = compat};
+	return procfs_find((struct procfs *) state, (struct procfs_iter *) iter, &m);
+}
+
+size_t dtree_procfs_bycompat_all(void *state, const char *compat,
+		struct dtree_dev_t **devs, size_t max)
+{
+	const struct procfs_match m = {.compat = compat};
+	return procfs_find_all((struct procfs *) state, &m, devs, max);
+}
+
+struct dtree_dev_t *dtree_procfs_byaddr(void *state, void *iter, dtree_addr_t addr, int cpu)
+{
+	const struct procfs_match m = {.has_range = 1, .cpu = cpu, .lo = addr, .hi = addr};
+	return procfs_find((struct procfs *) state, (struct procfs_iter *) iter, &m);
+}
+
+size_t dtree_procfs_byrange(void *state, dtree_addr_t lo, dtree_addr_t hi, int cpu,
+		struct dtree_dev_t **devs, size_t max)
+{
+	const struct procfs_match m = {.has_range = 1, .cpu = cpu, .lo = lo, .hi = hi};
+	return procfs_find_all((struct procfs *) state, &m, devs, max);
+}
+
+/**
+ * Descends by the cursor along the path (relative to rootd) and
+ * builds the device there when accepted by the match. Returns NULL
+ * when the path is gone or rejected by the filter of the cursor,
+ * when the device is rejected by the match or on error (set).
+ */
+static
+struct dtree_dev_t *procfs_find_path(struct procfs *pfs, struct procfs_iter *it,
+		const char *path, const struct procfs_match *m)
+{
+	while(*path != '\0') {
+		const struct procfs_scan *scan = &iter_top(it)->scan;
+		const size_t len = strcspn(path, "/");
+		struct procfs_node *node = NULL;
+		size_t i = 0;
+
+		for(; i < scan->count; ++i) {
+			const char *name = scan_name(scan, i);
+
+			if(scan->entry[i].kind == PROCFS_NODE && !strncmp(name, path, len) && name[len] == '\0')
+				break;
+		}
+
+		if(i == scan->count || iter_child(pfs, it, i, &node))
+			return NULL;
+
+		if(path_stack_push(&it->path, scan_name(scan, i), node)) {
+			dtree_error_from_errno(pfs->err);
+			node_put(pfs, node);
+			return NULL;
+		}
+
+		path += path[len] == '/'? len + 1 : len;
+	}
+
+	struct procfs_node *node = iter_top(it);
+	if(!match_kind(m, pfs, node) || path_stack_depth(&it->path) < 2)
+		return NULL;
+
+	return dev_from_node(pfs, node, node->parent, path_stack_name(&it->path), m);
+}
+
+/**
+ * A phandle passed by a walk before is looked up along its path.
+ * Otherwise (or when the device has moved) the tree is walked
+ * and the paths of all phandles on the way are remembered.
+ */
+struct dtree_dev_t *dtree_procfs_byphandle(void *state, uint32_t phandle)
+{
+	struct procfs *pfs = (struct procfs *) state;
+	const struct procfs_match m = {.phandle = phandle};
+	const char *path = phandles_path(&pfs->phandles, phandle);
+	struct dtree_dev_t *dev = NULL;
+
+	if(path == NULL && pfs->phandles.all)
+		return NULL;
+
+	struct procfs_iter *it = dtree_procfs_iter_new(pfs);
+	if(it == NULL) {
+		dtree_error_from_errno(pfs->err);
+		return NULL;
+	}
+
+	if(path != NULL) {
+		dev = procfs_find_path(pfs, it, path, &m);
+		dtree_procfs_iter_free(pfs, it);
+
+		if(dev != NULL || dtree_error_isset(pfs->err))
+			return dev;
+
+		it = dtree_procfs_iter_new(pfs);
+		if(it == NULL) {
+			dtree_error_from_errno(pfs->err);
+			return NULL;
+		}
+	}
+
+	dev = procfs_find(pfs, it, &m);
+	if(dev == NULL && !dtree_error_isset(pfs->err))
+		pfs->phandles.all = 1;
+
+	dtree_procfs_iter_free(pfs, it);
+	return dev;
+}
+
+int dtree_procfs_filter(void *state, void *iter, const struct dtree_filter_t *filter)
+{
+	(void) state;
+
+	((struct procfs_iter *) iter)->filter = *filter;
+	return 0;
+}
+
+void dtree_procfs_dev_free(void *state, struct dtree_dev_t *dev)
+{
+	struct procfs *pfs = (struct procfs *) state;
+
+	assert(dev != NULL);
+	dtree_arena_release(&pfs->arena, dev);
+}
+
+//
+// Parallel loading
+//
+
+/**
+ * Node of a parallel load. Every node is loaded by its own task:
+ * the directory is scanned, the device is built and a task is
+ * spawned for every child node. The directory stays opened until
+ * all children have opened theirs relative to it (opening).
+ * The scan is kept until the end, names of children point there.
+ */
+struct load_node {
+	struct procfs_node node;
+	struct load_node  *parent;
+	size_t index; // entry of the node in the parent
+	size_t depth; // root is 1
+	unsigned long opening;
+
+	struct dtree_dev_t *dev;
+	struct load_node  **child; // by entry, NULL for properties
+};
+
+/**
+ * Every worker reads by its own procfs state (the error state
+ * and the arena for devices). All of them are freed together
+ * with the load.
+ */
+struct procfs_load {
+	const char *rootd;
+	struct load_node *root;
+
+	struct procfs *worker;
+	struct dtree_error *errs; // of workers
+	unsigned threads;
+	int failed;
+};
+
+static
+void load_node_free(struct load_node *ln)
+{
+	if(ln == NULL)
+		return;
+
+	for(size_t i = 0; ln->child != NULL && i < ln->node.scan.count; ++i)
+		load_node_free(ln->child[i]);
+
+	if(ln->node.dir != NULL)
+		closedir(ln->node.dir);
+
+	scan_free(&ln->node.scan);
+	dtree_xlat_free(ln->node.xlat);
+	free(ln->child);
+	free(ln);
+}
+
+/**
+ * The child has opened its directory, the parent does not
+ * need its own one anymore after the last child.
+ */
+static
+void load_node_opened(struct load_node *parent)
+{
+	if(parent == NULL)
+		return;
+
+	if(__atomic_sub_fetch(&parent->opening, 1, __ATOMIC_ACQ_REL) == 0) {
+		closedir(parent->node.dir);
+		parent->node.dir = NULL;
+	}
+}
+
+static
+void load_fail(struct procfs_load *ld)
+{
+	__atomic_store_n(&ld->failed, 1, __ATOMIC_RELEASE);
+}
+
+static
+int load_spawn_children(struct dtree_pool *pool, unsigned worker, struct load_node *ln);
+
+/**
+ * Whether the i-th entry of the node is not a child node
+ * to be loaded (by the kind, name or depth).
+ */
+static
+int load_child_skipped(const struct dtree_filter_t *filter, const struct load_node *ln, size_t i)
+{
+	const struct procfs_scan *scan = &ln->node.scan;
+
+	if(scan->entry[i].kind != PROCFS_NODE)
+		return 1;
+
+	// the depth of children as seen by the filter is the depth of the parent
+	return dtree_filter_skips(filter, scan_name(scan, i), ln->depth);
+}
+
+static
+void load_task(struct dtree_pool *pool, unsigned worker, void *arg)
+{
+	struct procfs_load *ld = (struct procfs_load *) dtree_pool_data(pool);
+	struct procfs *pfs = &ld->worker[worker];
+	struct load_node *ln = (struct load_node *) arg;
+	struct load_node *parent = ln->parent;
+
+	if(__atomic_load_n(&ld->failed, __ATOMIC_ACQUIRE)) {
+		load_node_opened(parent);
+		return;
+	}
+
+	const char *name = parent == NULL? ld->rootd : scan_name(&parent->node.scan, ln->index);
+	const int fd = parent == NULL? AT_FDCWD : dirfd(parent->node.dir);
+
+	ln->node.dir = opendir_at(pfs, fd, name);
+	load_node_opened(parent);
+
+	if(ln->node.dir == NULL || node_scan(pfs, ln->node.dir, &ln->node.scan)) {
+		load_fail(ld);
+		return;
+	}
+
+	// a disabled node is neither a device nor a parent of any
+	const int disabled = parent == NULL? 0 : node_disabled(pfs, &ln->node, &pfs->filter);
+	if(disabled != 0) {
+		closedir(ln->node.dir);
+		ln->node.dir = NULL;
+
+		if(disabled < 0)
+			load_fail(ld);
+		return;
+	}
+
+	if(node_read_bus(pfs, &ln->node, parent == NULL? NULL : &parent->node)) {
+		load_fail(ld);
+		return;
+	}
+
+	// the root is never a device
+	if(match_kind(NULL, pfs, &ln->node) && ln->depth > 1) {
+		ln->dev = dev_from_node(pfs, &ln->node, &parent->node, name, NULL);
+
+		if(ln->dev == NULL && dtree_error_isset(pfs->err)) {
+			load_fail(ld);
+			return;
+		}
+	}
+
+	if(load_spawn_children(pool, worker, ln))
+		load_fail(ld);
+}
+
+static
+int load_spawn_children(struct dtree_pool *pool, unsigned worker, struct load_node *ln)
+{
+	struct procfs_load *ld = (struct procfs_load *) dtree_pool_data(pool);
+	const struct dtree_filter_t *filter = &ld->worker[worker].filter;
+	const struct procfs_scan *scan = &ln->node.scan;
+	size_t nodes = 0;
+
+	for(size_t i = 0; i < scan->count; ++i) {
+		if(load_child_skipped(filter, ln, i))
+			continue;
+
+		nodes += 1;
+	}
+
+	if(nodes == 0) {
+		closedir(ln->node.dir);
+		ln->node.dir = NULL;
+		return 0;
+	}
+
+	ln->child = calloc(scan->count, sizeof(struct load_node *));
+	if(ln->child == NULL) {
+		dtree_error_from_errno(ld->worker[worker].err);
+		return 1;
+	}
+
+	for(size_t i = 0; i < scan->count; ++i) {
+		if(load_child_skipped(filter, ln, i))
+			continue;
+
+		struct load_node *child = calloc(1, sizeof(struct load_node));
+		if(child == NULL) {
+			dtree_error_from_errno(ld->worker[worker].err);
+			return 1; // no child spawned yet, dir is closed by free
+		}
+
+		child->parent = ln;
+		child->index  = i;
+		child->depth  = ln->depth + 1;
+		child->node.disabled = -1;
+		ln->child[i]  = child;
+	}
+
+	ln->opening = nodes;
+
+	// the worker takes its tasks from the back, the first child
+	// is pushed last to be loaded first
+	for(size_t i = scan->count; i > 0; --i) {
+		if(ln->child[i - 1] != NULL)
+			dtree_pool_spawn(pool, worker, load_task, ln->child[i - 1]);
+	}
+
+	return 0;
+}
+
+/**
+ * Releases the load. Devices are freed together with
+ * the arenas of workers.
+ */
+void dtree_procfs_load_free(struct procfs_load *ld)
+{
+	load_node_free(ld->root);
+
+	for(unsigned i = 0; ld->worker != NULL && i < ld->threads; ++i) {
+		dtree_arena_free(&ld->worker[i].arena);
+		free(ld->worker[i].prop);
+		free(ld->worker[i].regs);
+	}
+
+	free(ld->worker);
+	free(ld->errs);
+	free(ld);
+}
+
+struct procfs_load *dtree_procfs_load(const char *rootd, const struct dtree_opts *opts,
+		struct dtree_error *err)
+{
+	unsigned threads = opts->threads;
+
+	if(rootd == NULL) {
+		dtree_error_set(err, EINVAL);
+		return NULL;
+	}
+
+	if(threads == 0)
+		threads = 1;
+	if(threads > DTREE_POOL_MAX)
+		threads = DTREE_POOL_MAX;
+
+	struct procfs_load *ld = calloc(1, sizeof(struct procfs_load));
+	if(ld == NULL) {
+		dtree_error_from_errno(err);
+		return NULL;
+	}
+
+	ld->rootd   = rootd;
+	ld->threads = threads;
+	ld->worker  = calloc(threads, sizeof(struct procfs));
+	ld->errs    = calloc(threads, sizeof(struct dtree_error));
+	ld->root    = calloc(1, sizeof(struct load_node));
+
+	if(ld->worker == NULL || ld->errs == NULL || ld->root == NULL) {
+		dtree_error_from_errno(err);
+		dtree_procfs_load_free(ld);
+		return NULL;
+	}
+
+	for(unsigned i = 0; i < threads; ++i) {
+		ld->worker[i].err    = &ld->errs[i];
+		ld->worker[i].props  = opts->props;
+		ld->worker[i].providers = opts->providers;
+		ld->worker[i].filter = opts->filter;
+	}
+
+	ld->root->depth = 1;
+
+	if(dtree_pool_run(threads, ld, load_task, ld->root)) {
+		dtree_error_from_errno(err);
+		dtree_procfs_load_free(ld);
+		return NULL;
+	}
+
+	if(ld->failed) {
+		for(unsigned i = 0; i < threads; ++i) {
+			if(dtree_error_isset(&ld->errs[i])) {
+				*err = ld->errs[i];
+				break;
+			}
+		}
+
+		dtree_procfs_load_free(ld);
+		return NULL;
+	}
+
+	return ld;
+}
+
+static
+int load_node_each(const struct load_node *ln,
+		int (*fn)(void *arg, struct dtree_dev_t *dev), void *arg)
+{
+	if(ln->dev != NULL && fn(arg, ln->dev))
+		return 1;
+
+	for(size_t i = 0; ln->child != NULL && i < ln->node.scan.count; ++i) {
+		if(ln->child[i] != NULL && load_node_each(ln->child[i], fn, arg))
+			return 1;
+	}
+
+	return 0;
+}
+
+int dtree_procfs_load_each(const struct procfs_load *ld,
+		int (*fn)(void *arg, struct dtree_dev_t *dev), void *arg)
+{
+	return load_node_each(ld->root, fn, arg);
+}
+
+const struct dtree_backend dtree_procfs_backend = {
+	.name       = "procfs",
+	.open       = dtree_procfs_open,
+	.close      = dtree_procfs_close,
+	.iter_new   = dtree_procfs_iter_new,
+	.iter_clone = dtree_procfs_iter_clone,
+	.iter_free  = dtree_procfs_iter_free,
+	.next       = dtree_procfs_next,
+	.reset      = dtree_procfs_reset,
+	.dev_free   = dtree_procfs_dev_free,
+
+	.byname       = dtree_procfs_byname,
+	.byname_all   = dtree_procfs_byname_all,
+	.bycompat     = dtree_procfs_bycompat,
+	.bycompat_all = dtree_procfs_bycompat_all,
+	.byaddr       = dtree_procfs_byaddr,
+	.byrange      = dtree_procfs_byrange,
+	.byphandle    = dtree_procfs_byphandle,
+	.filter       = dtree_procfs_filter,
+};
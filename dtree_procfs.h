@@ -7,34 +7,117 @@
 #ifndef DTREE_PROC_FS
 #define DTREE_PROC_FS
 
+#include "dtree.h"
+
+#include <stddef.h>
+
+struct dtree_ctx;
+struct dtree_opts;
+struct dtree_error;
+
 /**
  * Opens the /proc filesystem at the given path.
  * Most common: /proc/device-tree.
  * 
  * Initializes internal structures. Does not
- * clear error flag.
+ * clear error flag. Returns the state of the
+ * opened tree or NULL on error (set in err).
  */
-int dtree_procfs_open(const char *rootd);
+void *dtree_procfs_open(const char *rootd, const struct dtree_opts *opts, struct dtree_error *err);
 
 /**
  * Free's all resources.
  */
-void dtree_procfs_close(void);
+void dtree_procfs_close(void *state);
+
+/**
+ * Cursors over procfs. Cursors standing in the same
+ * directories share them.
+ */
+void *dtree_procfs_iter_new(void *state);
+void *dtree_procfs_iter_clone(void *state, const void *iter);
+void dtree_procfs_iter_free(void *state, void *iter);
 
 /**
  * Traversing over procfs.
  */
-struct dtree_dev_t *dtree_procfs_next(void);
+struct dtree_dev_t *dtree_procfs_next(void *state, void *iter);
+
+/**
+ * Lookups walking the tree as dtree_procfs_next() does. A node is
+ * tested by its name before any of its properties is read and by
+ * its address before compatible is read, so devices are built only
+ * when they match.
+ */
+struct dtree_dev_t *dtree_procfs_byname(void *state, void *iter, const char *name);
+size_t dtree_procfs_byname_all(void *state, const char *name,
+		struct dtree_dev_t **devs, size_t max);
+struct dtree_dev_t *dtree_procfs_bycompat(void *state, void *iter, const char *compat);
+size_t dtree_procfs_bycompat_all(void *state, const char *compat,
+		struct dtree_dev_t **devs, size_t max);
+struct dtree_dev_t *dtree_procfs_byaddr(void *state, void *iter, dtree_addr_t addr, int cpu);
+size_t dtree_procfs_byrange(void *state, dtree_addr_t lo, dtree_addr_t hi, int cpu,
+		struct dtree_dev_t **devs, size_t max);
+
+/**
+ * Walks the tree by a temporary cursor reading only the phandles
+ * (of nodes having any) until the device is found.
+ */
+struct dtree_dev_t *dtree_procfs_byphandle(void *state, uint32_t phandle);
+
+/**
+ * Sets the filter of the cursor, it applies to the nodes
+ * the cursor descends into from now on.
+ */
+int dtree_procfs_filter(void *state, void *iter, const struct dtree_filter_t *filter);
 
 /**
  * Free of dtree_dev_t returned by procfs functions.
  */
-void dtree_procfs_dev_free(struct dtree_dev_t *dev);
+void dtree_procfs_dev_free(void *state, struct dtree_dev_t *dev);
 
 /**
  * Reset of iteration over procfs.
  */
-int dtree_procfs_reset(void);
+int dtree_procfs_reset(void *state, void *iter);
 
-#endif
+/**
+ * Number of directory entries read (readdir calls)
+ * since the context has been opened (by procfs).
+ * For testing purposes.
+ */
+unsigned long dtree_procfs_readdir_count(const struct dtree_ctx *ctx);
+
+/**
+ * Number of properties read since the context has
+ * been opened (by procfs). For testing purposes.
+ */
+unsigned long dtree_procfs_prop_count(const struct dtree_ctx *ctx);
+
+struct procfs_load;
+struct dtree_dev_t;
+
+/**
+ * Loads all devices of the tree at rootd by the number of threads
+ * given by opts. Subtrees are loaded in parallel by a work-stealing
+ * pool, one task per node (scan and property reads).
+ *
+ * Returns the load or NULL on error (set in err).
+ */
+struct procfs_load *dtree_procfs_load(const char *rootd, const struct dtree_opts *opts,
+		struct dtree_error *err);
+
+/**
+ * Calls fn for every device of the load in the order
+ * of dtree_procfs_next(). Stops when fn returns non-zero
+ * and returns that.
+ */
+int dtree_procfs_load_each(const struct procfs_load *ld,
+		int (*fn)(void *arg, struct dtree_dev_t *dev), void *arg);
 
+/**
+ * Frees the load including all its devices.
+ */
+void dtree_procfs_load_free(struct procfs_load *ld);
+
+#endif
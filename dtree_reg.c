@@ -0,0 +1,354 @@
+/**
+ * dtree_reg.c
+ */
+
+#include "dtree_reg.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define be32(x) (x)
+#define be64(x) (x)
+#else
+#define be32(x) __builtin_bswap32(x)
+#define be64(x) __builtin_bswap64(x)
+#define DTREE_REG_SWAP
+#endif
+
+/**
+ * ranges are decoded as an array of 2 * count values when
+ * the address and size have the same number of cells.
+ */
+typedef char dtree_reg_is_two_values[sizeof(struct dtree_reg_t) == 2 * sizeof(uint64_t)? 1 : -1];
+
+static inline
+uint32_t cell32(const unsigned char *s)
+{
+	uint32_t v;
+	memcpy(&v, s, sizeof(v));
+	return be32(v);
+}
+
+static inline
+uint64_t cell64(const unsigned char *s)
+{
+	uint64_t v;
+	memcpy(&v, s, sizeof(v));
+	return be64(v);
+}
+
+#if defined(__SSE2__) && defined(DTREE_REG_SWAP)
+
+/**
+ * Swaps bytes of every 16-bit lane.
+ */
+static inline
+__m128i swap16(__m128i v)
+{
+	return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+/**
+ * Swaps bytes of every 32-bit lane (SSE2 has no byte shuffle,
+ * the 16-bit halves are swapped first).
+ */
+static inline
+__m128i swap32(__m128i v)
+{
+	v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+	v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+	return swap16(v);
+}
+
+static inline
+__m128i swap64(__m128i v)
+{
+	v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+	v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+	return swap16(v);
+}
+
+/**
+ * Vector parts of the conversions. Each of them converts
+ * as many values as fit whole vectors and returns their count.
+ */
+static
+size_t read32_vec(const unsigned char *s, size_t n, uint32_t *dst)
+{
+	size_t i = 0;
+
+	for(; i + 4 <= n; i += 4) {
+		const __m128i v = _mm_loadu_si128((const __m128i *) (s + 4 * i));
+		_mm_storeu_si128((__m128i *) (dst + i), swap32(v));
+	}
+
+	return i;
+}
+
+static
+size_t read1_vec(const unsigned char *s, size_t n, uint64_t *dst)
+{
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+
+	for(; i + 4 <= n; i += 4) {
+		const __m128i v = swap32(_mm_loadu_si128((const __m128i *) (s + 4 * i)));
+		_mm_storeu_si128((__m128i *) (dst + i), _mm_unpacklo_epi32(v, zero));
+		_mm_storeu_si128((__m128i *) (dst + i + 2), _mm_unpackhi_epi32(v, zero));
+	}
+
+	return i;
+}
+
+static
+size_t read2_vec(const unsigned char *s, size_t n, uint64_t *dst)
+{
+	size_t i = 0;
+
+	for(; i + 2 <= n; i += 2) {
+		const __m128i v = _mm_loadu_si128((const __m128i *) (s + 8 * i));
+		_mm_storeu_si128((__m128i *) (dst + i), swap64(v));
+	}
+
+	return i;
+}
+
+#else
+
+static inline
+size_t read32_vec(const unsigned char *s, size_t n, uint32_t *dst)
+{
+	(void) s;
+	(void) n;
+	(void) dst;
+	return 0;
+}
+
+static inline
+size_t read1_vec(const unsigned char *s, size_t n, uint64_t *dst)
+{
+	(void) s;
+	(void) n;
+	(void) dst;
+	return 0;
+}
+
+static inline
+size_t read2_vec(const unsigned char *s, size_t n, uint64_t *dst)
+{
+	(void) s;
+	(void) n;
+	(void) dst;
+	return 0;
+}
+
+#endif
+
+void dtree_cells_read32(const void *src, size_t n, uint32_t *dst)
+{
+	const unsigned char *s = (const unsigned char *) src;
+
+	for(size_t i = read32_vec(s, n, dst); i < n; ++i)
+		dst[i] = cell32(s + 4 * i);
+}
+
+void dtree_cells_read(const void *src, size_t n, unsigned cells, uint64_t *dst)
+{
+	const unsigned char *s = (const unsigned char *) src;
+
+	switch(cells) {
+	case 1:
+		for(size_t i = read1_vec(s, n, dst); i < n; ++i)
+			dst[i] = cell32(s + 4 * i);
+		break;
+
+	case 2:
+		for(size_t i = read2_vec(s, n, dst); i < n; ++i)
+			dst[i] = cell64(s + 8 * i);
+		break;
+
+	case 0:
+		memset(dst, 0, n * sizeof(uint64_t));
+		break;
+
+	default:
+		// only the last two cells fit
+		s += 4 * (cells - 2);
+
+		for(size_t i = 0; i < n; ++i)
+			dst[i] = cell64(s + 4 * (size_t) cells * i);
+		break;
+	}
+}
+
+unsigned dtree_cells_decode(const void *prop, size_t len, unsigned def)
+{
+	if(len != 4)
+		return def;
+
+	const uint32_t cells = cell32((const unsigned char *) prop);
+	return cells <= DTREE_CELLS_MAX? cells : def;
+}
+
+size_t dtree_reg_count(size_t len, unsigned acells, unsigned scells)
+{
+	const size_t pair = 4 * (size_t) (acells + scells);
+
+	if(acells == 0 || len == 0 || len % pair != 0)
+		return 0;
+
+	return len / pair;
+}
+
+void dtree_reg_decode(const void *reg, size_t count,
+		unsigned acells, unsigned scells, struct dtree_reg_t *ranges)
+{
+	const unsigned char *s = (const unsigned char *) reg;
+
+	if(acells == scells) {
+		dtree_cells_read(s, 2 * count, acells, (uint64_t *) ranges);
+		return;
+	}
+
+	for(size_t i = 0; i < count; ++i) {
+		dtree_cells_read(s, 1, acells, &ranges[i].base);
+		s += 4 * acells;
+		dtree_cells_read(s, 1, scells, &ranges[i].size);
+		s += 4 * scells;
+	}
+}
+
+dtree_addr_t dtree_reg_high(dtree_addr_t base, dtree_addr_t size)
+{
+	const dtree_addr_t high = base + size - 1;
+	return high < base? base : high;
+}
+
+int dtree_reg_intersects(const struct dtree_dev_t *dev, dtree_addr_t lo, dtree_addr_t hi, int cpu)
+{
+	for(size_t i = 0; i < dev->nreg; ++i) {
+		const dtree_addr_t base = cpu? dev->cpu[i] : dev->reg[i].base;
+
+		if(cpu && base == DTREE_ADDR_NONE)
+			continue;
+
+		if(base <= hi && dtree_reg_high(base, dev->reg[i].size) >= lo)
+			return 1;
+	}
+
+	return 0;
+}
+
+const struct dtree_xlat dtree_xlat_identity = {1, 0};
+const struct dtree_xlat dtree_xlat_none     = {0, 0};
+
+/**
+ * Adds the part of the window (child, parent address, size) mapped
+ * by the parent translation. A window may span several windows
+ * of the parent, each of them gives a range.
+ */
+static
+void xlat_compose(struct dtree_xlat *x, const struct dtree_xlat *parent,
+		dtree_addr_t child, dtree_addr_t paddr, dtree_addr_t size)
+{
+	if(parent->identity) {
+		struct dtree_xlat_range *r = &x->range[x->count++];
+		r->child = child;
+		r->cpu   = paddr;
+		r->size  = size;
+		return;
+	}
+
+	for(size_t i = 0; i < parent->count; ++i) {
+		const struct dtree_xlat_range *p = &parent->range[i];
+
+		const dtree_addr_t lo = paddr > p->child? paddr : p->child;
+		const dtree_addr_t end  = paddr + size;
+		const dtree_addr_t pend = p->child + p->size;
+		const dtree_addr_t hi = end < pend? end : pend;
+
+		if(lo >= hi)
+			continue;
+
+		struct dtree_xlat_range *r = &x->range[x->count++];
+		r->child = child + (lo - paddr);
+		r->cpu   = p->cpu + (lo - p->child);
+		r->size  = hi - lo;
+	}
+}
+
+const struct dtree_xlat *dtree_xlat_new(const struct dtree_xlat *parent,
+		const void *ranges, size_t len, unsigned acells, unsigned pacells, unsigned scells)
+{
+	const size_t entry = 4 * (size_t) (acells + pacells + scells);
+
+	if(ranges == NULL || (parent->count == 0 && !parent->identity))
+		return &dtree_xlat_none;
+
+	if(len == 0 && parent->identity)
+		return &dtree_xlat_identity;
+
+	if(len > 0 && (acells == 0 || pacells == 0 || len % entry != 0))
+		return &dtree_xlat_none;
+
+	// an empty ranges takes over the windows of the parent
+	const size_t count = len > 0? len / entry : 0;
+	const size_t max   = len > 0? count * (parent->identity? 1 : parent->count) : parent->count;
+
+	struct dtree_xlat *x = malloc(sizeof(struct dtree_xlat) + max * sizeof(struct dtree_xlat_range));
+	if(x == NULL)
+		return NULL;
+
+	x->identity = 0;
+	x->count    = 0;
+
+	if(len == 0) {
+		memcpy(x->range, parent->range, parent->count * sizeof(struct dtree_xlat_range));
+		x->count = parent->count;
+		return x;
+	}
+
+	const unsigned char *s = (const unsigned char *) ranges;
+
+	for(size_t i = 0; i < count; ++i, s += entry) {
+		dtree_addr_t child;
+		dtree_addr_t paddr;
+		dtree_addr_t size;
+
+		dtree_cells_read(s, 1, acells, &child);
+		dtree_cells_read(s + 4 * acells, 1, pacells, &paddr);
+		dtree_cells_read(s + 4 * (acells + pacells), 1, scells, &size);
+
+		if(size > 0)
+			xlat_compose(x, parent, child, paddr, size);
+	}
+
+	return x;
+}
+
+dtree_addr_t dtree_xlat_addr(const struct dtree_xlat *x, dtree_addr_t addr)
+{
+	if(x->identity)
+		return addr;
+
+	for(size_t i = 0; i < x->count; ++i) {
+		const struct dtree_xlat_range *r = &x->range[i];
+
+		if(addr >= r->child && addr - r->child < r->size)
+			return r->cpu + (addr - r->child);
+	}
+
+	return DTREE_ADDR_NONE;
+}
+
+void dtree_xlat_free(const struct dtree_xlat *x)
+{
+	if(x != NULL && x != &dtree_xlat_identity && x != &dtree_xlat_none)
+		free((void *) x);
+}
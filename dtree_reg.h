@@ -0,0 +1,125 @@
+/**
+ * Internal decoder of the reg property.
+ * Non-public API.
+ */
+
+#ifndef DTREE_REG
+#define DTREE_REG
+
+#include "dtree.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Cells used when a node does not have #address-cells
+ * or #size-cells (one cell each, the layout understood
+ * by the older versions of the library).
+ */
+#define DTREE_ADDR_CELLS 1
+#define DTREE_SIZE_CELLS 1
+
+/**
+ * Upper limit of #address-cells and #size-cells.
+ */
+#define DTREE_CELLS_MAX 4
+
+/**
+ * Decodes the #address-cells or #size-cells property (len bytes).
+ * Returns def when it is not a single cell or exceeds DTREE_CELLS_MAX.
+ */
+unsigned dtree_cells_decode(const void *prop, size_t len, unsigned def);
+
+/**
+ * Converts n big-endian cells at src (no alignment required)
+ * into host order.
+ */
+void dtree_cells_read32(const void *src, size_t n, uint32_t *dst);
+
+/**
+ * Converts n big-endian values of the given number of cells each
+ * into host order. Values wider than 64 bits keep their least
+ * significant 64 bits. Values of one and two cells (most of them)
+ * are converted several at a time.
+ */
+void dtree_cells_read(const void *src, size_t n, unsigned cells, uint64_t *dst);
+
+/**
+ * Number of (address, size) pairs of a reg of len bytes laid out
+ * by the cells of the parent. Returns 0 when reg does not describe
+ * a device: it is empty, its length is not a multiple of the pair
+ * or the parent has no address cells.
+ */
+size_t dtree_reg_count(size_t len, unsigned acells, unsigned scells);
+
+/**
+ * Decodes count pairs of reg into ranges. Values wider than
+ * 64 bits keep their least significant 64 bits (eg. PCI).
+ */
+void dtree_reg_decode(const void *reg, size_t count,
+		unsigned acells, unsigned scells, struct dtree_reg_t *ranges);
+
+/**
+ * The last address of the range at base of size. An empty range
+ * (or one wrapping around) occupies only its base.
+ */
+dtree_addr_t dtree_reg_high(dtree_addr_t base, dtree_addr_t size);
+
+/**
+ * Tests whether any range of the device intersects lo..hi in the
+ * address space of its bus or (cpu non-zero) in the CPU address
+ * space. Ranges not mapped to the CPU never intersect there.
+ */
+int dtree_reg_intersects(const struct dtree_dev_t *dev, dtree_addr_t lo, dtree_addr_t hi, int cpu);
+
+/**
+ * Window of a bus: size bytes at child in the address space
+ * of its children appear at cpu in the CPU address space.
+ */
+struct dtree_xlat_range {
+	dtree_addr_t child;
+	dtree_addr_t cpu;
+	dtree_addr_t size;
+};
+
+/**
+ * Translation of the addresses of the children of a bus into
+ * CPU addresses. It is the ranges property of the bus composed
+ * with the translations of all its ancestors, so an address is
+ * translated by a single look up regardless of the depth.
+ *
+ * Children of an identity translation (the root and buses with
+ * an empty ranges under it) use CPU addresses. A translation
+ * without any range (a missing ranges) maps nothing.
+ */
+struct dtree_xlat {
+	int    identity;
+	size_t count;
+	struct dtree_xlat_range range[];
+};
+
+extern const struct dtree_xlat dtree_xlat_identity;
+extern const struct dtree_xlat dtree_xlat_none;
+
+/**
+ * Creates the translation of a bus from its ranges (len bytes,
+ * NULL when the bus has none) and the translation of its parent.
+ * The ranges are laid out by #address-cells and #size-cells of
+ * the bus (acells, scells) and #address-cells of the parent
+ * (pacells). Malformed ranges map nothing.
+ *
+ * Returns the translation (free by dtree_xlat_free()) or NULL
+ * when out of memory.
+ */
+const struct dtree_xlat *dtree_xlat_new(const struct dtree_xlat *parent,
+		const void *ranges, size_t len, unsigned acells, unsigned pacells, unsigned scells);
+
+/**
+ * Translates the address of a child of the bus. Returns
+ * DTREE_ADDR_NONE when no range of the bus maps it.
+ */
+dtree_addr_t dtree_xlat_addr(const struct dtree_xlat *x, dtree_addr_t addr);
+
+void dtree_xlat_free(const struct dtree_xlat *x);
+
+#endif
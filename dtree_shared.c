@@ -0,0 +1,273 @@
+/**
+ * dtree_shared.c
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "dtree.h"
+#include "dtree_error.h"
+#include "dtree_ctx.h"
+#include "dtree_shared.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The current version is published by an atomic pointer.
+ *
+ * A reader pins the current version by taking a reference.
+ * Loading the pointer and taking the reference is not atomic
+ * so the reader announces itself in active[] for that short
+ * moment. A writer swaps the pointer, flips the epoch and waits
+ * until all readers announced in the old epoch are gone, then
+ * it drops the reference of the old version. Readers never wait,
+ * they only retry when the epoch flips under their hands.
+ *
+ * Writers (open, reload, free) are serialized by the writer mutex,
+ * a writer waiting for a reload in progress sleeps.
+ */
+struct dtree_shared {
+	struct dtree_version *current;
+	unsigned long epoch;
+	unsigned long active[2];
+
+	pthread_mutex_t writer;
+	char *rootd;
+	struct dtree_opts  opts;
+	struct dtree_error err;
+};
+
+void dtree_version_get(struct dtree_version *v)
+{
+	__atomic_add_fetch(&v->refs, 1, __ATOMIC_RELAXED);
+}
+
+void dtree_version_put(struct dtree_version *v)
+{
+	if(__atomic_sub_fetch(&v->refs, 1, __ATOMIC_ACQ_REL) != 0)
+		return;
+
+	dtree_ctx_close(&v->ctx);
+	free(v);
+}
+
+/**
+ * Takes a reference of the current version.
+ * Returns NULL when nothing is published.
+ */
+static
+struct dtree_version *version_acquire(dtree_shared_t *sh)
+{
+	unsigned long epoch = __atomic_load_n(&sh->epoch, __ATOMIC_SEQ_CST);
+
+	for(;;) {
+		unsigned long *active = &sh->active[epoch & 1];
+		__atomic_add_fetch(active, 1, __ATOMIC_SEQ_CST);
+
+		const unsigned long now = __atomic_load_n(&sh->epoch, __ATOMIC_SEQ_CST);
+		if(now == epoch)
+			break;
+
+		// a writer may not wait for us, announce again
+		__atomic_sub_fetch(active, 1, __ATOMIC_SEQ_CST);
+		epoch = now;
+	}
+
+	struct dtree_version *v = __atomic_load_n(&sh->current, __ATOMIC_SEQ_CST);
+	if(v != NULL)
+		dtree_version_get(v);
+
+	__atomic_sub_fetch(&sh->active[epoch & 1], 1, __ATOMIC_SEQ_CST);
+	return v;
+}
+
+/**
+ * Publishes v (may be NULL) and drops the previous version
+ * when no reader can be about to take its reference.
+ */
+static
+void version_publish(dtree_shared_t *sh, struct dtree_version *v)
+{
+	struct dtree_version *old = __atomic_exchange_n(&sh->current, v, __ATOMIC_SEQ_CST);
+	const unsigned long epoch = __atomic_fetch_add(&sh->epoch, 1, __ATOMIC_SEQ_CST);
+
+	while(__atomic_load_n(&sh->active[epoch & 1], __ATOMIC_SEQ_CST) != 0)
+		sched_yield();
+
+	if(old != NULL)
+		dtree_version_put(old);
+}
+
+static
+void writer_lock(dtree_shared_t *sh)
+{
+	pthread_mutex_lock(&sh->writer);
+}
+
+static
+void writer_unlock(dtree_shared_t *sh)
+{
+	pthread_mutex_unlock(&sh->writer);
+}
+
+/**
+ * Builds a new version off to the side. On error the
+ * error state of sh is set.
+ */
+static
+struct dtree_version *version_load(dtree_shared_t *sh)
+{
+	struct dtree_version *v = calloc(1, sizeof(struct dtree_version));
+	if(v == NULL) {
+		dtree_error_from_errno(&sh->err);
+		return NULL;
+	}
+
+	v->ctx.opts = sh->opts;
+
+	if(dtree_ctx_open_snapshot(&v->ctx, sh->rootd)) {
+		sh->err = v->ctx.err;
+		free(v);
+		return NULL;
+	}
+
+	v->refs = 1; // owned by sh until replaced
+	return v;
+}
+
+dtree_shared_t *dtree_shared_new(void)
+{
+	dtree_shared_t *sh = calloc(1, sizeof(struct dtree_shared));
+	if(sh == NULL)
+		return NULL;
+
+	const int err = pthread_mutex_init(&sh->writer, NULL);
+	if(err != 0) {
+		free(sh);
+		errno = err;
+		return NULL;
+	}
+
+	return sh;
+}
+
+void dtree_shared_free(dtree_shared_t *sh)
+{
+	if(sh == NULL)
+		return;
+
+	writer_lock(sh);
+	version_publish(sh, NULL);
+	writer_unlock(sh);
+
+	pthread_mutex_destroy(&sh->writer);
+	free(sh->rootd);
+	free(sh);
+}
+
+int dtree_shared_open(dtree_shared_t *sh, const char *rootd)
+{
+	writer_lock(sh);
+
+	if(sh->rootd != NULL) {
+		dtree_error_set(&sh->err, EBUSY); // use reload
+		writer_unlock(sh);
+		return -1;
+	}
+
+	if(rootd == NULL) {
+		dtree_error_set(&sh->err, EINVAL);
+		writer_unlock(sh);
+		return -1;
+	}
+
+	sh->rootd = strdup(rootd);
+	if(sh->rootd == NULL) {
+		dtree_error_from_errno(&sh->err);
+		writer_unlock(sh);
+		return -1;
+	}
+
+	struct dtree_version *v = version_load(sh);
+	if(v == NULL) {
+		free(sh->rootd);
+		sh->rootd = NULL;
+		writer_unlock(sh);
+		return -1;
+	}
+
+	dtree_error_clear(&sh->err);
+	version_publish(sh, v);
+	writer_unlock(sh);
+	return 0;
+}
+
+int dtree_shared_reload(dtree_shared_t *sh)
+{
+	writer_lock(sh);
+
+	if(sh->rootd == NULL) {
+		dtree_error_set(&sh->err, EINVAL); // call open first
+		writer_unlock(sh);
+		return -1;
+	}
+
+	struct dtree_version *v = version_load(sh);
+	if(v == NULL) {
+		writer_unlock(sh);
+		return -1;
+	}
+
+	dtree_error_clear(&sh->err);
+	version_publish(sh, v);
+	writer_unlock(sh);
+	return 0;
+}
+
+void dtree_shared_set_threads(dtree_shared_t *sh, unsigned threads)
+{
+	writer_lock(sh);
+	sh->opts.threads = threads;
+	writer_unlock(sh);
+}
+
+dtree_iter_t *dtree_shared_iter(dtree_shared_t *sh)
+{
+	struct dtree_version *v = version_acquire(sh);
+	if(v == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	dtree_iter_t *it = dtree_ctx_iter_new(&v->ctx, v);
+	if(it == NULL)
+		dtree_version_put(v);
+
+	return it;
+}
+
+void dtree_shared_stats(dtree_shared_t *sh, struct dtree_stats_t *stats)
+{
+	struct dtree_version *v = version_acquire(sh);
+
+	if(v == NULL) {
+		memset(stats, 0, sizeof(struct dtree_stats_t));
+		return;
+	}
+
+	dtree_ctx_stats(&v->ctx, stats);
+	dtree_version_put(v);
+}
+
+int dtree_shared_iserror(const dtree_shared_t *sh)
+{
+	return dtree_error_isset(&sh->err);
+}
+
+const char *dtree_shared_errstr(const dtree_shared_t *sh)
+{
+	return dtree_error_str(&sh->err);
+}
@@ -0,0 +1,25 @@
+/**
+ * Internal shared snapshot implementation.
+ * Non-public API.
+ */
+
+#ifndef DTREE_SHARED
+#define DTREE_SHARED
+
+#include "dtree.h"
+#include "dtree_ctx.h"
+
+/**
+ * A version is a snapshot opened in its own context. It is
+ * immutable once published and freed when the last reference
+ * (the shared object or an iterator) is dropped.
+ */
+struct dtree_version {
+	struct dtree_ctx ctx;
+	unsigned long    refs;
+};
+
+void dtree_version_get(struct dtree_version *v);
+void dtree_version_put(struct dtree_version *v);
+
+#endif
@@ -0,0 +1,665 @@
+/**
+ * dtree_snapshot.c
+ */
+
+#include "dtree.h"
+#include "dtree_error.h"
+#include "dtree_snapshot.h"
+#include "dtree_procfs.h"
+#include "dtree_backend.h"
+#include "dtree_index.h"
+#include "dtree_interval.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+/**
+ * The whole tree is held in a single memory block:
+ *
+ *   [struct dtree_dev_t x (count + nprov)][ranges][CPU addresses][compat pointers]
+ *   [property tables][strings]
+ *
+ * Ranges (reg) of all devices and their CPU addresses are stored
+ * back to back. Compat arrays of all devices are stored back to back,
+ * each of them terminated by NULL, so are the property tables.
+ * Strings (names, compatible entries, names and values of properties)
+ * are packed behind them. The providers (nodes without reg having
+ * a phandle) follow the devices, they are reached only by phandle.
+ *
+ * The names index maps both the full names and the names
+ * without unit address (before '@') to the devices. The compat
+ * index maps every compatible string to the devices listing it.
+ * The phandles index maps the phandles (their bytes in the dev
+ * itself) to the devices and the providers. The ranges indexes serve look ups by address
+ * (of buses and of the CPU).
+ */
+struct snapshot {
+	void   *mem;
+	size_t  memlen;
+	struct dtree_dev_t *dev;
+	size_t  count;
+	size_t  nprov;
+
+	struct dtree_index names;
+	struct dtree_index compat;
+	struct dtree_index phandles;
+	struct dtree_interval_index ranges;     // in buses
+	struct dtree_interval_index cpu_ranges; // in the CPU address space
+
+	struct dtree_error *err; // of the open only
+};
+
+/**
+ * Cursor over the snapshot (number of the next device).
+ */
+struct snapshot_iter {
+	size_t pos;
+};
+
+/**
+ * Temporary list of devices read from the source backend.
+ */
+struct devlist {
+	struct dtree_dev_t **dev;
+	size_t count;
+	size_t cap;
+};
+
+/**
+ * Backend (and its state) the snapshot is loaded from.
+ */
+struct source {
+	const struct dtree_backend *backend;
+	void *state;
+};
+
+static
+int devlist_push(struct devlist *l, struct dtree_dev_t *dev)
+{
+	if(l->count == l->cap) {
+		size_t cap = l->cap == 0? 64 : l->cap * 2;
+
+		struct dtree_dev_t **d = realloc(l->dev, cap * sizeof(struct dtree_dev_t *));
+		if(d == NULL)
+			return 1;
+
+		l->dev = d;
+		l->cap = cap;
+	}
+
+	l->dev[l->count++] = dev;
+	return 0;
+}
+
+static
+void devlist_free(struct devlist *l, const struct source *src)
+{
+	for(size_t i = 0; i < l->count; ++i)
+		src->backend->dev_free(src->state, l->dev[i]);
+
+	free(l->dev);
+	memset(l, 0, sizeof(struct devlist));
+}
+
+static
+char *pack_string(char **strings, const char *s)
+{
+	const size_t len = strlen(s) + 1;
+	char *p = *strings;
+
+	memcpy(p, s, len);
+	*strings += len;
+	return p;
+}
+
+/**
+ * Copies all devices into a single memory block.
+ */
+static
+int snapshot_pack(struct snapshot *snap, const struct devlist *l)
+{
+	size_t nreg    = 0;
+	size_t ncompat = 0;
+	size_t nprops  = 0;
+	size_t strlens = 0;
+
+	for(size_t i = 0; i < l->count; ++i) {
+		const struct dtree_dev_t *dev = l->dev[i];
+		strlens += strlen(dev->name) + 1;
+		nreg    += dev->nreg;
+		nprops  += dev->nprops;
+
+		for(size_t p = 0; p < dev->nprops; ++p)
+			strlens += strlen(dev->props[p].name) + 1 + dev->props[p].len;
+
+		for(size_t c = 0; dev->compat[c] != NULL; ++c) {
+			strlens += strlen(dev->compat[c]) + 1;
+			ncompat += 1;
+		}
+
+		ncompat += 1; // terminating NULL
+	}
+
+	const size_t devlen    = l->count * sizeof(struct dtree_dev_t);
+	const size_t reglen    = nreg * sizeof(struct dtree_reg_t);
+	const size_t cpulen    = nreg * sizeof(dtree_addr_t);
+	const size_t compatlen = ncompat * sizeof(const char *);
+	const size_t propslen  = nprops * sizeof(struct dtree_prop_t);
+
+	snap->memlen = devlen + reglen + cpulen + compatlen + propslen + strlens;
+	snap->mem    = malloc(snap->memlen);
+	if(snap->mem == NULL)
+		return 1;
+
+	snap->dev   = (struct dtree_dev_t *) snap->mem;
+	snap->count = 0;
+	snap->nprov = 0;
+
+	struct dtree_reg_t *reg = (struct dtree_reg_t *) ((char *) snap->mem + devlen);
+	dtree_addr_t *cpu = (dtree_addr_t *) ((char *) reg + reglen);
+	const char **compat = (const char **) ((char *) cpu + cpulen);
+	struct dtree_prop_t *props = (struct dtree_prop_t *) ((char *) compat + compatlen);
+	char *strings = (char *) props + propslen;
+
+	// devices first, the providers behind them
+	for(size_t i = 0; i < 2 * l->count; ++i) {
+		const struct dtree_dev_t *src = l->dev[i % l->count];
+		if((src->nreg == 0) != (i >= l->count))
+			continue;
+
+		struct dtree_dev_t *dst = &snap->dev[snap->count + snap->nprov];
+		if(src->nreg > 0)
+			snap->count += 1;
+		else
+			snap->nprov += 1;
+
+		dst->name   = pack_string(&strings, src->name);
+		dst->base   = src->base;
+		dst->high   = src->high;
+		dst->compat = compat;
+		dst->reg    = reg;
+		dst->nreg   = src->nreg;
+		dst->cpu    = cpu;
+		dst->phandle = src->phandle;
+
+		memcpy(reg, src->reg, src->nreg * sizeof(struct dtree_reg_t));
+		memcpy(cpu, src->cpu, src->nreg * sizeof(dtree_addr_t));
+		reg += src->nreg;
+		cpu += src->nreg;
+
+		for(size_t c = 0; src->compat[c] != NULL; ++c)
+			*compat++ = pack_string(&strings, src->compat[c]);
+
+		*compat++ = NULL;
+
+		dst->props  = src->nprops > 0? props : NULL;
+		dst->nprops = src->nprops;
+
+		for(size_t p = 0; p < src->nprops; ++p, ++props) {
+			props->name  = pack_string(&strings, src->props[p].name);
+			props->value = memcpy(strings, src->props[p].value, src->props[p].len);
+			props->len   = src->props[p].len;
+			strings += props->len;
+		}
+	}
+
+	assert(strings == (char *) snap->mem + snap->memlen);
+	return 0;
+}
+
+static
+int snapshot_index(struct snapshot *snap)
+{
+	for(size_t i = 0; i < snap->count + snap->nprov; ++i) {
+		const uint32_t *phandle = &snap->dev[i].phandle;
+		if(*phandle != 0 && dtree_index_add(&snap->phandles,
+					(const char *) phandle, sizeof(*phandle), i))
+			return 1;
+
+		// providers are found only by phandle
+		if(i >= snap->count)
+			continue;
+
+		const char *name = snap->dev[i].name;
+		const char *at   = strchr(name, '@');
+
+		if(dtree_index_add(&snap->names, name, strlen(name), i))
+			return 1;
+
+		if(at != NULL && dtree_index_add(&snap->names, name, at - name, i))
+			return 1;
+
+		const char **compat = snap->dev[i].compat;
+		for(size_t c = 0; compat[c] != NULL; ++c) {
+			if(dtree_index_add(&snap->compat, compat[c], strlen(compat[c]), i))
+				return 1;
+		}
+	}
+
+	if(dtree_index_finish(&snap->names))
+		return 1;
+
+	if(dtree_index_finish(&snap->compat))
+		return 1;
+
+	if(dtree_index_finish(&snap->phandles))
+		return 1;
+
+	if(dtree_interval_build(&snap->ranges, snap->dev, snap->count, 0))
+		return 1;
+
+	return dtree_interval_build(&snap->cpu_ranges, snap->dev, snap->count, 1);
+}
+
+/**
+ * Reads all devices of the source into the snapshot.
+ */
+static
+int snapshot_load(struct snapshot *snap, const struct source *src)
+{
+	struct devlist l = {NULL, 0, 0};
+	struct dtree_dev_t *dev = NULL;
+	void *iter = src->backend->iter_new(src->state);
+
+	if(iter == NULL) {
+		dtree_error_from_errno(snap->err);
+		return 1;
+	}
+
+	while((dev = src->backend->next(src->state, iter)) != NULL) {
+		if(devlist_push(&l, dev)) {
+			dtree_error_from_errno(snap->err);
+			src->backend->dev_free(src->state, dev);
+			break;
+		}
+	}
+
+	src->backend->iter_free(src->state, iter);
+
+	// strings are copied, the source is not needed anymore
+	if(dtree_error_isset(snap->err) || snapshot_pack(snap, &l)) {
+		if(!dtree_error_isset(snap->err))
+			dtree_error_from_errno(snap->err);
+
+		devlist_free(&l, src);
+		return 1;
+	}
+
+	devlist_free(&l, src);
+	return 0;
+}
+
+static
+int devlist_emit(void *arg, struct dtree_dev_t *dev)
+{
+	return devlist_push((struct devlist *) arg, dev);
+}
+
+/**
+ * Reads all devices of a procfs tree into the snapshot
+ * by the parallel loader. The devices come in the same
+ * order as from the sequential walk.
+ */
+static
+int snapshot_load_parallel(struct snapshot *snap, const char *rootd, const struct dtree_opts *opts)
+{
+	struct devlist l = {NULL, 0, 0};
+
+	struct procfs_load *ld = dtree_procfs_load(rootd, opts, snap->err);
+	if(ld == NULL)
+		return 1;
+
+	// errors of the load itself are stored by dtree_procfs_load(),
+	// only the list of devices and the pack can fail here
+	int failed = dtree_procfs_load_each(ld, devlist_emit, &l);
+	if(failed) {
+		dtree_errno_set(snap->err, ENOMEM);
+	}
+	else if(snapshot_pack(snap, &l)) {
+		if(!dtree_error_isset(snap->err))
+			dtree_errno_set(snap->err, errno != 0? errno : ENOMEM);
+		failed = 1;
+	}
+
+	// devices are released together with the load
+	free(l.dev);
+	dtree_procfs_load_free(ld);
+	return failed;
+}
+
+void *dtree_snapshot_open(const char *rootd, const struct dtree_opts *opts, struct dtree_error *err)
+{
+	struct source src;
+	src.backend = dtree_backend_detect(rootd);
+
+	// the providers are kept for look ups by phandle
+	struct dtree_opts sopts = *opts;
+	sopts.providers = 1;
+
+	struct snapshot *snap = calloc(1, sizeof(struct snapshot));
+	if(snap == NULL) {
+		dtree_error_from_errno(err);
+		return NULL;
+	}
+
+	snap->err = err;
+	int failed = 0;
+
+	if(opts->threads > 1 && src.backend == &dtree_procfs_backend) {
+		failed = snapshot_load_parallel(snap, rootd, &sopts);
+	}
+	else {
+		src.state = src.backend->open(rootd, &sopts, err);
+		failed = src.state == NULL || snapshot_load(snap, &src);
+
+		if(src.state != NULL)
+			src.backend->close(src.state);
+	}
+
+	if(!failed && snapshot_index(snap)) {
+		dtree_error_from_errno(err);
+		failed = 1;
+	}
+
+	if(failed) {
+		dtree_snapshot_close(snap);
+		return NULL;
+	}
+
+	return snap;
+}
+
+void dtree_snapshot_close(void *state)
+{
+	struct snapshot *snap = (struct snapshot *) state;
+
+	dtree_index_free(&snap->names);
+	dtree_index_free(&snap->compat);
+	dtree_index_free(&snap->phandles);
+	dtree_interval_free(&snap->ranges);
+	dtree_interval_free(&snap->cpu_ranges);
+	free(snap->mem);
+	free(snap);
+}
+
+void *dtree_snapshot_iter_new(void *state)
+{
+	(void) state;
+	return calloc(1, sizeof(struct snapshot_iter));
+}
+
+void *dtree_snapshot_iter_clone(void *state, const void *iter)
+{
+	(void) state;
+
+	struct snapshot_iter *it = malloc(sizeof(struct snapshot_iter));
+	if(it != NULL)
+		memcpy(it, iter, sizeof(struct snapshot_iter));
+
+	return it;
+}
+
+void dtree_snapshot_iter_free(void *state, void *iter)
+{
+	(void) state;
+	free(iter);
+}
+
+struct dtree_dev_t *dtree_snapshot_next(void *state, void *iter)
+{
+	struct snapshot *snap = (struct snapshot *) state;
+	struct snapshot_iter *it = (struct snapshot_iter *) iter;
+
+	if(it->pos >= snap->count)
+		return NULL;
+
+	return &snap->dev[it->pos++];
+}
+
+void dtree_snapshot_dev_free(void *state, struct dtree_dev_t *dev)
+{
+	struct snapshot *snap = (struct snapshot *) state;
+
+	assert(dev != NULL);
+	assert(dev >= snap->dev && dev < snap->dev + snap->count + snap->nprov);
+	(void) snap;
+	(void) dev;
+}
+
+int dtree_snapshot_reset(void *state, void *iter)
+{
+	struct snapshot_iter *it = (struct snapshot_iter *) iter;
+	(void) state;
+
+	it->pos = 0;
+	return 0;
+}
+
+/**
+ * Finds the first device of the list at or behind
+ * the cursor position.
+ */
+static
+struct dtree_dev_t *snapshot_first_from(struct snapshot *snap, struct snapshot_iter *it,
+		const uint32_t *list, size_t count)
+{
+	size_t lo = 0;
+	size_t hi = count;
+
+	while(lo < hi) {
+		const size_t mid = lo + (hi - lo) / 2;
+
+		if(list[mid] < it->pos)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if(lo == count) {
+		it->pos = snap->count;
+		return NULL;
+	}
+
+	it->pos = list[lo] + 1;
+	return &snap->dev[list[lo]];
+}
+
+static
+size_t snapshot_all(struct snapshot *snap, const struct dtree_index *ix, const char *key,
+		struct dtree_dev_t **devs, size_t max)
+{
+	size_t count = 0;
+	const uint32_t *list = dtree_index_find(ix, key, strlen(key), &count);
+
+	if(list == NULL)
+		return 0;
+
+	for(size_t i = 0; i < count && i < max; ++i)
+		devs[i] = &snap->dev[list[i]];
+
+	return count;
+}
+
+struct dtree_dev_t *dtree_snapshot_byname(void *state, void *iter, const char *name)
+{
+	struct snapshot *snap = (struct snapshot *) state;
+	size_t count = 0;
+	const uint32_t *list = dtree_index_find(&snap->names, name, strlen(name), &count);
+
+	return snapshot_first_from(snap, iter, list, list == NULL? 0 : count);
+}
+
+size_t dtree_snapshot_byname_all(void *state, const char *name,
+		struct dtree_dev_t **devs, size_t max)
+{
+	struct snapshot *snap = (struct snapshot *) state;
+	return snapshot_all(snap, &snap->names, name, devs, max);
+}
+
+struct dtree_dev_t *dtree_snapshot_bycompat(void *state, void *iter, const char *compat)
+{
+	struct snapshot *snap = (struct snapshot *) state;
+	size_t count = 0;
+	const uint32_t *list = dtree_index_find(&snap->compat, compat, strlen(compat), &count);
+
+	return snapshot_first_from(snap, iter, list, list == NULL? 0 : count);
+}
+
+size_t dtree_snapshot_bycompat_all(void *state, const char *compat,
+		struct dtree_dev_t **devs, size_t max)
+{
+	struct snapshot *snap = (struct snapshot *) state;
+	return snapshot_all(snap, &snap->compat, compat, devs, max);
+}
+
+struct dtree_dev_t *dtree_snapshot_byphandle(void *state, uint32_t phandle)
+{
+	struct snapshot *snap = (struct snapshot *) state;
+	size_t count = 0;
+	const uint32_t *list = dtree_index_find(&snap->phandles,
+			(const char *) &phandle, sizeof(phandle), &count);
+
+	return list == NULL? NULL : &snap->dev[list[0]];
+}
+
+/**
+ * The first hit at or behind the iterator.
+ */
+struct addr_hit {
+	size_t   pos;
+	uint32_t first;
+};
+
+static
+void byaddr_hit(uint32_t dev, void *arg)
+{
+	struct addr_hit *hit = (struct addr_hit *) arg;
+
+	if(dev >= hit->pos && dev < hit->first)
+		hit->first = dev;
+}
+
+struct dtree_dev_t *dtree_snapshot_byaddr(void *state, void *iter, dtree_addr_t addr, int cpu)
+{
+	struct snapshot *snap = (struct snapshot *) state;
+	struct snapshot_iter *it = (struct snapshot_iter *) iter;
+	struct addr_hit hit = {it->pos, UINT32_MAX};
+
+	dtree_interval_query(cpu? &snap->cpu_ranges : &snap->ranges, addr, addr, byaddr_hit, &hit);
+
+	if(hit.first == UINT32_MAX) {
+		it->pos = snap->count;
+		return NULL;
+	}
+
+	it->pos = hit.first + 1;
+	return &snap->dev[hit.first];
+}
+
+/**
+ * Hits of a range query collected in the order of iteration.
+ */
+struct range_hits {
+	uint32_t *dev;
+	size_t count;
+	size_t cap;
+	int    failed;
+};
+
+static
+void byrange_hit(uint32_t dev, void *arg)
+{
+	struct range_hits *hits = (struct range_hits *) arg;
+
+	if(hits->count == hits->cap) {
+		size_t cap = hits->cap == 0? 16 : hits->cap * 2;
+
+		uint32_t *d = realloc(hits->dev, cap * sizeof(uint32_t));
+		if(d == NULL) {
+			hits->failed = 1;
+			return;
+		}
+
+		hits->dev = d;
+		hits->cap = cap;
+	}
+
+	hits->dev[hits->count++] = dev;
+}
+
+static
+int dev_cmp(const void *a, const void *b)
+{
+	const uint32_t l = *(const uint32_t *) a;
+	const uint32_t r = *(const uint32_t *) b;
+	return l < r? -1 : (l > r);
+}
+
+size_t dtree_snapshot_byrange(void *state, dtree_addr_t lo, dtree_addr_t hi, int cpu,
+		struct dtree_dev_t **devs, size_t max)
+{
+	struct snapshot *snap = (struct snapshot *) state;
+	struct range_hits hits = {NULL, 0, 0, 0};
+
+	dtree_interval_query(cpu? &snap->cpu_ranges : &snap->ranges, lo, hi, byrange_hit, &hits);
+
+	// the state may be shared, the caller reports the error
+	if(hits.failed) {
+		free(hits.dev);
+		errno = ENOMEM;
+		return DTREE_RANGE_FAILED;
+	}
+
+	qsort(hits.dev, hits.count, sizeof(uint32_t), dev_cmp);
+
+	// a device is hit by each of its intersecting ranges
+	size_t count = 0;
+	for(size_t i = 0; i < hits.count; ++i) {
+		if(count > 0 && hits.dev[i] == hits.dev[i - 1])
+			continue;
+
+		if(count < max)
+			devs[count] = &snap->dev[hits.dev[i]];
+		count += 1;
+	}
+
+	free(hits.dev);
+	return count;
+}
+
+void dtree_snapshot_stats(void *state, struct dtree_stats_t *stats)
+{
+	struct snapshot *snap = (struct snapshot *) state;
+
+	stats->devices = snap->count;
+	stats->memory  = (unsigned long) (snap->memlen
+	               + dtree_index_memory(&snap->names)
+	               + dtree_index_memory(&snap->compat)
+	               + dtree_index_memory(&snap->phandles)
+	               + dtree_interval_memory(&snap->ranges)
+	               + dtree_interval_memory(&snap->cpu_ranges));
+	stats->overlaps = snap->cpu_ranges.overlaps;
+}
+
+const struct dtree_backend dtree_snapshot_backend = {
+	.name         = "snapshot",
+	.open         = dtree_snapshot_open,
+	.close        = dtree_snapshot_close,
+	.iter_new     = dtree_snapshot_iter_new,
+	.iter_clone   = dtree_snapshot_iter_clone,
+	.iter_free    = dtree_snapshot_iter_free,
+	.next         = dtree_snapshot_next,
+	.reset        = dtree_snapshot_reset,
+	.dev_free     = dtree_snapshot_dev_free,
+	.byname       = dtree_snapshot_byname,
+	.byname_all   = dtree_snapshot_byname_all,
+	.bycompat     = dtree_snapshot_bycompat,
+	.bycompat_all = dtree_snapshot_bycompat_all,
+	.byaddr       = dtree_snapshot_byaddr,
+	.byrange      = dtree_snapshot_byrange,
+	.byphandle    = dtree_snapshot_byphandle,
+	.stats        = dtree_snapshot_stats,
+};
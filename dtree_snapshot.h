@@ -0,0 +1,99 @@
+/**
+ * Internal in-memory snapshot implementation.
+ * Non-public API.
+ */
+
+#ifndef DTREE_SNAPSHOT
+#define DTREE_SNAPSHOT
+
+#include "dtree.h"
+
+#include <stddef.h>
+
+struct dtree_opts;
+struct dtree_error;
+
+/**
+ * Loads the whole tree at the given path into
+ * memory (using the backend chosen by
+ * dtree_backend_detect()). A procfs tree is loaded
+ * by opts->threads in parallel when more than one.
+ *
+ * Initializes internal structures. Does not
+ * clear error flag. Returns the state of the
+ * snapshot or NULL on error (set in err).
+ */
+void *dtree_snapshot_open(const char *rootd, const struct dtree_opts *opts, struct dtree_error *err);
+
+/**
+ * Free's all resources.
+ */
+void dtree_snapshot_close(void *state);
+
+/**
+ * Cursors over the snapshot (a device number).
+ */
+void *dtree_snapshot_iter_new(void *state);
+void *dtree_snapshot_iter_clone(void *state, const void *iter);
+void dtree_snapshot_iter_free(void *state, void *iter);
+
+/**
+ * Traversing over the snapshot. Does not touch
+ * the filesystem.
+ */
+struct dtree_dev_t *dtree_snapshot_next(void *state, void *iter);
+
+/**
+ * Devices are owned by the snapshot, this is no-op.
+ */
+void dtree_snapshot_dev_free(void *state, struct dtree_dev_t *dev);
+
+/**
+ * Reset of iteration over the snapshot.
+ */
+int dtree_snapshot_reset(void *state, void *iter);
+
+/**
+ * Look up by the names index.
+ */
+struct dtree_dev_t *dtree_snapshot_byname(void *state, void *iter, const char *name);
+
+/**
+ * Look up of all devices by the names index.
+ */
+size_t dtree_snapshot_byname_all(void *state, const char *name,
+		struct dtree_dev_t **devs, size_t max);
+
+/**
+ * Look up by the compat index.
+ */
+struct dtree_dev_t *dtree_snapshot_bycompat(void *state, void *iter, const char *compat);
+
+/**
+ * Look up of all devices by the compat index.
+ */
+size_t dtree_snapshot_bycompat_all(void *state, const char *compat,
+		struct dtree_dev_t **devs, size_t max);
+
+/**
+ * Look up by the ranges index.
+ */
+struct dtree_dev_t *dtree_snapshot_byaddr(void *state, void *iter, dtree_addr_t addr, int cpu);
+
+/**
+ * Look up of all devices intersecting the range by the ranges index.
+ */
+size_t dtree_snapshot_byrange(void *state, dtree_addr_t lo, dtree_addr_t hi, int cpu,
+		struct dtree_dev_t **devs, size_t max);
+
+/**
+ * Look up by the phandles index.
+ */
+struct dtree_dev_t *dtree_snapshot_byphandle(void *state, uint32_t phandle);
+
+/**
+ * Fills the load statistics of the snapshot.
+ */
+void dtree_snapshot_stats(void *state, struct dtree_stats_t *stats);
+
+#endif
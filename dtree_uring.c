@@ -0,0 +1,354 @@
+/**
+ * dtree_uring.c
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "dtree_uring.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#define DTREE_HAVE_URING
+#include <linux/io_uring.h>
+#endif
+#endif
+
+#ifdef DTREE_HAVE_URING
+
+/**
+ * Every file is read by a chain of three requests:
+ *
+ *   openat (into the direct descriptor of the file)
+ *   read   (by that descriptor)
+ *   close  (of that descriptor)
+ *
+ * The chain is hard-linked so the descriptor is closed even
+ * when the read fails. user_data holds index * 3 + step.
+ */
+#define URING_STEPS 3
+
+struct dtree_uring {
+	int fd;
+	unsigned max;
+
+	void  *ring;
+	size_t ring_len;
+	struct io_uring_sqe *sqes;
+	size_t sqes_len;
+
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	// result of the open of each file of the batch
+	long *opened;
+};
+
+static
+int uring_enter(int fd, unsigned submit, unsigned wait)
+{
+	return (int) syscall(__NR_io_uring_enter, fd, submit, wait,
+			wait > 0? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+}
+
+static
+struct io_uring_sqe *uring_sqe(struct dtree_uring *u, unsigned tail,
+		int op, int fd, unsigned long long user_data)
+{
+	const unsigned i = tail & *u->sq_mask;
+	struct io_uring_sqe *sqe = &u->sqes[i];
+
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	sqe->opcode    = op;
+	sqe->fd        = fd;
+	sqe->user_data = user_data;
+
+	u->sq_array[i] = i;
+	return sqe;
+}
+
+/**
+ * Submits all queued requests and reaps count completions.
+ * Calls done for each of them.
+ */
+static
+int uring_run(struct dtree_uring *u, unsigned count,
+		void (*done)(struct dtree_uring *u, const struct io_uring_cqe *cqe, void *arg), void *arg)
+{
+	unsigned submit = count;
+	unsigned reaped = 0;
+
+	while(reaped < count) {
+		int ret = uring_enter(u->fd, submit, count - reaped);
+		if(ret < 0 && errno == EINTR)
+			continue;
+		if(ret < 0)
+			return 1;
+
+		submit -= (unsigned) ret < submit? (unsigned) ret : submit;
+
+		unsigned head = *u->cq_head;
+		const unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+
+		for(; head != tail; ++head, ++reaped)
+			done(u, &u->cqes[head & *u->cq_mask], arg);
+
+		__atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+	}
+
+	return 0;
+}
+
+static
+void read_done(struct dtree_uring *u, const struct io_uring_cqe *cqe, void *arg)
+{
+	struct dtree_uring_read *rd = (struct dtree_uring_read *) arg;
+	const size_t i = (size_t) (cqe->user_data / URING_STEPS);
+
+	switch(cqe->user_data % URING_STEPS) {
+	case 0:
+		u->opened[i] = cqe->res;
+		break;
+	case 1:
+		rd[i].res = cqe->res;
+		break;
+	default:
+		break; // nothing to do about close
+	}
+}
+
+int dtree_uring_read(struct dtree_uring *u, int dirfd, struct dtree_uring_read *rd, size_t n)
+{
+	unsigned tail = *u->sq_tail;
+
+	if(n > u->max) {
+		errno = EINVAL;
+		return 1;
+	}
+
+	for(size_t i = 0; i < n; ++i) {
+		struct io_uring_sqe *sqe;
+		const unsigned long long id = i * URING_STEPS;
+
+		sqe = uring_sqe(u, tail++, IORING_OP_OPENAT, dirfd, id);
+		sqe->addr       = (uintptr_t) rd[i].name;
+		sqe->open_flags = O_RDONLY; // direct descriptors refuse O_CLOEXEC
+		sqe->file_index = i + 1;
+		sqe->flags      = IOSQE_IO_HARDLINK;
+
+		sqe = uring_sqe(u, tail++, IORING_OP_READ, (int) i, id + 1);
+		sqe->addr  = (uintptr_t) rd[i].buf;
+		sqe->len   = (unsigned) rd[i].len;
+		sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+
+		sqe = uring_sqe(u, tail++, IORING_OP_CLOSE, 0, id + 2);
+		sqe->file_index = i + 1;
+	}
+
+	__atomic_store_n(u->sq_tail, tail, __ATOMIC_RELEASE);
+
+	if(uring_run(u, n * URING_STEPS, read_done, rd))
+		return 1;
+
+	for(size_t i = 0; i < n; ++i) {
+		if(u->opened[i] < 0)
+			rd[i].res = u->opened[i];
+	}
+
+	return 0;
+}
+
+static
+void probe_done(struct dtree_uring *u, const struct io_uring_cqe *cqe, void *arg)
+{
+	(void) arg;
+
+	if(cqe->user_data == 0)
+		u->opened[0] = cqe->res;
+}
+
+/**
+ * Kernels before direct descriptors reject the file_index
+ * of openat with EINVAL. Opens and closes "/" to find out.
+ */
+static
+int uring_probe(struct dtree_uring *u)
+{
+	unsigned tail = *u->sq_tail;
+	struct io_uring_sqe *sqe;
+
+	sqe = uring_sqe(u, tail++, IORING_OP_OPENAT, AT_FDCWD, 0);
+	sqe->addr       = (uintptr_t) "/";
+	sqe->open_flags = O_RDONLY | O_DIRECTORY;
+	sqe->file_index = 1;
+	sqe->flags      = IOSQE_IO_HARDLINK;
+
+	sqe = uring_sqe(u, tail++, IORING_OP_CLOSE, 0, 1);
+	sqe->file_index = 1;
+
+	__atomic_store_n(u->sq_tail, tail, __ATOMIC_RELEASE);
+
+	if(uring_run(u, 2, probe_done, NULL))
+		return 1;
+
+	if(u->opened[0] < 0) {
+		errno = (int) -u->opened[0];
+		return 1;
+	}
+
+	return 0;
+}
+
+static
+int uring_map(struct dtree_uring *u, const struct io_uring_params *p)
+{
+	if(!(p->features & IORING_FEAT_SINGLE_MMAP)) {
+		errno = ENOSYS;
+		return 1;
+	}
+
+	const size_t sq_len = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+	const size_t cq_len = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+
+	u->ring_len = sq_len > cq_len? sq_len : cq_len;
+	u->ring = mmap(NULL, u->ring_len, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+	if(u->ring == MAP_FAILED) {
+		u->ring = NULL;
+		return 1;
+	}
+
+	u->sqes_len = p->sq_entries * sizeof(struct io_uring_sqe);
+	u->sqes = mmap(NULL, u->sqes_len, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+	if(u->sqes == MAP_FAILED) {
+		u->sqes = NULL;
+		return 1;
+	}
+
+	char *ring = (char *) u->ring;
+	u->sq_head  = (unsigned *) (ring + p->sq_off.head);
+	u->sq_tail  = (unsigned *) (ring + p->sq_off.tail);
+	u->sq_mask  = (unsigned *) (ring + p->sq_off.ring_mask);
+	u->sq_array = (unsigned *) (ring + p->sq_off.array);
+	u->cq_head  = (unsigned *) (ring + p->cq_off.head);
+	u->cq_tail  = (unsigned *) (ring + p->cq_off.tail);
+	u->cq_mask  = (unsigned *) (ring + p->cq_off.ring_mask);
+	u->cqes     = (struct io_uring_cqe *) (ring + p->cq_off.cqes);
+	return 0;
+}
+
+/**
+ * Registers max empty slots for the direct descriptors.
+ */
+static
+int uring_register_files(struct dtree_uring *u)
+{
+	int *fds = malloc(u->max * sizeof(int));
+	if(fds == NULL)
+		return 1;
+
+	for(unsigned i = 0; i < u->max; ++i)
+		fds[i] = -1;
+
+	long ret = syscall(__NR_io_uring_register, u->fd, IORING_REGISTER_FILES, fds, u->max);
+	free(fds);
+
+	return ret < 0;
+}
+
+struct dtree_uring *dtree_uring_new(unsigned max)
+{
+	if(max == 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	struct dtree_uring *u = calloc(1, sizeof(struct dtree_uring));
+	if(u == NULL)
+		return NULL;
+
+	u->max    = max;
+	u->opened = calloc(max, sizeof(long));
+	if(u->opened == NULL) {
+		free(u);
+		return NULL;
+	}
+
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+
+	u->fd = (int) syscall(__NR_io_uring_setup, max * URING_STEPS, &p);
+	if(u->fd < 0) {
+		free(u->opened);
+		free(u);
+		return NULL;
+	}
+
+	if(uring_map(u, &p) || uring_register_files(u) || uring_probe(u)) {
+		const int e = errno;
+		dtree_uring_free(u);
+		errno = e;
+		return NULL;
+	}
+
+	return u;
+}
+
+void dtree_uring_free(struct dtree_uring *u)
+{
+	if(u == NULL)
+		return;
+
+	if(u->sqes != NULL)
+		munmap(u->sqes, u->sqes_len);
+	if(u->ring != NULL)
+		munmap(u->ring, u->ring_len);
+
+	close(u->fd);
+	free(u->opened);
+	free(u);
+}
+
+#else
+
+struct dtree_uring *dtree_uring_new(unsigned max)
+{
+	(void) max;
+
+	errno = ENOSYS;
+	return NULL;
+}
+
+void dtree_uring_free(struct dtree_uring *u)
+{
+	(void) u;
+}
+
+int dtree_uring_read(struct dtree_uring *u, int dirfd, struct dtree_uring_read *rd, size_t n)
+{
+	(void) u;
+	(void) dirfd;
+	(void) rd;
+	(void) n;
+
+	errno = ENOSYS;
+	return 1;
+}
+
+#endif
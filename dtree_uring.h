@@ -0,0 +1,48 @@
+/**
+ * Internal batched file reader based on io_uring.
+ * Non-public API.
+ */
+
+#ifndef DTREE_URING
+#define DTREE_URING
+
+#include <stddef.h>
+
+struct dtree_uring;
+
+/**
+ * A file to be read by dtree_uring_read(). The name is relative
+ * to the directory of the batch. At most len bytes are read into
+ * buf. After the batch res is the number of bytes read or -errno
+ * (of the open or of the read).
+ */
+struct dtree_uring_read {
+	const char *name;
+	void  *buf;
+	size_t len;
+	long   res;
+};
+
+/**
+ * Creates a ring reading up to max files in one batch. Needs
+ * the direct descriptors of io_uring (Linux 5.15). Returns
+ * NULL when io_uring is unavailable (errno is set), the caller
+ * is expected to fall back to the plain syscalls.
+ */
+struct dtree_uring *dtree_uring_new(unsigned max);
+
+void dtree_uring_free(struct dtree_uring *u);
+
+/**
+ * Opens, reads and closes the n files (n <= max) relative to
+ * the directory dirfd by a single io_uring_enter(). The files
+ * never get a regular file descriptor. Results are stored in
+ * res of each read.
+ *
+ * Returns 0 when the batch has completed (even when some of
+ * the files could not be read), 1 when the ring itself has
+ * failed (errno is set).
+ */
+int dtree_uring_read(struct dtree_uring *u, int dirfd, struct dtree_uring_read *rd, size_t n);
+
+#endif
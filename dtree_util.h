@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
 
 static inline
@@ -46,4 +47,36 @@ uint32_t parse_hex(const char *s, size_t slen)
 	return val;
 }
 
+/**
+ * The name matches either the full device name or
+ * the device name without the unit address.
+ */
+static inline
+int name_matches(const char *name, const char *devname)
+{
+	if(!strcmp(name, devname))
+		return 1;
+
+	if(strchr(name, '@') != NULL)
+		return 0;
+
+	const char *at = strchr(devname, '@');
+	if(at == NULL)
+		return 0;
+
+	const size_t len = at - devname;
+	return strlen(name) == len && !strncmp(name, devname, len);
+}
+
+/**
+ * The property is a number of cells (eg. #clock-cells, the size
+ * of the specifiers of references to the node).
+ */
+static inline
+int prop_is_cells(const char *name)
+{
+	const size_t len = strlen(name);
+	return name[0] == '#' && len > 7 && !strcmp(name + len - 6, "-cells");
+}
+
 #endif
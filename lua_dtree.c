@@ -83,7 +83,7 @@ int l_dtree_next(lua_State *l) {
 		return 1;
 	}
 
-	lua_createtable(l, 0, 4);
+	lua_createtable(l, 0, 6);
 
 	lua_pushstring(l, "name");
 	lua_pushstring(l, dtree_dev_name(dev));
@@ -97,6 +97,20 @@ int l_dtree_next(lua_State *l) {
 	lua_pushinteger(l, dtree_dev_high(dev));
 	lua_rawset(l, -3);
 
+	// CPU address, missing when the device is not mapped
+	if(dtree_dev_cpu_base(dev) != DTREE_ADDR_NONE) {
+		lua_pushstring(l, "cpu");
+		lua_pushinteger(l, dtree_dev_cpu_base(dev));
+		lua_rawset(l, -3);
+	}
+
+	// missing when the device has no phandle
+	if(dtree_dev_phandle(dev) != 0) {
+		lua_pushstring(l, "phandle");
+		lua_pushinteger(l, dtree_dev_phandle(dev));
+		lua_rawset(l, -3);
+	}
+
 	lua_pushstring(l, "compat");
 	lua_newtable(l);
 	const char **compat = dtree_dev_compat(dev);
@@ -105,5 +105,144 @@ void *stack_top(struct stack **s)
 	return curr->data;
 }
 
-#endif
+/**
+ * Contiguous stack of path fragments. The fragments are
+ * stored back to back in a single buffer separated by '/'
+ * so the buffer is always the full path of the top. Every
+ * level keeps the offset of its fragment and a data pointer.
+ * Push and pop are amortized O(1) and do not allocate once
+ * the buffers have grown to the maximal depth.
+ */
+struct path_level {
+	size_t start; // length of the path before the push
+	size_t name;  // offset of the fragment
+	void  *data;
+};
+
+struct path_stack {
+	char   *path;
+	size_t  len;
+	size_t  cap;
+
+	struct path_level *level;
+	size_t  depth;
+	size_t  level_cap;
+};
+
+#define PATH_STACK_INIT {NULL, 0, 0, NULL, 0, 0}
+
+static inline
+size_t path_stack_depth(const struct path_stack *s)
+{
+	return s->depth;
+}
+
+static inline
+int path_stack_empty(const struct path_stack *s)
+{
+	return s->depth == 0;
+}
+
+/**
+ * Full path of the top level ("" when empty).
+ * Valid until the next push.
+ */
+static inline
+const char *path_stack_path(const struct path_stack *s)
+{
+	return s->path == NULL? "" : s->path;
+}
+
+static inline
+size_t path_stack_len(const struct path_stack *s)
+{
+	return s->len;
+}
+
+/**
+ * Fragment of the top level (NULL when empty).
+ * Valid until the next push.
+ */
+static inline
+const char *path_stack_name(const struct path_stack *s)
+{
+	if(s->depth == 0)
+		return NULL;
+
+	return s->path + s->level[s->depth - 1].name;
+}
 
+static inline
+void *path_stack_top(const struct path_stack *s)
+{
+	if(s->depth == 0)
+		return NULL;
+
+	return s->level[s->depth - 1].data;
+}
+
+static inline
+int path_stack_push(struct path_stack *s, const char *name, void *data)
+{
+	const size_t nlen = strlen(name);
+	const int sep = s->len > 0 && s->path[s->len - 1] != '/';
+	const size_t need = s->len + sep + nlen + 1;
+
+	if(need > s->cap) {
+		size_t cap = s->cap == 0? 256 : s->cap;
+		while(need > cap)
+			cap *= 2;
+
+		char *path = realloc(s->path, cap);
+		if(path == NULL)
+			return 1;
+
+		s->path = path;
+		s->cap  = cap;
+	}
+
+	if(s->depth == s->level_cap) {
+		size_t cap = s->level_cap == 0? 16 : s->level_cap * 2;
+
+		struct path_level *level = realloc(s->level, cap * sizeof(struct path_level));
+		if(level == NULL)
+			return 1;
+
+		s->level     = level;
+		s->level_cap = cap;
+	}
+
+	struct path_level *l = &s->level[s->depth++];
+	l->start = s->len;
+	l->name  = s->len + sep;
+	l->data  = data;
+
+	if(sep)
+		s->path[s->len] = '/';
+
+	memcpy(s->path + l->name, name, nlen + 1);
+	s->len = need - 1;
+	return 0;
+}
+
+static inline
+void *path_stack_pop(struct path_stack *s)
+{
+	if(s->depth == 0)
+		return NULL;
+
+	struct path_level *l = &s->level[--s->depth];
+	s->len = l->start;
+	s->path[s->len] = '\0';
+	return l->data;
+}
+
+static inline
+void path_stack_free(struct path_stack *s)
+{
+	free(s->path);
+	free(s->level);
+	memset(s, 0, sizeof(struct path_stack));
+}
+
+#endif
@@ -0,0 +1,111 @@
+#include "dtree.h"
+#include "test.h"
+
+#include <string.h>
+
+void test_find_all_containing(void)
+{
+	test_start();
+
+	struct dtree_dev_t *dev = NULL;
+	int serial = 0;
+	int count  = 0;
+
+	while((dev = dtree_byaddr(0x84000010)) != NULL) {
+		const char  *name = dtree_dev_name(dev);
+		dtree_addr_t base = dtree_dev_base(dev);
+		dtree_addr_t high = dtree_dev_high(dev);
+
+		printf("DEV '%s' at 0x%08llX .. 0x%08llX\n", name,
+				(unsigned long long) base, (unsigned long long) high);
+		if(!strcmp(name, "serial@84000000"))
+			serial += 1;
+
+		count += 1;
+		dtree_dev_free(dev);
+	}
+
+	fail_on_true(dtree_iserror(), "An error occured during the look up");
+	fail_on_false(serial == 1, "Device 'serial@84000000' was not found");
+	fail_on_false(count == 2, "Expected plb@0 and serial@84000000 only");
+
+	test_end();
+}
+
+void test_find_base(void)
+{
+	test_start();
+
+	struct dtree_dev_t *dev = NULL;
+	int found = 0;
+
+	while((dev = dtree_byaddr(0x50000000)) != NULL) {
+		if(!strcmp(dtree_dev_name(dev), "memory@50000000"))
+			found = 1;
+
+		dtree_dev_free(dev);
+	}
+
+	fail_on_false(found, "Device 'memory@50000000' was not found by its base");
+
+	test_end();
+}
+
+void test_find_past_high(void)
+{
+	test_start();
+
+	struct dtree_dev_t *dev = NULL;
+
+	while((dev = dtree_byaddr(0x50010000)) != NULL) {
+		fail_on_false(!strcmp(dtree_dev_name(dev), "plb@0"), "Address 0x50010000 is out of memory@50000000");
+		dtree_dev_free(dev);
+	}
+
+	test_end();
+}
+
+void test_find_range(void)
+{
+	test_start();
+
+	struct dtree_dev_t *devs[8];
+	size_t count = dtree_byrange(0x84000000, 0x8800FFFF, devs, 8);
+
+	fail_on_true(dtree_iserror(), "An error occured during the look up");
+	fail_on_false(count == 4, "Expected plb@0, debug and both serial devices");
+
+	int ordered = count >= 1 && !strcmp(dtree_dev_name(devs[0]), "plb@0");
+
+	for(size_t i = 0; i < count && i < 8; ++i) {
+		printf("DEV '%s'\n", dtree_dev_name(devs[i]));
+		dtree_dev_free(devs[i]);
+	}
+
+	fail_on_false(ordered, "Devices are not in the order of iteration");
+
+	count = dtree_byrange(0x8400FFFF, 0x84000000, devs, 8);
+	fail_on_false(count == 0, "Reversed range must not match");
+
+	test_end();
+}
+
+int main(void)
+{
+	int err = dtree_open(test_tree());
+	halt_on_error(err, "Can not open testing device-tree");
+
+	test_find_all_containing();
+	dtree_reset();
+
+	test_find_base();
+	dtree_reset();
+
+	test_find_past_high();
+	dtree_reset();
+
+	test_find_range();
+	dtree_reset();
+
+	dtree_close();
+}
@@ -14,7 +14,7 @@ void test_find_existent(void)
 		const char  *name = dtree_dev_name(dev);
 		dtree_addr_t base = dtree_dev_base(dev);
 
-		printf("DEV '%s' at 0x%08X\n", name, base);
+		printf("DEV '%s' at 0x%08llX\n", name, (unsigned long long) base);
 		dtree_dev_free(dev);
 	}
 
@@ -70,7 +70,8 @@ void test_find_serial_1_00_a(void)
 		dtree_addr_t base = dtree_dev_base(dev);
 		dtree_addr_t high = dtree_dev_high(dev);
 
-		printf("DEV '%s' at 0x%08X .. 0x%08X\n", name, base, high);
+		printf("DEV '%s' at 0x%08llX .. 0x%08llX\n", name,
+				(unsigned long long) base, (unsigned long long) high);
 		dtree_dev_free(dev);
 	}
 
@@ -79,9 +80,32 @@ void test_find_serial_1_00_a(void)
 	test_end();
 }
 
+void test_find_all(void)
+{
+	test_start();
+
+	struct dtree_dev_t *devs[4];
+	size_t count = dtree_bycompat_all("xlnx,xps-uartlite-1.01.a", devs, 4);
+	fail_on_false(count == 2, "Expected two xlnx,xps-uartlite-1.01.a compatible components");
+
+	for(size_t i = 0; i < count; ++i) {
+		printf("DEV '%s' at 0x%08llX\n", dtree_dev_name(devs[i]),
+				(unsigned long long) dtree_dev_base(devs[i]));
+		dtree_dev_free(devs[i]);
+	}
+
+	count = dtree_bycompat_all("simple-bus", devs, 0);
+	fail_on_false(count == 1, "Expected single simple-bus compatible component");
+
+	count = dtree_bycompat_all("@not-implemented-device", devs, 4);
+	fail_on_false(count == 0, "Device '@not-implemented-device' was found!");
+
+	test_end();
+}
+
 int main(void)
 {
-	int err = dtree_open("device-tree");
+	int err = dtree_open(test_tree());
 	halt_on_error(err, "Can not open testing device-tree");
 
 	test_find_existent();
@@ -99,6 +123,8 @@ int main(void)
 	test_find_serial_1_00_a();
 	dtree_reset();
 
+	test_find_all();
+
 	dtree_close();
 }
 
@@ -1,6 +1,10 @@
 #include "dtree.h"
+#include "dtree_procfs.h"
 #include "test.h"
 
+#include <string.h>
+#include <sys/stat.h>
+
 void test_list_all(void)
 {
 	test_start();
@@ -10,7 +14,7 @@ void test_list_all(void)
 		const char  *name = dtree_dev_name(dev);
 		dtree_addr_t base = dtree_dev_base(dev);
 
-		printf("DEV '%s' at 0x%08X\n", name, base);
+		printf("DEV '%s' at 0x%08llX\n", name, (unsigned long long) base);
 		print_compat(dev);
 		dtree_dev_free(dev);
 	}
@@ -29,7 +33,7 @@ void test_find_existent(void)
 	const char  *name = dtree_dev_name(dev);
 	dtree_addr_t base = dtree_dev_base(dev);
 
-	printf("DEV '%s' at 0x%08X\n", name, base);
+	printf("DEV '%s' at 0x%08llX\n", name, (unsigned long long) base);
 	dtree_dev_free(dev);
 
 	test_end();
@@ -82,7 +86,7 @@ void test_find_with_discriminator(void)
 
 	fail_on_false(high - base == 0xFFFF, "Invalid high detected for serial@84000000)");
 
-	printf("DEV '%s' at 0x%08X\n", name, base);
+	printf("DEV '%s' at 0x%08llX\n", name, (unsigned long long) base);
 	dtree_dev_free(dev);
 
 	test_end();
@@ -100,16 +104,103 @@ void test_find_debug(void)
 	dtree_addr_t base = dtree_dev_base(dev);
 	dtree_addr_t high = dtree_dev_high(dev);
 
-	printf("DEV '%s' at 0x%08X .. 0x%08X\n", name, base, high);
+	printf("DEV '%s' at 0x%08llX .. 0x%08llX\n", name,
+				(unsigned long long) base, (unsigned long long) high);
 	dtree_dev_free(dev);
 
 	fail_on_false(high - base == 0xFFFF, "Invalid high has been read for debug@84400000");
 	test_end();
 }
 
+void test_find_base_name(void)
+{
+	test_start();
+
+	struct dtree_dev_t *dev = NULL;
+	dev = dtree_byname("ethernet");
+	fail_on_true(dev == NULL, "Could not find the device 'ethernet' without unit address");
+	fail_on_false(dtree_dev_base(dev) == 0x81000000, "Invalid base of 'ethernet'");
+	dtree_dev_free(dev);
+
+	dtree_reset();
+
+	int count = 0;
+	while((dev = dtree_byname("serial")) != NULL) {
+		count += 1;
+		dtree_dev_free(dev);
+	}
+
+	fail_on_false(count == 2, "Expected two 'serial' devices");
+
+	dtree_reset();
+	dev = dtree_byname("seria");
+	fail_on_false(dev == NULL, "Device 'seria' was found!");
+
+	test_end();
+}
+
+void test_find_all(void)
+{
+	test_start();
+
+	struct dtree_dev_t *devs[4];
+	size_t count = dtree_byname_all("serial", devs, 1);
+	fail_on_false(count == 2, "Expected two 'serial' devices");
+	fail_on_false(!strncmp(dtree_dev_name(devs[0]), "serial@", 7), "Invalid device stored");
+	dtree_dev_free(devs[0]);
+
+	count = dtree_byname_all("timer@83c00000", devs, 4);
+	fail_on_false(count == 1, "Expected single 'timer@83c00000' device");
+	dtree_dev_free(devs[0]);
+
+	count = dtree_byname_all("@not-implemented-device", devs, 4);
+	fail_on_false(count == 0, "Device '@not-implemented-device' was found!");
+
+	test_end();
+}
+
+/**
+ * Names are compared before any property is read: only
+ * reg and compatible of the matching devices are read.
+ */
+void test_find_no_io(void)
+{
+	test_start();
+
+	struct stat st;
+	if(stat(test_tree(), &st) || !S_ISDIR(st.st_mode)) {
+		test_warn("Not a procfs tree, skipping");
+		test_end();
+		return;
+	}
+
+	dtree_ctx_t *ctx = dtree_ctx_new();
+	halt_on_true(ctx == NULL, "Can not allocate context");
+	halt_on_true(dtree_ctx_open(ctx, test_tree()), "Can not open testing device-tree");
+
+	struct dtree_dev_t *dev = dtree_ctx_byname(ctx, "@not-implemented-device");
+	fail_on_false(dev == NULL, "Device '@not-implemented-device' was found!");
+	fail_on_false(dtree_procfs_prop_count(ctx) == 0, "Properties read for no device");
+
+	dtree_ctx_reset(ctx);
+
+	int count = 0;
+	while((dev = dtree_ctx_byname(ctx, "serial")) != NULL) {
+		count += 1;
+		dtree_ctx_dev_free(ctx, dev);
+	}
+
+	printf("properties read: %lu\n", dtree_procfs_prop_count(ctx));
+	fail_on_false(count == 2, "Expected two 'serial' devices");
+	fail_on_false(dtree_procfs_prop_count(ctx) == 4, "Properties of other devices read");
+
+	dtree_ctx_free(ctx);
+	test_end();
+}
+
 int main(void)
 {
-	int err = dtree_open("device-tree");
+	int err = dtree_open(test_tree());
 	halt_on_error(err, "Can not open testing device-tree");
 
 	test_list_all();
@@ -133,6 +224,13 @@ int main(void)
 	test_find_debug();
 	dtree_reset();
 
+	test_find_base_name();
+	dtree_reset();
+
+	test_find_all();
+
 	dtree_close();
+
+	test_find_no_io();
 }
 
@@ -0,0 +1,264 @@
+#define _XOPEN_SOURCE 700
+
+#include "dtree.h"
+#include "dtree_procfs.h"
+#include "test.h"
+#include "test_gen.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static
+int gen_phandle(const char *dir, const char *prop, unsigned phandle)
+{
+	const unsigned char cell[4] = {phandle >> 24, phandle >> 16, phandle >> 8, phandle};
+	return gen_write(dir, prop, cell, sizeof(cell));
+}
+
+/**
+ * Creates the tree:
+ *
+ *   intc@1000   phandle 1, #clock-cells 1
+ *   gpio@2000   linux,phandle 2, #clock-cells 2
+ *   both@3000   phandle 3, linux,phandle 9 (ignored)
+ *   clocks      phandle 4, #clock-cells 0, no reg (a provider)
+ *   user@4000   no phandle
+ */
+static
+int gen_phandle_tree(char *root)
+{
+	char path[512];
+
+	if(mkdtemp(root) == NULL)
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/intc@1000", root);
+	if(gen_node(path, "intc", 0x1000, 0x100, "test,intc") || gen_phandle(path, "phandle", 1))
+		return 1;
+	if(gen_phandle(path, "#clock-cells", 1))
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/gpio@2000", root);
+	if(gen_node(path, "gpio", 0x2000, 0x100, "test,gpio") || gen_phandle(path, "linux,phandle", 2))
+		return 1;
+	if(gen_phandle(path, "#clock-cells", 2))
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/both@3000", root);
+	if(gen_node(path, "both", 0x3000, 0x100, "test,both") || gen_phandle(path, "phandle", 3))
+		return 1;
+	if(gen_phandle(path, "linux,phandle", 9))
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/clocks", root);
+	if(mkdir(path, 0755) || gen_write(path, "name", "clocks", 7) || gen_phandle(path, "phandle", 4))
+		return 1;
+	if(gen_phandle(path, "#clock-cells", 0))
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/user@4000", root);
+	return gen_node(path, "user", 0x4000, 0x100, "test,user");
+}
+
+static
+const char *name_of(struct dtree_dev_t *dev)
+{
+	return dev == NULL? "(none)" : dtree_dev_name(dev);
+}
+
+static
+void check_lookups(const char *root, unsigned threads, int uring, int props)
+{
+	dtree_ctx_t *ctx = dtree_ctx_new();
+	fail_on_true(ctx == NULL, "Can not create the context");
+
+	dtree_ctx_set_threads(ctx, threads);
+	dtree_ctx_set_uring(ctx, uring);
+	dtree_ctx_set_props(ctx, props);
+
+	int err = threads > 0? dtree_ctx_open_snapshot(ctx, root) : dtree_ctx_open(ctx, root);
+	if(err)
+		dtree_ctx_free(ctx);
+	fail_on_error(err, "Can not open the tree");
+
+	struct dtree_dev_t *dev = dtree_ctx_byphandle(ctx, 1);
+	fail_on_true(strcmp(name_of(dev), "intc@1000"), "phandle 1 is not intc@1000");
+	fail_on_false(dev == NULL || dtree_dev_phandle(dev) == 1, "intc@1000 has another phandle");
+	if(dev != NULL)
+		dtree_ctx_dev_free(ctx, dev);
+
+	dev = dtree_ctx_byphandle(ctx, 2);
+	fail_on_true(strcmp(name_of(dev), "gpio@2000"), "linux,phandle 2 is not gpio@2000");
+	if(dev != NULL)
+		dtree_ctx_dev_free(ctx, dev);
+
+	dev = dtree_ctx_byphandle(ctx, 9);
+	fail_on_false(dev == NULL, "linux,phandle must not override phandle");
+
+	dev = dtree_ctx_byphandle(ctx, 4);
+	fail_on_true(strcmp(name_of(dev), "clocks"), "phandle 4 is not clocks");
+	fail_on_false(dev == NULL || dtree_dev_reg_count(dev) == 0, "clocks has a reg");
+	if(dev != NULL)
+		dtree_ctx_dev_free(ctx, dev);
+
+	dtree_ctx_reset(ctx);
+	dev = dtree_ctx_byname(ctx, "clocks");
+	fail_on_false(dev == NULL, "A node without reg is not walked as a device");
+
+	dtree_ctx_reset(ctx);
+
+	dev = dtree_ctx_byname(ctx, "user");
+	fail_on_false(dev != NULL && dtree_dev_phandle(dev) == 0, "user@4000 has a phandle");
+	if(dev != NULL)
+		dtree_ctx_dev_free(ctx, dev);
+
+	const unsigned char list[] = {0, 0, 0, 3, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0, 1, 0, 0};
+	struct dtree_dev_t *devs[4];
+
+	size_t count = dtree_ctx_byphandle_list(ctx, list, sizeof(list), NULL, devs, 4);
+	fail_on_false(count == 4, "Expected 4 cells (the trailing bytes are ignored)");
+	fail_on_true(strcmp(name_of(devs[0]), "both@3000"), "phandle 3 is not both@3000");
+	fail_on_false(devs[1] == NULL, "phandle 0 must not resolve");
+	fail_on_true(strcmp(name_of(devs[2]), "clocks"), "phandle 4 is not clocks");
+	fail_on_true(strcmp(name_of(devs[3]), "intc@1000"), "phandle 1 is not intc@1000");
+
+	for(size_t i = 0; i < count; ++i) {
+		if(devs[i] != NULL)
+			dtree_ctx_dev_free(ctx, devs[i]);
+	}
+
+	count = dtree_ctx_byphandle_list(ctx, list, sizeof(list), NULL, devs, 1);
+	fail_on_false(count == 4, "Cells are counted beyond max");
+	fail_on_true(strcmp(name_of(devs[0]), "both@3000"), "phandle 3 is not both@3000");
+	dtree_ctx_dev_free(ctx, devs[0]);
+
+	// clocks = <&intc 7>, <&gpio 1 2>, <&clocks>, <0>, <&both 5>
+	const unsigned char clocks[] = {
+		0, 0, 0, 1, 0, 0, 0, 7,
+		0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2,
+		0, 0, 0, 4,
+		0, 0, 0, 0,
+		0, 0, 0, 3, 0, 0, 0, 5,
+	};
+	struct dtree_dev_t *refs[5];
+
+	count = dtree_ctx_byphandle_list(ctx, clocks, sizeof(clocks), "#clock-cells", refs, 5);
+	fail_on_false(count == 5, "Expected 5 entries (both@3000 has no #clock-cells)");
+	fail_on_true(strcmp(name_of(refs[0]), "intc@1000"), "The 1st clock is not intc@1000");
+	fail_on_true(strcmp(name_of(refs[1]), "gpio@2000"), "The 2nd clock is not gpio@2000");
+	fail_on_true(strcmp(name_of(refs[2]), "clocks"), "The 3rd clock is not clocks");
+	fail_on_false(refs[3] == NULL && refs[4] == NULL, "Empty entry and unknown cells must not resolve");
+
+	for(size_t i = 0; i < count && i < 5; ++i) {
+		if(refs[i] != NULL)
+			dtree_ctx_dev_free(ctx, refs[i]);
+	}
+
+	count = dtree_ctx_byphandle_list(ctx, clocks, 20, "#clock-cells", devs, 1);
+	fail_on_false(count == 2, "Specifiers are skipped beyond max");
+	fail_on_true(strcmp(name_of(devs[0]), "intc@1000"), "The 1st clock is not intc@1000");
+	dtree_ctx_dev_free(ctx, devs[0]);
+
+	fail_on_true(dtree_ctx_iserror(ctx), "An error occured during the look ups");
+	dtree_ctx_free(ctx);
+}
+
+/**
+ * Look ups by phandle of a procfs tree take the paths
+ * remembered by the walks instead of walking again.
+ */
+static
+void check_cache(const char *root)
+{
+	dtree_ctx_t *ctx = dtree_ctx_new();
+	fail_on_true(ctx == NULL, "Can not create the context");
+
+	int err = dtree_ctx_open(ctx, root);
+	if(err)
+		dtree_ctx_free(ctx);
+	fail_on_error(err, "Can not open the tree");
+
+	struct dtree_dev_t *dev = NULL;
+	while((dev = dtree_ctx_next(ctx)) != NULL)
+		dtree_ctx_dev_free(ctx, dev);
+
+	// phandle, reg and compatible of both@3000 only
+	unsigned long props = dtree_procfs_prop_count(ctx);
+	dev = dtree_ctx_byphandle(ctx, 3);
+	fail_on_true(strcmp(name_of(dev), "both@3000"), "phandle 3 is not both@3000");
+	fail_on_false(dtree_procfs_prop_count(ctx) - props == 3, "The tree was walked for a known phandle");
+	if(dev != NULL)
+		dtree_ctx_dev_free(ctx, dev);
+
+	// the first miss walks the whole tree, the next ones read nothing
+	dev = dtree_ctx_byphandle(ctx, 7);
+	fail_on_false(dev == NULL, "phandle 7 must not resolve");
+
+	unsigned long readdirs = dtree_procfs_readdir_count(ctx);
+	props = dtree_procfs_prop_count(ctx);
+	dev = dtree_ctx_byphandle(ctx, 8);
+	fail_on_false(dev == NULL, "phandle 8 must not resolve");
+	fail_on_false(dtree_procfs_readdir_count(ctx) == readdirs && dtree_procfs_prop_count(ctx) == props,
+			"The tree was walked again for a missing phandle");
+
+	// the paths are kept by the reset
+	dtree_ctx_reset(ctx);
+	readdirs = dtree_procfs_readdir_count(ctx);
+	props = dtree_procfs_prop_count(ctx);
+	dev = dtree_ctx_byphandle(ctx, 8);
+	fail_on_false(dev == NULL, "phandle 8 must not resolve");
+	fail_on_false(dtree_procfs_readdir_count(ctx) == readdirs && dtree_procfs_prop_count(ctx) == props,
+			"The tree was walked again after the reset");
+
+	dev = dtree_ctx_byphandle(ctx, 3);
+	fail_on_true(strcmp(name_of(dev), "both@3000"), "phandle 3 is not both@3000");
+	fail_on_false(dtree_procfs_prop_count(ctx) - props == 3, "The path was dropped by the reset");
+	if(dev != NULL)
+		dtree_ctx_dev_free(ctx, dev);
+
+	// a path that has gone is walked for again
+	char from[512];
+	char to[512];
+	snprintf(from, sizeof(from), "%s/both@3000", root);
+	snprintf(to, sizeof(to), "%s/both@3100", root);
+	fail_on_true(rename(from, to), "Can not rename both@3000");
+
+	dtree_ctx_reset(ctx);
+	dev = dtree_ctx_byphandle(ctx, 3);
+	fail_on_true(strcmp(name_of(dev), "both@3100"), "phandle 3 is not the moved both@3100");
+	if(dev != NULL)
+		dtree_ctx_dev_free(ctx, dev);
+
+	fail_on_true(rename(to, from), "Can not rename both@3100 back");
+
+	fail_on_true(dtree_ctx_iserror(ctx), "An error occured during the look ups");
+	dtree_ctx_free(ctx);
+}
+
+void test_byphandle(void)
+{
+	test_start();
+
+	char root[] = "/tmp/dtree-phandle-XXXXXX";
+	int err = gen_phandle_tree(root);
+	if(err)
+		gen_remove(root);
+	halt_on_error(err, "Can not create the testing device-tree");
+
+	check_lookups(root, 0, 0, 0);
+	check_lookups(root, 0, 1, 0);
+	check_lookups(root, 1, 0, 0);
+	check_lookups(root, 4, 0, 0);
+	check_lookups(root, 0, 0, 1);
+	check_lookups(root, 4, 0, 1);
+	check_cache(root);
+
+	gen_remove(root);
+
+	test_end();
+}
+
+int main(void)
+{
+	test_byphandle();
+}
@@ -0,0 +1,145 @@
+#define _XOPEN_SOURCE 700
+
+#include "dtree_reg.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define REPEAT 20
+
+/**
+ * Benchmark of the big-endian cell decoding. Converts large
+ * ranges-like (1 and 2 cells per value) and interrupt-map-like
+ * (plain cells) properties by the byte-by-byte loop used before
+ * and by the bulk decoders.
+ *
+ * Usage: dtree_cells_bench [cells]
+ */
+
+static
+unsigned long time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (unsigned long) ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+/**
+ * The loop the library used before dtree_cells_read().
+ */
+static
+uint32_t convert_raw32(const unsigned char *s)
+{
+	return ((uint32_t) s[0] << 24) | ((uint32_t) s[1] << 16)
+	     | ((uint32_t) s[2] << 8)  |  (uint32_t) s[3];
+}
+
+static
+void loop_read(const unsigned char *s, size_t n, unsigned cells, uint64_t *dst)
+{
+	for(size_t i = 0; i < n; ++i) {
+		uint64_t val = 0;
+
+		for(unsigned c = 0; c < cells; ++c)
+			val = (val << 32) | convert_raw32(s + 4 * (i * cells + c));
+
+		dst[i] = val;
+	}
+}
+
+static
+void loop_read32(const unsigned char *s, size_t n, uint32_t *dst)
+{
+	for(size_t i = 0; i < n; ++i)
+		dst[i] = convert_raw32(s + 4 * i);
+}
+
+static volatile uint64_t sink;
+
+static
+unsigned long best_of(void (*run)(const unsigned char *, size_t, unsigned, void *),
+		const unsigned char *s, size_t n, unsigned cells, void *dst)
+{
+	unsigned long best = 0;
+
+	for(int i = 0; i < REPEAT; ++i) {
+		const unsigned long start = time_ns();
+		run(s, n, cells, dst);
+		const unsigned long ns = time_ns() - start;
+
+		sink += ((const unsigned char *) dst)[0];
+		if(best == 0 || ns < best)
+			best = ns;
+	}
+
+	return best;
+}
+
+static
+void run_loop(const unsigned char *s, size_t n, unsigned cells, void *dst)
+{
+	if(cells == 0)
+		loop_read32(s, n, (uint32_t *) dst);
+	else
+		loop_read(s, n, cells, (uint64_t *) dst);
+}
+
+static
+void run_bulk(const unsigned char *s, size_t n, unsigned cells, void *dst)
+{
+	if(cells == 0)
+		dtree_cells_read32(s, n, (uint32_t *) dst);
+	else
+		dtree_cells_read(s, n, cells, (uint64_t *) dst);
+}
+
+int main(int argc, char **argv)
+{
+	const size_t ncells = argc > 1? (size_t) atol(argv[1]) : 1 << 20;
+
+	// misaligned on purpose, properties of procfs and blobs are
+	unsigned char *raw = malloc(4 * ncells + 1);
+	uint64_t *a = malloc(ncells * sizeof(uint64_t));
+	uint64_t *b = malloc(ncells * sizeof(uint64_t));
+	if(raw == NULL || a == NULL || b == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	unsigned char *cells = raw + 1;
+	srand(1);
+	for(size_t i = 0; i < 4 * ncells; ++i)
+		cells[i] = (unsigned char) rand();
+
+	printf("%zu cells, best of %d\n", ncells, REPEAT);
+	printf("layout          loop [ns]  bulk [ns]  speedup\n");
+
+	// 0 stands for plain 32-bit cells (eg. interrupt-map)
+	const unsigned layouts[] = {0, 1, 2, 3};
+	const char *names[] = {"u32 cells", "1-cell values", "2-cell values", "3-cell values"};
+
+	for(int l = 0; l < 4; ++l) {
+		const unsigned c = layouts[l];
+		const size_t n = c == 0? ncells : ncells / c;
+
+		const unsigned long loop = best_of(run_loop, cells, n, c, a);
+		const unsigned long bulk = best_of(run_bulk, cells, n, c, b);
+
+		const size_t bytes = c == 0? n * sizeof(uint32_t) : n * sizeof(uint64_t);
+		if(memcmp(a, b, bytes)) {
+			fprintf(stderr, "Bulk decoder differs for %s\n", names[l]);
+			return 1;
+		}
+
+		printf("%-14s  %9lu  %9lu  %7.2f\n", names[l], loop, bulk, (double) loop / bulk);
+	}
+
+	free(raw);
+	free(a);
+	free(b);
+	return 0;
+}
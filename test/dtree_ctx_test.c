@@ -0,0 +1,143 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "dtree.h"
+#include "test.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#define EXPECT 8 // see dtree_next_test.c
+#define THREADS 4
+
+static
+int ctx_count(dtree_ctx_t *ctx)
+{
+	struct dtree_dev_t *dev = NULL;
+	int count = 0;
+
+	while((dev = dtree_ctx_next(ctx)) != NULL) {
+		count += 1;
+		dtree_ctx_dev_free(ctx, dev);
+	}
+
+	return dtree_ctx_iserror(ctx)? -1 : count;
+}
+
+void test_independent_errors(void)
+{
+	test_start();
+
+	dtree_ctx_t *bad  = dtree_ctx_new();
+	dtree_ctx_t *good = dtree_ctx_new();
+	halt_on_true(bad == NULL || good == NULL, "Can not allocate contexts");
+
+	fail_on_success(dtree_ctx_open(bad, "/xxx/yyy/zzz"), "Successful when passing non-existent dir");
+	fail_on_true(dtree_ctx_open(good, test_tree()), "Can not open testing device-tree");
+
+	fail_on_false(dtree_ctx_iserror(bad), "Error is not indicated by the failed context");
+	fail_on_true(dtree_ctx_iserror(good), "Error of the other context leaked");
+	fail_on_true(dtree_iserror(), "Error of a context leaked into the default one");
+
+	fail_on_false(ctx_count(good) == EXPECT, "Unexpected number of devices");
+
+	dtree_ctx_free(bad);
+	dtree_ctx_free(good);
+	test_end();
+}
+
+void test_interleaved(void)
+{
+	test_start();
+
+	dtree_ctx_t *a = dtree_ctx_new();
+	dtree_ctx_t *b = dtree_ctx_new();
+	halt_on_true(a == NULL || b == NULL, "Can not allocate contexts");
+
+	fail_on_true(dtree_ctx_open(a, test_tree()), "Can not open testing device-tree in a");
+	fail_on_true(dtree_ctx_open_snapshot(b, test_tree()), "Can not open testing device-tree in b");
+
+	struct dtree_dev_t *da = NULL;
+	struct dtree_dev_t *db = NULL;
+	int count = 0;
+
+	while((da = dtree_ctx_next(a)) != NULL) {
+		db = dtree_ctx_next(b);
+		fail_on_true(db == NULL, "Context b ended before a");
+		fail_on_false(!strcmp(dtree_dev_name(da), dtree_dev_name(db)), "Contexts disagree");
+
+		dtree_ctx_dev_free(a, da);
+		dtree_ctx_dev_free(b, db);
+		count += 1;
+	}
+
+	fail_on_false(dtree_ctx_next(b) == NULL, "Context b has more devices than a");
+	fail_on_false(count == EXPECT, "Unexpected number of devices");
+
+	dtree_ctx_reset(b);
+
+	struct dtree_dev_t *dev = dtree_ctx_byname(b, "serial@84000000");
+	fail_on_true(dev == NULL, "Device serial@84000000 not found in b");
+	fail_on_false(dtree_ctx_next(a) == NULL, "Look up in b moved the iterator of a");
+
+	dtree_ctx_free(a);
+	dtree_ctx_free(b);
+	test_end();
+}
+
+static
+void *walk_thread(void *arg)
+{
+	int *result = (int *) arg;
+	*result = -1;
+
+	dtree_ctx_t *ctx = dtree_ctx_new();
+	if(ctx == NULL)
+		return NULL;
+
+	for(int round = 0; round < 16; ++round) {
+		if(dtree_ctx_open(ctx, test_tree()))
+			break;
+
+		*result = ctx_count(ctx);
+		dtree_ctx_close(ctx);
+
+		if(*result != EXPECT)
+			break;
+	}
+
+	dtree_ctx_free(ctx);
+	return NULL;
+}
+
+void test_threads(void)
+{
+	test_start();
+
+	pthread_t thread[THREADS];
+	int result[THREADS];
+
+	for(int i = 0; i < THREADS; ++i)
+		halt_on_true(pthread_create(&thread[i], NULL, walk_thread, &result[i]), "Can not create thread");
+
+	for(int i = 0; i < THREADS; ++i)
+		pthread_join(thread[i], NULL);
+
+	for(int i = 0; i < THREADS; ++i)
+		fail_on_false(result[i] == EXPECT, "A thread has seen unexpected number of devices");
+
+	test_end();
+}
+
+int main(void)
+{
+	int err = dtree_open(test_tree());
+	halt_on_error(err, "Can not open testing device-tree");
+
+	test_independent_errors();
+	test_interleaved();
+	test_threads();
+
+	halt_on_true(dtree_byname("plb") == NULL, "Default context was affected by other contexts");
+	dtree_close();
+	return 0;
+}
@@ -0,0 +1,290 @@
+#define _XOPEN_SOURCE 700
+
+#include "dtree.h"
+#include "dtree_procfs.h"
+#include "test.h"
+#include "test_gen.h"
+
+#include <errno.h>
+#include <string.h>
+
+/**
+ * Creates the tree:
+ *
+ *   on@1000              status "okay"
+ *   off@2000             status "disabled", #address-cells 1
+ *     sub@2100
+ *   cpus                 no reg (not a device)
+ *     cpu@0
+ *   bus                  no reg (not a device)
+ *     deep@3000
+ *       deeper@3100
+ */
+static
+int gen_filter_tree(char *root)
+{
+	char path[512];
+
+	if(mkdtemp(root) == NULL)
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/on@1000", root);
+	if(gen_node(path, "on", 0x1000, 0x100, "test,on") || gen_write(path, "status", "okay", 5))
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/off@2000", root);
+	if(gen_node(path, "off", 0x2000, 0x100, "test,off") || gen_write(path, "status", "disabled", 9))
+		return 1;
+
+	const unsigned char acells[] = {0, 0, 0, 1};
+	if(gen_write(path, "#address-cells", acells, sizeof(acells)))
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/off@2000/sub@2100", root);
+	if(gen_node(path, "sub", 0x2100, 0x10, "test,sub"))
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/cpus", root);
+	if(mkdir(path, 0755) || gen_write(path, "name", "cpus", 5))
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/cpus/cpu@0", root);
+	if(gen_node(path, "cpu", 0, 1, "test,cpu"))
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/bus", root);
+	if(mkdir(path, 0755) || gen_write(path, "name", "bus", 4))
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/bus/deep@3000", root);
+	if(gen_node(path, "deep", 0x3000, 0x100, "test,deep"))
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/bus/deep@3000/deeper@3100", root);
+	return gen_node(path, "deeper", 0x3100, 0x10, "test,deeper");
+}
+
+/**
+ * Names of the devices returned by the walk of the
+ * cursor, in the order of the walk and separated
+ * by a space.
+ */
+static
+void walk_names(dtree_iter_t *it, char *names, size_t len)
+{
+	struct dtree_dev_t *dev = NULL;
+	names[0] = '\0';
+
+	while((dev = dtree_iter_next(it)) != NULL) {
+		if(names[0] != '\0')
+			strncat(names, " ", len - strlen(names) - 1);
+
+		strncat(names, dtree_dev_name(dev), len - strlen(names) - 1);
+		dtree_iter_dev_free(it, dev);
+	}
+}
+
+static
+size_t count_devs(dtree_ctx_t *ctx)
+{
+	struct dtree_dev_t *dev = NULL;
+	size_t count = 0;
+
+	while((dev = dtree_ctx_next(ctx)) != NULL) {
+		count += 1;
+		dtree_ctx_dev_free(ctx, dev);
+	}
+
+	return count;
+}
+
+static
+dtree_ctx_t *open_filtered(const char *root, unsigned threads, const struct dtree_filter_t *f)
+{
+	dtree_ctx_t *ctx = dtree_ctx_new();
+	if(ctx == NULL)
+		return NULL;
+
+	dtree_ctx_set_threads(ctx, threads);
+	dtree_ctx_set_filter(ctx, f);
+
+	int err = threads > 0? dtree_ctx_open_snapshot(ctx, root) : dtree_ctx_open(ctx, root);
+	if(err) {
+		dtree_ctx_free(ctx);
+		return NULL;
+	}
+
+	return ctx;
+}
+
+void test_open_filter(void)
+{
+	test_start();
+
+	char root[] = "/tmp/dtree-filter-XXXXXX";
+	int err = gen_filter_tree(root);
+	if(err)
+		gen_remove(root);
+	halt_on_error(err, "Can not create the testing device-tree");
+
+	const char *skip[] = {"cpus", NULL};
+	const struct dtree_filter_t f = {.skip_disabled = 1, .skip = skip, .max_depth = 2};
+
+	for(unsigned threads = 0; threads < 5; threads += 2) {
+		dtree_ctx_t *ctx = open_filtered(root, threads, NULL);
+		fail_on_true(ctx == NULL, "Can not open the tree");
+		fail_on_false(ctx == NULL || count_devs(ctx) == 6, "Unfiltered tree has 6 devices");
+		if(ctx != NULL)
+			dtree_ctx_free(ctx);
+
+		ctx = open_filtered(root, threads, &f);
+		fail_on_true(ctx == NULL, "Can not open the filtered tree");
+		if(ctx == NULL)
+			continue;
+
+		fail_on_false(count_devs(ctx) == 2, "Only on@1000 and deep@3000 expected");
+
+		if(threads == 0) {
+			// status of on@1000 and off@2000, reg and compatible of on@1000 and
+			// deep@3000, not the bus of off@2000, cpus and deeper@3100 are not
+			// even opened
+			printf("properties read: %lu\n", dtree_procfs_prop_count(ctx));
+			fail_on_false(dtree_procfs_prop_count(ctx) == 6, "A property of a filtered node read");
+		}
+
+		// every look up walks from the beginning
+		const char *gone[] = {"off", "sub", "cpu", "deeper"};
+		for(size_t i = 0; i < 4; ++i) {
+			dtree_ctx_reset(ctx);
+			struct dtree_dev_t *dev = dtree_ctx_byname(ctx, gone[i]);
+			fail_on_false(dev == NULL, "A filtered device was found");
+		}
+
+		dtree_ctx_reset(ctx);
+		struct dtree_dev_t *dev = dtree_ctx_bycompat(ctx, "test,deep");
+		fail_on_true(dev == NULL, "Device 'deep' was not found");
+		if(dev != NULL)
+			dtree_ctx_dev_free(ctx, dev);
+
+		fail_on_true(dtree_ctx_iserror(ctx), "An error occured during the walk");
+		dtree_ctx_free(ctx);
+	}
+
+	gen_remove(root);
+	test_end();
+}
+
+void test_iter_filter(void)
+{
+	test_start();
+
+	char root[] = "/tmp/dtree-filter-XXXXXX";
+	int err = gen_filter_tree(root);
+	if(err)
+		gen_remove(root);
+	halt_on_error(err, "Can not create the testing device-tree");
+
+	dtree_ctx_t *ctx = open_filtered(root, 0, NULL);
+	if(ctx == NULL)
+		gen_remove(root);
+	halt_on_true(ctx == NULL, "Can not open the tree");
+
+	dtree_iter_t *it = dtree_iter_create(ctx);
+	dtree_iter_t *all = dtree_iter_create(ctx);
+	halt_on_true(it == NULL || all == NULL, "Can not create the iterators");
+
+	const char *skip[] = {"bus", NULL};
+	const struct dtree_filter_t f = {.skip_disabled = 1, .skip = skip};
+	fail_on_true(dtree_iter_set_filter(it, &f), "Can not set the filter of the iterator");
+
+	char names[256];
+	walk_names(it, names, sizeof(names));
+	fail_on_false(strstr(names, "on@1000") != NULL && strstr(names, "cpu@0") != NULL,
+			"on@1000 and cpu@0 expected");
+	fail_on_true(strstr(names, "off") != NULL || strstr(names, "sub") != NULL
+			|| strstr(names, "deep") != NULL, "A filtered device was returned");
+
+	// the other iterator is not affected
+	walk_names(all, names, sizeof(names));
+	fail_on_false(strstr(names, "sub@2100") != NULL && strstr(names, "deeper@3100") != NULL,
+			"The unfiltered iterator lost devices");
+
+	const struct dtree_filter_t depth = {.max_depth = 1};
+	fail_on_true(dtree_iter_set_filter(it, &depth), "Can not set the depth limit");
+	fail_on_true(dtree_iter_reset(it), "Can not reset the iterator");
+	walk_names(it, names, sizeof(names));
+	fail_on_true(strcmp(names, "on@1000 off@2000") && strcmp(names, "off@2000 on@1000"),
+			"Only the devices at the first level expected");
+
+	fail_on_true(dtree_iter_set_filter(it, NULL), "Can not remove the filter");
+	fail_on_true(dtree_iter_reset(it), "Can not reset the iterator");
+	walk_names(it, names, sizeof(names));
+	fail_on_false(strstr(names, "deeper@3100") != NULL, "The whole tree expected without a filter");
+
+	dtree_iter_destroy(all);
+	dtree_iter_destroy(it);
+	dtree_ctx_free(ctx);
+
+	// a snapshot is filtered at open only
+	ctx = open_filtered(root, 1, NULL);
+	fail_on_true(ctx == NULL, "Can not open the snapshot");
+
+	if(ctx != NULL) {
+		it = dtree_iter_create(ctx);
+		fail_on_true(it == NULL, "Can not create the iterator");
+
+		if(it != NULL) {
+			errno = 0;
+			fail_on_false(dtree_iter_set_filter(it, &f) == -1 && errno == ENOTSUP,
+					"Snapshot iterators can not be filtered");
+			dtree_iter_destroy(it);
+		}
+
+		dtree_ctx_free(ctx);
+	}
+
+	gen_remove(root);
+	test_end();
+}
+
+void test_testing_tree(void)
+{
+	test_start();
+
+	const char *skip[] = {"plb", NULL};
+	const struct dtree_filter_t f = {.skip = skip};
+
+	dtree_ctx_t *ctx = open_filtered(test_tree(), 0, &f);
+	halt_on_true(ctx == NULL, "Can not open testing device-tree");
+
+	struct dtree_dev_t *dev = dtree_ctx_byname(ctx, "serial@84000000");
+	fail_on_false(dev == NULL, "Device of the skipped plb was found");
+
+	dtree_ctx_reset(ctx);
+	dev = dtree_ctx_byname(ctx, "memory");
+	fail_on_true(dev == NULL, "Device 'memory' was not found");
+	if(dev != NULL)
+		dtree_ctx_dev_free(ctx, dev);
+
+	dtree_ctx_free(ctx);
+
+	const struct dtree_filter_t depth = {.max_depth = 1};
+	ctx = open_filtered(test_tree(), 0, &depth);
+	halt_on_true(ctx == NULL, "Can not open testing device-tree");
+
+	dev = dtree_ctx_byname(ctx, "timer");
+	fail_on_false(dev == NULL, "Device below the first level was found");
+
+	dtree_ctx_reset(ctx);
+	fail_on_false(count_devs(ctx) >= 1, "Device 'memory' expected");
+
+	dtree_ctx_free(ctx);
+	test_end();
+}
+
+int main(void)
+{
+	test_open_filter();
+	test_iter_filter();
+	test_testing_tree();
+}
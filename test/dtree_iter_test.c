@@ -0,0 +1,204 @@
+#include "dtree.h"
+#include "dtree_procfs.h"
+#include "test.h"
+
+#include <string.h>
+#include <sys/stat.h>
+
+#define EXPECT 8 // see dtree_next_test.c
+#define MAXDEV 16
+#define NAMELEN 64
+
+/**
+ * Collects names of the remaining devices of the iterator.
+ * Returns the number of devices.
+ */
+static
+int iter_names(dtree_iter_t *it, char names[][NAMELEN], int max)
+{
+	struct dtree_dev_t *dev = NULL;
+	int count = 0;
+
+	while((dev = dtree_iter_next(it)) != NULL) {
+		if(count < max)
+			snprintf(names[count], NAMELEN, "%s", dtree_dev_name(dev));
+
+		count += 1;
+		dtree_iter_dev_free(it, dev);
+	}
+
+	return count;
+}
+
+static
+int is_procfs(void)
+{
+	struct stat st;
+	return !stat(test_tree(), &st) && S_ISDIR(st.st_mode);
+}
+
+void test_not_opened(void)
+{
+	test_start();
+
+	dtree_iter_t *it = dtree_iter_create(NULL);
+	fail_on_false(it == NULL, "Iterator created over a closed context");
+	fail_on_false(dtree_iserror(), "Error is not indicated");
+
+	test_end();
+}
+
+void test_clone_midwalk(void)
+{
+	test_start();
+
+	char rest[MAXDEV][NAMELEN];
+	char crest[MAXDEV][NAMELEN];
+	const int skip = 3;
+
+	dtree_iter_t *it = dtree_iter_create(NULL);
+	fail_on_true(it == NULL, "Can not create iterator");
+
+	for(int i = 0; i < skip; ++i) {
+		struct dtree_dev_t *dev = dtree_iter_next(it);
+		fail_on_true(dev == NULL, "Iterator has finished too early");
+		dtree_iter_dev_free(it, dev);
+	}
+
+	dtree_iter_t *clone = dtree_iter_clone(it);
+	fail_on_true(clone == NULL, "Can not clone iterator");
+
+	int count  = iter_names(it, rest, MAXDEV);
+	int ccount = iter_names(clone, crest, MAXDEV);
+
+	fail_on_false(count == EXPECT - skip, "Unexpected number of remaining devices");
+	fail_on_false(ccount == count, "Clone returned another number of devices");
+
+	for(int i = 0; i < count; ++i) {
+		printf("DEV '%s' / '%s'\n", rest[i], crest[i]);
+		fail_on_true(strcmp(rest[i], crest[i]), "Clone returned another device");
+	}
+
+	dtree_iter_destroy(clone);
+	dtree_iter_destroy(it);
+	fail_on_true(dtree_iserror(), "An error occured during iterating");
+
+	test_end();
+}
+
+void test_nested(void)
+{
+	test_start();
+
+	struct dtree_dev_t *dev = NULL;
+	int count = 0;
+	int serials = 0;
+
+	dtree_reset();
+
+	while((dev = dtree_next()) != NULL) {
+		dtree_iter_t *inner = dtree_iter_create(NULL);
+		fail_on_true(inner == NULL, "Can not create inner iterator");
+
+		struct dtree_dev_t *serial = NULL;
+		while((serial = dtree_iter_byname(inner, "serial")) != NULL) {
+			serials += 1;
+			dtree_iter_dev_free(inner, serial);
+		}
+
+		// the inner one is positioned independently
+		serial = dtree_iter_bycompat(inner, "xlnx,xps-uartlite-1.00.a");
+		fail_on_false(serial == NULL, "Compatible device found behind the last serial");
+
+		dtree_iter_destroy(inner);
+		dtree_dev_free(dev);
+		count += 1;
+	}
+
+	fail_on_true(dtree_iserror(), "An error occured during iterating");
+	fail_on_false(count == EXPECT, "Inner iterators disturbed the shared one");
+	fail_on_false(serials == 2 * EXPECT, "Expected two serial devices for every device");
+
+	test_end();
+}
+
+/**
+ * Walks the tree by two iterators advanced in turns, the second
+ * being a clone of the first one. Directories are shared so the
+ * number of readdir calls is the same as for a single walk.
+ */
+void test_shared_dirs(void)
+{
+	test_start();
+
+	if(!is_procfs()) {
+		test_warn("Not a procfs tree, skipping");
+		test_end();
+		return;
+	}
+
+	dtree_ctx_t *ctx = dtree_ctx_new();
+	halt_on_true(ctx == NULL, "Can not allocate context");
+	fail_on_true(dtree_ctx_open(ctx, test_tree()), "Can not open testing device-tree");
+
+	struct dtree_dev_t *dev = NULL;
+	while((dev = dtree_ctx_next(ctx)) != NULL)
+		dtree_ctx_dev_free(ctx, dev);
+
+	const unsigned long single = dtree_procfs_readdir_count(ctx);
+	dtree_ctx_close(ctx);
+	fail_on_true(dtree_ctx_open(ctx, test_tree()), "Can not reopen testing device-tree");
+
+	dtree_iter_t *it = dtree_iter_create(ctx);
+	fail_on_true(it == NULL, "Can not create iterator");
+
+	dev = dtree_iter_next(it);
+	fail_on_true(dev == NULL, "No device found");
+	dtree_iter_dev_free(it, dev);
+
+	dtree_iter_t *clone = dtree_iter_clone(it);
+	fail_on_true(clone == NULL, "Can not clone iterator");
+
+	int count = 1;
+
+	for(;;) {
+		struct dtree_dev_t *a = dtree_iter_next(it);
+		struct dtree_dev_t *b = dtree_iter_next(clone);
+
+		if(a == NULL || b == NULL) {
+			fail_on_false(a == b, "One of the iterators has finished too early");
+			break;
+		}
+
+		fail_on_true(strcmp(dtree_dev_name(a), dtree_dev_name(b)), "Clone returned another device");
+		count += 1;
+		dtree_iter_dev_free(it, a);
+		dtree_iter_dev_free(clone, b);
+	}
+
+	const unsigned long shared = dtree_procfs_readdir_count(ctx);
+	printf("readdir calls: single walk: %lu, two walks: %lu\n", single, shared);
+
+	fail_on_false(count == EXPECT, "Unexpected number of devices");
+	fail_on_false(shared == single, "Directories are not shared by iterators");
+
+	dtree_iter_destroy(clone);
+	dtree_iter_destroy(it);
+	dtree_ctx_free(ctx);
+
+	test_end();
+}
+
+int main(void)
+{
+	test_not_opened();
+
+	int err = dtree_open(test_tree());
+	halt_on_error(err, "Can not open testing device-tree");
+
+	test_clone_midwalk();
+	test_nested();
+	test_shared_dirs();
+
+	dtree_close();
+}
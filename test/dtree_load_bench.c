@@ -0,0 +1,87 @@
+#define _XOPEN_SOURCE 700
+
+#include "dtree.h"
+#include "test_gen.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define REPEAT 5
+
+/**
+ * Benchmark of the parallel snapshot loader. Generates a synthetic
+ * tree (or uses the given one) and loads it by 1..N threads.
+ *
+ * Usage: dtree_load_bench [max-threads [buses devices | tree]]
+ */
+
+static
+unsigned long load_best(const char *root, unsigned threads, unsigned long *devices)
+{
+	unsigned long best = 0;
+
+	for(int i = 0; i < REPEAT; ++i) {
+		dtree_ctx_t *ctx = dtree_ctx_new();
+		if(ctx == NULL)
+			return 0;
+
+		dtree_ctx_set_threads(ctx, threads);
+		if(dtree_ctx_open_snapshot(ctx, root)) {
+			fprintf(stderr, "Can not open %s: %s\n", root, dtree_ctx_errstr(ctx));
+			dtree_ctx_free(ctx);
+			return 0;
+		}
+
+		struct dtree_stats_t stats;
+		dtree_ctx_stats(ctx, &stats);
+		dtree_ctx_free(ctx);
+
+		*devices = stats.devices;
+		if(best == 0 || stats.load_us < best)
+			best = stats.load_us;
+	}
+
+	return best;
+}
+
+int main(int argc, char **argv)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned max = argc > 1? (unsigned) atoi(argv[1]) : (unsigned) (cpus < 4? 4 : cpus);
+	int buses   = argc > 3? atoi(argv[2]) : 16;
+	int devices = argc > 3? atoi(argv[3]) : 64;
+
+	char root[] = "/tmp/dtree-bench-XXXXXX";
+	const char *tree = root;
+
+	if(argc == 3) {
+		tree = argv[2];
+	}
+	else if(gen_tree(root, buses, devices)) {
+		fprintf(stderr, "Can not create the synthetic device-tree\n");
+		gen_remove(root);
+		return 1;
+	}
+
+	printf("%ld online CPUs, best of %d loads\n", cpus, REPEAT);
+	printf("threads  devices  load [us]  speedup\n");
+
+	unsigned long base = 0;
+	for(unsigned threads = 1; threads <= max; ++threads) {
+		unsigned long devs = 0;
+		unsigned long us = load_best(tree, threads, &devs);
+		if(us == 0)
+			break;
+
+		if(threads == 1)
+			base = us;
+
+		printf("%7u  %7lu  %9lu  %7.2f\n", threads, devs, us, (double) base / us);
+	}
+
+	if(tree == root)
+		gen_remove(root);
+
+	return 0;
+}
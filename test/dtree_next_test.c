@@ -1,5 +1,6 @@
 #include "dtree.h"
 #include "test.h"
+#include "test_alloc.h"
 
 void test_all_dev(const int expect)
 {
@@ -7,19 +8,23 @@ void test_all_dev(const int expect)
 
 	struct dtree_dev_t *curr = NULL;
 	int count = 0;
+	unsigned long allocs = test_alloc_count();
 
 	while((curr = dtree_next())) {
 		const char *name  = dtree_dev_name(curr);
 		dtree_addr_t base = dtree_dev_base(curr);
 		dtree_addr_t high = dtree_dev_high(curr);
 
-		printf("DEV '%s' at 0x%08X .. 0x%08X\n", name, base, high);
+		printf("DEV '%s' at 0x%08llX .. 0x%08llX\n", name,
+				(unsigned long long) base, (unsigned long long) high);
 		print_compat(curr);
 
 		dtree_dev_free(curr);
 		count += 1;
 	}
 
+	printf("Allocations: %lu for %d devices\n", test_alloc_count() - allocs, count);
+
 	fail_on_true(dtree_iserror(), "An error occured during traversing the device tree");
 	fail_on_true(count < expect, "Some device were not traversed");
 	fail_on_true(count > expect, "More devices were traversed then expected");
@@ -30,7 +35,7 @@ void test_all_dev(const int expect)
 int main(void)
 {
 	const int expect = 8; // magic number, see device-tree/ in current dir, number of name@addr dirs
-	int err = dtree_open("device-tree");
+	int err = dtree_open(test_tree());
 	halt_on_error(err, "Can not open testing device-tree");
 
 	test_all_dev(expect);
@@ -50,7 +50,7 @@ void test_pass_mostly_valid(void)
 void test_open_test_dtree(void)
 {
 	test_start();
-	int err = dtree_open("device-tree");
+	int err = dtree_open(test_tree());
 	fail_on_error(err, "Can not open testing device-tree");
 	warn_on_true(dtree_iserror(), "Error state is set, but should not be");
 	dtree_close();
@@ -67,7 +67,7 @@ void test_clear_error(void)
 	fail_on_success(err, "Open of NULL was successful");
 	fail_on_false(dtree_iserror(), "No error is indicated");
 
-	err = dtree_open("device-tree");
+	err = dtree_open(test_tree());
 	fail_on_error(err, "Can not open testing device-tree");
 	fail_on_true(dtree_iserror(), "The error was not cleared");
 
@@ -0,0 +1,142 @@
+#define _XOPEN_SOURCE 700
+
+#include "dtree.h"
+#include "test.h"
+#include "test_gen.h"
+
+#include <string.h>
+
+#define MAXDEV 4096
+
+/**
+ * Device copied out of a context.
+ */
+struct devcopy {
+	char name[64];
+	dtree_addr_t base;
+	dtree_addr_t high;
+	char compat[128];
+};
+
+/**
+ * Loads the tree as a snapshot by the given number of threads
+ * and copies all devices in the order of iteration.
+ * Returns the number of devices or -1 on error.
+ */
+static
+int load_copy(const char *root, unsigned threads, struct devcopy *devs, int max)
+{
+	dtree_ctx_t *ctx = dtree_ctx_new();
+	if(ctx == NULL)
+		return -1;
+
+	dtree_ctx_set_threads(ctx, threads);
+	if(dtree_ctx_open_snapshot(ctx, root)) {
+		dtree_ctx_free(ctx);
+		return -1;
+	}
+
+	struct dtree_dev_t *dev = NULL;
+	int count = 0;
+
+	while((dev = dtree_ctx_next(ctx)) != NULL && count < max) {
+		struct devcopy *c = &devs[count++];
+		const char **compat = dtree_dev_compat(dev);
+
+		snprintf(c->name, sizeof(c->name), "%s", dtree_dev_name(dev));
+		c->base = dtree_dev_base(dev);
+		c->high = dtree_dev_high(dev);
+		c->compat[0] = '\0';
+
+		for(int i = 0; compat[i] != NULL; ++i) {
+			strncat(c->compat, compat[i], sizeof(c->compat) - strlen(c->compat) - 2);
+			strcat(c->compat, ";");
+		}
+
+		dtree_ctx_dev_free(ctx, dev);
+	}
+
+	if(dtree_ctx_iserror(ctx))
+		count = -1;
+
+	dtree_ctx_free(ctx);
+	return count;
+}
+
+static
+int same_devices(const struct devcopy *a, const struct devcopy *b, int count)
+{
+	for(int i = 0; i < count; ++i) {
+		if(strcmp(a[i].name, b[i].name) || strcmp(a[i].compat, b[i].compat))
+			return 0;
+		if(a[i].base != b[i].base || a[i].high != b[i].high)
+			return 0;
+	}
+
+	return 1;
+}
+
+static struct devcopy seq[MAXDEV];
+static struct devcopy par[MAXDEV];
+
+static
+void compare_loads(const char *root, int expect)
+{
+	test_start();
+
+	const int count = load_copy(root, 1, seq, MAXDEV);
+	fail_on_false(count == expect, "Unexpected number of devices loaded sequentially");
+
+	for(unsigned threads = 2; threads <= 8; threads *= 2) {
+		const int pcount = load_copy(root, threads, par, MAXDEV);
+		printf("%u threads: %d devices\n", threads, pcount);
+
+		fail_on_false(pcount == count, "Parallel load returned another number of devices");
+		fail_on_false(same_devices(seq, par, count), "Parallel load changed devices or their order");
+	}
+
+	test_end();
+}
+
+void test_testing_tree(void)
+{
+	compare_loads(test_tree(), 8); // see dtree_next_test.c
+}
+
+void test_generated_tree(void)
+{
+	const int buses = 6;
+	const int devices = 40;
+	char root[] = "/tmp/dtree-parallel-XXXXXX";
+
+	int err = gen_tree(root, buses, devices);
+	if(err)
+		gen_remove(root);
+	halt_on_error(err, "Can not create the synthetic device-tree");
+
+	compare_loads(root, buses * (1 + devices + devices / 4));
+	gen_remove(root);
+}
+
+void test_errors(void)
+{
+	test_start();
+
+	dtree_ctx_t *ctx = dtree_ctx_new();
+	halt_on_true(ctx == NULL, "Can not allocate context");
+
+	dtree_ctx_set_threads(ctx, 4);
+	fail_on_success(dtree_ctx_open_snapshot(ctx, "/xxx/yyy/zzz"),
+			"Successful when passing non-existent dir");
+	fail_on_false(dtree_ctx_iserror(ctx), "Error is not indicated");
+
+	dtree_ctx_free(ctx);
+	test_end();
+}
+
+int main(void)
+{
+	test_testing_tree();
+	test_generated_tree();
+	test_errors();
+}
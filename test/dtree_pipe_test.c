@@ -0,0 +1,186 @@
+#define _XOPEN_SOURCE 700
+
+#include "dtree.h"
+#include "test.h"
+#include "test_gen.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAXDEV 1024
+#define NAMELEN 64
+
+/**
+ * Walks the tree by a context with the given pipeline depth
+ * (0 synchronously), copies names of devices and the error
+ * string. Returns the number of devices or -1 when it can
+ * not be opened.
+ */
+static
+int walk_copy(const char *root, unsigned depth, char names[][NAMELEN], int max,
+		char *errstr, size_t errlen)
+{
+	dtree_ctx_t *ctx = dtree_ctx_new();
+	if(ctx == NULL)
+		return -1;
+
+	dtree_ctx_set_pipeline(ctx, depth);
+	if(dtree_ctx_open(ctx, root)) {
+		dtree_ctx_free(ctx);
+		return -1;
+	}
+
+	struct dtree_dev_t *dev = NULL;
+	int count = 0;
+
+	while((dev = dtree_ctx_next(ctx)) != NULL) {
+		if(count < max)
+			snprintf(names[count], NAMELEN, "%s", dtree_dev_name(dev));
+
+		count += 1;
+		dtree_ctx_dev_free(ctx, dev);
+	}
+
+	snprintf(errstr, errlen, "%s", dtree_ctx_iserror(ctx)? dtree_ctx_errstr(ctx) : "");
+	dtree_ctx_free(ctx);
+	return count;
+}
+
+static char seq[MAXDEV][NAMELEN];
+static char pipe_names[MAXDEV][NAMELEN];
+
+static
+void compare_walks(const char *root, int expect, int error)
+{
+	char seq_err[128];
+	char pipe_err[128];
+
+	const int count = walk_copy(root, 0, seq, MAXDEV, seq_err, sizeof(seq_err));
+	fail_on_false(count == expect, "Unexpected number of devices walked synchronously");
+	fail_on_false(error == (seq_err[0] != '\0'), "Unexpected error state of the synchronous walk");
+
+	const unsigned depths[] = {1, 2, 16, 1024};
+
+	for(size_t d = 0; d < sizeof(depths) / sizeof(depths[0]); ++d) {
+		const int pcount = walk_copy(root, depths[d], pipe_names, MAXDEV, pipe_err, sizeof(pipe_err));
+		printf("depth %u: %d devices, error '%s'\n", depths[d], pcount, pipe_err);
+
+		fail_on_false(pcount == count, "Pipelined walk returned another number of devices");
+		fail_on_true(strcmp(seq_err, pipe_err), "Pipelined walk reported another error");
+
+		for(int i = 0; i < count && i < MAXDEV; ++i)
+			fail_on_true(strcmp(seq[i], pipe_names[i]), "Pipelined walk changed the order");
+	}
+}
+
+void test_same_order(void)
+{
+	test_start();
+
+	compare_walks(test_tree(), 8, 0); // see dtree_next_test.c
+
+	char root[] = "/tmp/dtree-pipe-XXXXXX";
+	int err = gen_tree(root, 4, 32);
+	if(err)
+		gen_remove(root);
+	halt_on_error(err, "Can not create the synthetic device-tree");
+
+	compare_walks(root, 4 * (1 + 32 + 8), 0);
+	gen_remove(root);
+
+	test_end();
+}
+
+/**
+ * A dangling symlink in the middle of the tree breaks the walk
+ * at the same device in both modes.
+ */
+void test_same_error(void)
+{
+	test_start();
+
+	if(access(test_tree(), X_OK) || strstr(test_tree(), ".dtb") != NULL) {
+		test_warn("Not a procfs tree, skipping");
+		test_end();
+		return;
+	}
+
+	char root[] = "/tmp/dtree-pipe-XXXXXX";
+	char link[512];
+
+	int err = gen_tree(root, 4, 8);
+	if(!err) {
+		snprintf(link, sizeof(link), "%s/bus@30000000/dev@30030000/broken", root);
+		err = symlink("/nonexistent/dtree/entry", link);
+	}
+	if(err)
+		gen_remove(root);
+	halt_on_error(err, "Can not create the synthetic device-tree");
+
+	char errstr[128];
+	const int count = walk_copy(root, 0, seq, MAXDEV, errstr, sizeof(errstr));
+	fail_on_false(count >= 0 && count < 4 * (1 + 8 + 2), "The broken entry has not stopped the walk");
+
+	compare_walks(root, count, 1);
+	gen_remove(root);
+
+	test_end();
+}
+
+void test_reset_and_lookup(void)
+{
+	test_start();
+
+	dtree_set_pipeline(4);
+	int err = dtree_open(test_tree());
+	halt_on_error(err, "Can not open testing device-tree pipelined");
+
+	for(int i = 0; i < 3; ++i) {
+		struct dtree_dev_t *dev = dtree_next();
+		fail_on_true(dev == NULL, "Walk has finished too early");
+		dtree_dev_free(dev);
+	}
+
+	fail_on_true(dtree_reset(), "Reset has failed");
+
+	int count = 0;
+	struct dtree_dev_t *dev = NULL;
+	while((dev = dtree_byname("serial")) != NULL) {
+		count += 1;
+		dtree_dev_free(dev);
+	}
+
+	fail_on_false(count == 2, "Expected two 'serial' devices");
+
+	dtree_reset();
+	dev = dtree_bycompat("xlnx,xps-uartlite-1.00.a");
+	fail_on_true(dev == NULL, "Compatible device not found");
+	dtree_dev_free(dev);
+
+	// keep the rest prepared in the queue, close drops it
+	dev = dtree_next();
+	fail_on_true(dev == NULL, "Walk has finished too early");
+
+	// walks a temporary iterator
+	struct dtree_dev_t *ref = dtree_byphandle(1);
+	fail_on_false(ref == NULL, "Phandle looked up in the pipelined mode");
+	fail_on_true(strcmp(dtree_errstr(), strerror(EBUSY)), "EBUSY is not indicated");
+
+	dtree_iter_t *it = dtree_iter_create(NULL);
+	fail_on_false(it == NULL, "Another iterator created in the pipelined mode");
+	fail_on_false(dtree_iserror(), "Error is not indicated");
+
+	dtree_dev_free(dev);
+	dtree_close();
+	dtree_set_pipeline(0);
+
+	test_end();
+}
+
+int main(void)
+{
+	test_same_order();
+	test_same_error();
+	test_reset_and_lookup();
+}
@@ -0,0 +1,203 @@
+#define _XOPEN_SOURCE 700
+
+#include "dtree.h"
+#include "dtree_procfs.h"
+#include "test.h"
+#include "test_gen.h"
+
+#include <string.h>
+
+/**
+ * Opens the tree (as a snapshot loaded by the given number
+ * of threads when threads > 0) with or without the property
+ * table. Returns NULL on error.
+ */
+static
+dtree_ctx_t *open_tree(const char *root, unsigned threads, int uring, int props)
+{
+	dtree_ctx_t *ctx = dtree_ctx_new();
+	if(ctx == NULL)
+		return NULL;
+
+	dtree_ctx_set_threads(ctx, threads);
+	dtree_ctx_set_uring(ctx, uring);
+	dtree_ctx_set_props(ctx, props);
+
+	int err = threads > 0? dtree_ctx_open_snapshot(ctx, root) : dtree_ctx_open(ctx, root);
+	if(err) {
+		dtree_ctx_free(ctx);
+		return NULL;
+	}
+
+	return ctx;
+}
+
+void test_serial_props(void)
+{
+	test_start();
+
+	for(unsigned threads = 0; threads < 2; ++threads) {
+		dtree_ctx_t *ctx = open_tree(test_tree(), threads, 0, 1);
+		halt_on_true(ctx == NULL, "Can not open testing device-tree");
+
+		struct dtree_dev_t *dev = dtree_ctx_byname(ctx, "serial@84000000");
+		halt_on_true(dev == NULL, "Device 'serial@84000000' was not found");
+
+		size_t len = 0;
+		const void *reg = dtree_dev_prop(dev, "reg", &len);
+		fail_on_false(reg != NULL && len == 8, "reg of two cells expected");
+		fail_on_false(dtree_dev_prop(dev, "missing", &len) == NULL, "Missing property was found");
+
+		uint32_t cells[4] = {0, 0, 0, 0};
+		fail_on_false(dtree_dev_prop_cells(dev, "reg", cells, 4) == 2, "reg is not two cells");
+		fail_on_false(cells[0] == 0x84000000 && cells[1] == 0x10000, "Unexpected cells of reg");
+		fail_on_false(cells[2] == 0, "Cells beyond the property written");
+
+		uint32_t u32 = 7;
+		fail_on_success(dtree_dev_prop_u32(dev, "reg", &u32), "reg is not a single cell");
+		fail_on_false(u32 == 7, "Value changed on failure");
+
+		uint64_t u64 = 0;
+		fail_on_true(dtree_dev_prop_u64(dev, "reg", &u64), "reg of two cells is a u64");
+		fail_on_false(u64 == 0x8400000000010000ULL, "Unexpected u64 of reg");
+
+		const char *strs[2];
+		const size_t n = dtree_dev_prop_strings(dev, "compatible", strs, 1);
+		fail_on_false(n == 2, "compatible has two strings");
+		fail_on_true(strcmp(strs[0], "xlnx,xps-uartlite-1.01.a"), "Unexpected first string");
+
+		int found = 0;
+		for(size_t i = 0; i < dtree_dev_prop_count(dev); ++i) {
+			const struct dtree_prop_t *p = dtree_dev_prop_at(dev, i);
+			if(!strcmp(p->name, "compatible"))
+				found += 1;
+		}
+
+		fail_on_false(found == 1, "compatible is not in the table once");
+		fail_on_false(dtree_dev_prop_at(dev, dtree_dev_prop_count(dev)) == NULL,
+				"Property behind the last one");
+
+		dtree_ctx_dev_free(ctx, dev);
+		dtree_ctx_free(ctx);
+	}
+
+	test_end();
+}
+
+void test_props_disabled(void)
+{
+	test_start();
+
+	dtree_ctx_t *ctx = open_tree(test_tree(), 0, 0, 0);
+	halt_on_true(ctx == NULL, "Can not open testing device-tree");
+
+	struct dtree_dev_t *dev = NULL;
+	while((dev = dtree_ctx_next(ctx)) != NULL) {
+		fail_on_false(dtree_dev_prop_count(dev) == 0, "Properties of a device without the table");
+		fail_on_false(dtree_dev_prop(dev, "reg", NULL) == NULL, "reg found without the table");
+		dtree_ctx_dev_free(ctx, dev);
+	}
+
+	dtree_ctx_free(ctx);
+	test_end();
+}
+
+static
+int gen_prop_tree(char *root, char *path, size_t len)
+{
+	const unsigned char freq[] = {0x05, 0xf5, 0xe1, 0x00};
+	const unsigned char tb[] = {0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02};
+	const unsigned char irq[] = {0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 3, 0xff};
+	const char names[] = "apb\0ahb\0tail";
+
+	if(mkdtemp(root) == NULL)
+		return 1;
+
+	snprintf(path, len, "%s/full@1000", root);
+	if(gen_node(path, "full", 0x1000, 0x100, "test,full"))
+		return 1;
+
+	if(gen_write(path, "status", "okay", 5) || gen_write(path, "clock-frequency", freq, sizeof(freq)))
+		return 1;
+	if(gen_write(path, "timebase", tb, sizeof(tb)) || gen_write(path, "interrupts", irq, sizeof(irq)))
+		return 1;
+
+	// without the terminating '\0'
+	return gen_write(path, "clock-names", names, sizeof(names) - 1);
+}
+
+static
+void check_full(const char *root, unsigned threads, int uring)
+{
+	dtree_ctx_t *ctx = open_tree(root, threads, uring, 1);
+	fail_on_true(ctx == NULL, "Can not open the tree");
+
+	struct dtree_dev_t *dev = dtree_ctx_byname(ctx, "full");
+	if(dev == NULL)
+		dtree_ctx_free(ctx);
+	fail_on_true(dev == NULL, "Device 'full' was not found");
+
+	// name, compatible, reg and the five above
+	fail_on_false(dtree_dev_prop_count(dev) == 8, "Unexpected number of properties");
+
+	if(threads == 0) {
+		printf("properties read: %lu\n", dtree_procfs_prop_count(ctx));
+		fail_on_false(dtree_procfs_prop_count(ctx) == 8, "A property read twice");
+	}
+
+	size_t len = 0;
+	const char *status = dtree_dev_prop(dev, "status", &len);
+	fail_on_false(status != NULL && len == 5 && !strcmp(status, "okay"), "status is not okay");
+
+	uint32_t u32 = 0;
+	fail_on_true(dtree_dev_prop_u32(dev, "clock-frequency", &u32), "clock-frequency is a cell");
+	fail_on_false(u32 == 100000000, "Unexpected clock-frequency");
+
+	uint64_t u64 = 0;
+	fail_on_true(dtree_dev_prop_u64(dev, "clock-frequency", &u64), "A single cell is a u64 too");
+	fail_on_false(u64 == 100000000, "Unexpected u64 of a single cell");
+	fail_on_true(dtree_dev_prop_u64(dev, "timebase", &u64), "timebase is a u64");
+	fail_on_false(u64 == 0x100000002ULL, "Unexpected timebase");
+	fail_on_success(dtree_dev_prop_u32(dev, "timebase", &u32), "timebase is not a u32");
+
+	uint32_t irq[8];
+	fail_on_false(dtree_dev_prop_cells(dev, "interrupts", irq, 8) == 3, "Partial cell counted");
+	fail_on_false(irq[0] == 1 && irq[1] == 2 && irq[2] == 3, "Unexpected interrupts");
+	fail_on_false(dtree_dev_prop_cells(dev, "missing", irq, 8) == 0, "Cells of a missing property");
+
+	const char *names[4];
+	fail_on_false(dtree_dev_prop_strings(dev, "clock-names", names, 4) == 2, "Unterminated tail counted");
+	fail_on_true(strcmp(names[0], "apb") || strcmp(names[1], "ahb"), "Unexpected clock-names");
+
+	dtree_ctx_dev_free(ctx, dev);
+	dtree_ctx_free(ctx);
+}
+
+void test_typed_props(void)
+{
+	test_start();
+
+	char root[] = "/tmp/dtree-prop-XXXXXX";
+	char path[512];
+
+	int err = gen_prop_tree(root, path, sizeof(path));
+	if(err)
+		gen_remove(root);
+	halt_on_error(err, "Can not create the testing device-tree");
+
+	check_full(root, 0, 0);
+	check_full(root, 0, 1);
+	check_full(root, 1, 0);
+	check_full(root, 4, 0);
+
+	gen_remove(root);
+
+	test_end();
+}
+
+int main(void)
+{
+	test_serial_props();
+	test_props_disabled();
+	test_typed_props();
+}
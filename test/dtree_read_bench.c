@@ -0,0 +1,111 @@
+#define _XOPEN_SOURCE 700
+
+#include "dtree.h"
+#include "test_gen.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define REPEAT 5
+
+/**
+ * Benchmark of the property reads of the streaming walk. Generates
+ * a synthetic tree (on tmpfs in /dev/shm when possible, or uses
+ * the given one) and walks it by the plain syscalls and by the
+ * batched io_uring reads.
+ *
+ * Usage: dtree_read_bench [buses devices | tree]
+ */
+
+static
+unsigned long time_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (unsigned long) ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+}
+
+static
+unsigned long walk_best(const char *root, int uring, unsigned long *devices)
+{
+	unsigned long best = 0;
+
+	for(int i = 0; i < REPEAT; ++i) {
+		dtree_ctx_t *ctx = dtree_ctx_new();
+		if(ctx == NULL)
+			return 0;
+
+		dtree_ctx_set_uring(ctx, uring);
+
+		const unsigned long start = time_us();
+		if(dtree_ctx_open(ctx, root)) {
+			fprintf(stderr, "Can not open %s: %s\n", root, dtree_ctx_errstr(ctx));
+			dtree_ctx_free(ctx);
+			return 0;
+		}
+
+		struct dtree_dev_t *dev = NULL;
+		unsigned long count = 0;
+
+		while((dev = dtree_ctx_next(ctx)) != NULL) {
+			count += 1;
+			dtree_ctx_dev_free(ctx, dev);
+		}
+
+		const unsigned long us = time_us() - start;
+		dtree_ctx_free(ctx);
+
+		*devices = count;
+		if(best == 0 || us < best)
+			best = us;
+	}
+
+	return best;
+}
+
+int main(int argc, char **argv)
+{
+	int buses   = argc > 2? atoi(argv[1]) : 16;
+	int devices = argc > 2? atoi(argv[2]) : 256;
+
+	char shm[] = "/dev/shm/dtree-bench-XXXXXX";
+	char tmp[] = "/tmp/dtree-bench-XXXXXX";
+	const char *tree = NULL;
+
+	if(argc == 2) {
+		tree = argv[1];
+	}
+	else if(!gen_tree(shm, buses, devices)) {
+		tree = shm;
+	}
+	else {
+		gen_remove(shm);
+		if(gen_tree(tmp, buses, devices)) {
+			fprintf(stderr, "Can not create the synthetic device-tree\n");
+			gen_remove(tmp);
+			return 1;
+		}
+
+		tree = tmp;
+	}
+
+	printf("%s, best of %d walks\n", tree, REPEAT);
+	printf("reads     devices  walk [us]  speedup\n");
+
+	unsigned long devs = 0;
+	unsigned long plain = walk_best(tree, 0, &devs);
+	if(plain != 0)
+		printf("syscalls  %7lu  %9lu  %7.2f\n", devs, plain, 1.0);
+
+	unsigned long batch = walk_best(tree, 1, &devs);
+	if(plain != 0 && batch != 0)
+		printf("io_uring  %7lu  %9lu  %7.2f\n", devs, batch, (double) plain / batch);
+
+	if(tree == shm || tree == tmp)
+		gen_remove(tree);
+
+	return 0;
+}
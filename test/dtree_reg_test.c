@@ -0,0 +1,416 @@
+#define _XOPEN_SOURCE 700
+
+#include "dtree.h"
+#include "dtree_reg.h"
+#include "test.h"
+#include "test_gen.h"
+
+#include <string.h>
+
+/**
+ * Opens the tree (as a snapshot loaded by the given number
+ * of threads when threads > 0) and looks up the device.
+ * Copies its ranges into reg (and their CPU addresses into cpu
+ * when not NULL) and returns their number, -1 when it is not found
+ * or -2 when the accessors disagree.
+ */
+static
+int find_reg(const char *root, unsigned threads, int uring, const char *name,
+		struct dtree_reg_t *reg, dtree_addr_t *cpu, int max)
+{
+	dtree_ctx_t *ctx = dtree_ctx_new();
+	if(ctx == NULL)
+		return -1;
+
+	dtree_ctx_set_threads(ctx, threads);
+	dtree_ctx_set_uring(ctx, uring);
+
+	int err = threads > 0? dtree_ctx_open_snapshot(ctx, root) : dtree_ctx_open(ctx, root);
+	if(err) {
+		dtree_ctx_free(ctx);
+		return -1;
+	}
+
+	struct dtree_dev_t *dev = dtree_ctx_byname(ctx, name);
+	int count = -1;
+
+	if(dev != NULL) {
+		count = (int) dtree_dev_reg_count(dev);
+
+		for(int i = 0; i < count && i < max; ++i) {
+			reg[i] = *dtree_dev_reg(dev, i);
+			if(cpu != NULL)
+				cpu[i] = dtree_dev_cpu_addr(dev, i);
+		}
+
+		// base is the first range, there is none behind the last one
+		if(dtree_dev_base(dev) != reg[0].base || dtree_dev_reg(dev, count) != NULL)
+			count = -2;
+		if(dtree_dev_cpu_addr(dev, count) != DTREE_ADDR_NONE)
+			count = -2;
+
+		dtree_ctx_dev_free(ctx, dev);
+	}
+
+	dtree_ctx_free(ctx);
+	return count;
+}
+
+static
+int gen_cells(const char *dir, unsigned acells, unsigned scells)
+{
+	const unsigned char a[4] = {0, 0, 0, acells};
+	const unsigned char s[4] = {0, 0, 0, scells};
+
+	if(gen_write(dir, "#address-cells", a, sizeof(a)))
+		return 1;
+
+	return gen_write(dir, "#size-cells", s, sizeof(s));
+}
+
+/**
+ * Creates:
+ *
+ *   /bus@0         (#address-cells = 2, #size-cells = 2)
+ *     /wide@100000000  reg = <0x1 0x0 0x0 0x1000  0x2 0x80000000 0x0 0x2000>
+ *   /cpus          (#address-cells = 1, #size-cells = 0)
+ *     /cpu@3       reg = <3>
+ *   /odd@50000000  reg of three cells (not a device)
+ */
+static
+int gen_cells_tree(char *root)
+{
+	char path[512];
+	const unsigned char wide[32] = {
+		0, 0, 0, 1,  0, 0, 0, 0,  0, 0, 0, 0,  0, 0, 0x10, 0,
+		0, 0, 0, 2,  0x80, 0, 0, 0,  0, 0, 0, 0,  0, 0, 0x20, 0,
+	};
+	const unsigned char cpu[4] = {0, 0, 0, 3};
+	const unsigned char odd[12] = {0x50, 0, 0, 0, 0, 0, 0x10, 0, 0, 0, 0, 0};
+
+	if(mkdtemp(root) == NULL)
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/bus@0", root);
+	if(gen_node(path, "bus", 0, 0x1000, "test,bus") || gen_cells(path, 2, 2))
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/bus@0/wide@100000000", root);
+	if(gen_node(path, "wide", 0, 0, "test,wide") || gen_write(path, "reg", wide, sizeof(wide)))
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/cpus", root);
+	if(mkdir(path, 0755) || gen_write(path, "name", "cpus", 5) || gen_cells(path, 1, 0))
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/cpus/cpu@3", root);
+	if(gen_node(path, "cpu", 0, 0, "test,cpu") || gen_write(path, "reg", cpu, sizeof(cpu)))
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/odd@50000000", root);
+	if(gen_node(path, "odd", 0, 0, "test,odd") || gen_write(path, "reg", odd, sizeof(odd)))
+		return 1;
+
+	return 0;
+}
+
+void test_cells(void)
+{
+	test_start();
+
+	char root[] = "/tmp/dtree-reg-XXXXXX";
+
+	int err = gen_cells_tree(root);
+	if(err)
+		gen_remove(root);
+	halt_on_error(err, "Can not create the synthetic device-tree");
+
+	// streaming walk, batched reads, snapshot, parallel snapshot
+	const unsigned threads[] = {0, 0, 1, 4};
+	const int uring[] = {0, 1, 0, 0};
+
+	for(int i = 0; i < 4; ++i) {
+		struct dtree_reg_t reg[4];
+		memset(reg, 0, sizeof(reg));
+
+		int count = find_reg(root, threads[i], uring[i], "wide", reg, NULL, 4);
+		fail_on_false(count == 2, "Expected two ranges of wide");
+		fail_on_false(reg[0].base == 0x100000000ULL && reg[0].size == 0x1000,
+				"Unexpected first range of wide");
+		fail_on_false(reg[1].base == 0x280000000ULL && reg[1].size == 0x2000,
+				"Unexpected second range of wide");
+
+		count = find_reg(root, threads[i], uring[i], "cpu", reg, NULL, 4);
+		fail_on_false(count == 1, "Expected a single range of cpu");
+		fail_on_false(reg[0].base == 3 && reg[0].size == 0, "Unexpected range of cpu");
+
+		count = find_reg(root, threads[i], uring[i], "bus", reg, NULL, 4);
+		fail_on_false(count == 1, "Expected a single range of bus");
+		fail_on_false(reg[0].base == 0 && reg[0].size == 0x1000, "Unexpected range of bus");
+
+		count = find_reg(root, threads[i], uring[i], "odd", reg, NULL, 4);
+		fail_on_false(count == -1, "Reg not fitting the cells taken as a device");
+	}
+
+	gen_remove(root);
+	test_end();
+}
+
+static
+int gen_ranges(const char *dir, const unsigned *cells, size_t n)
+{
+	unsigned char ranges[64];
+
+	for(size_t i = 0; i < n; ++i) {
+		ranges[4 * i]     = cells[i] >> 24;
+		ranges[4 * i + 1] = cells[i] >> 16;
+		ranges[4 * i + 2] = cells[i] >> 8;
+		ranges[4 * i + 3] = cells[i];
+	}
+
+	return gen_write(dir, "ranges", ranges, 4 * n);
+}
+
+/**
+ * Creates:
+ *
+ *   /soc                 ranges = <0x0 0xF0000000 0x100000>
+ *     /uart@1000         reg = <0x1000 0x100>
+ *     /bridge@8000       (#address-cells = 2) ranges = <0x1 0x0  0x20000 0x10000>
+ *       /dev@1,100       reg = <0x1 0x100 0x10>
+ *       /far@1,20000     reg = <0x1 0x20000 0x10> (not mapped)
+ *     /i2c@2000          (#size-cells = 0, no ranges)
+ *       /eeprom@50       reg = <0x50>
+ *     /dual@3000         reg = <0x3000 0x10 0x4000 0x10>
+ *   /simple              ranges (empty)
+ *     /timer@50000000    reg = <0x50000000 0x100>
+ */
+static
+int gen_ranges_tree(char *root)
+{
+	char path[512];
+	const unsigned soc[] = {0x0, 0xF0000000, 0x100000};
+	const unsigned bridge[] = {0x1, 0x0, 0x20000, 0x10000};
+	const unsigned char dev[12] = {0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0x10};
+	const unsigned char far[12] = {0, 0, 0, 1, 0, 2, 0, 0, 0, 0, 0, 0x10};
+	const unsigned char eeprom[4] = {0, 0, 0, 0x50};
+	const unsigned char dual[16] = {0, 0, 0x30, 0, 0, 0, 0, 0x10, 0, 0, 0x40, 0, 0, 0, 0, 0x10};
+
+	if(mkdtemp(root) == NULL)
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/soc", root);
+	if(mkdir(path, 0755) || gen_ranges(path, soc, 3))
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/soc/uart@1000", root);
+	if(gen_node(path, "uart", 0x1000, 0x100, "test,uart"))
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/soc/bridge@8000", root);
+	if(gen_node(path, "bridge", 0x8000, 0x1000, "test,bridge") || gen_cells(path, 2, 1)
+			|| gen_ranges(path, bridge, 4))
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/soc/bridge@8000/dev@1,100", root);
+	if(gen_node(path, "dev", 0, 0, "test,dev") || gen_write(path, "reg", dev, sizeof(dev)))
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/soc/bridge@8000/far@1,20000", root);
+	if(gen_node(path, "far", 0, 0, "test,far") || gen_write(path, "reg", far, sizeof(far)))
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/soc/i2c@2000", root);
+	if(gen_node(path, "i2c", 0x2000, 0x100, "test,i2c") || gen_cells(path, 1, 0))
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/soc/i2c@2000/eeprom@50", root);
+	if(gen_node(path, "eeprom", 0, 0, "test,eeprom") || gen_write(path, "reg", eeprom, sizeof(eeprom)))
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/soc/dual@3000", root);
+	if(gen_node(path, "dual", 0, 0, "test,dual") || gen_write(path, "reg", dual, sizeof(dual)))
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/simple", root);
+	if(mkdir(path, 0755) || gen_ranges(path, NULL, 0))
+		return 1;
+
+	snprintf(path, sizeof(path), "%s/simple/timer@50000000", root);
+	return gen_node(path, "timer", 0x50000000, 0x100, "test,timer");
+}
+
+void test_ranges(void)
+{
+	test_start();
+
+	char root[] = "/tmp/dtree-reg-XXXXXX";
+
+	int err = gen_ranges_tree(root);
+	if(err)
+		gen_remove(root);
+	halt_on_error(err, "Can not create the synthetic device-tree");
+
+	const struct {
+		const char  *name;
+		dtree_addr_t base;
+		dtree_addr_t cpu;
+	} expect[] = {
+		{"uart",   0x1000,        0xF0001000},
+		{"bridge", 0x8000,        0xF0008000},
+		{"dev",    0x100000100ULL, 0xF0020100},
+		{"far",    0x100020000ULL, DTREE_ADDR_NONE},
+		{"i2c",    0x2000,        0xF0002000},
+		{"eeprom", 0x50,          DTREE_ADDR_NONE},
+		{"timer",  0x50000000,    0x50000000},
+	};
+
+	// streaming walk, batched reads, snapshot, parallel snapshot
+	const unsigned threads[] = {0, 0, 1, 4};
+	const int uring[] = {0, 1, 0, 0};
+
+	for(int i = 0; i < 4; ++i) {
+		for(size_t e = 0; e < sizeof(expect) / sizeof(expect[0]); ++e) {
+			struct dtree_reg_t reg[1];
+			dtree_addr_t cpu[1];
+
+			int count = find_reg(root, threads[i], uring[i], expect[e].name, reg, cpu, 1);
+			fail_on_false(count == 1, expect[e].name);
+			fail_on_false(reg[0].base == expect[e].base, "Unexpected bus address");
+			fail_on_false(cpu[0] == expect[e].cpu, "Unexpected CPU address");
+		}
+	}
+
+	gen_remove(root);
+	test_end();
+}
+
+/**
+ * Reference decoder of a value of n cells (low 64 bits).
+ */
+static
+uint64_t ref_value(const unsigned char *s, unsigned n)
+{
+	uint64_t val = 0;
+
+	for(unsigned i = 0; i < 4 * n; ++i)
+		val = (val << 8) | s[i];
+
+	return val;
+}
+
+void test_cells_read(void)
+{
+	test_start();
+
+	unsigned char raw[4 * 4 * 37 + 1];
+	for(size_t i = 0; i < sizeof(raw); ++i)
+		raw[i] = (unsigned char) (i * 37 + 11);
+
+	// misaligned source, lengths not filling whole vectors
+	const unsigned char *src = raw + 1;
+
+	for(size_t n = 0; n <= 37; ++n) {
+		uint32_t c32[37];
+		dtree_cells_read32(src, n, c32);
+
+		for(size_t i = 0; i < n; ++i)
+			fail_on_false(c32[i] == ref_value(src + 4 * i, 1), "Unexpected 32-bit cell");
+
+		for(unsigned cells = 0; cells <= DTREE_CELLS_MAX; ++cells) {
+			uint64_t val[37];
+			dtree_cells_read(src, n, cells, val);
+
+			for(size_t i = 0; i < n; ++i)
+				fail_on_false(val[i] == ref_value(src + 4 * cells * i, cells), "Unexpected value");
+		}
+	}
+
+	test_end();
+}
+
+static
+const char *name_of(struct dtree_dev_t *dev)
+{
+	return dev == NULL? "(none)" : dtree_dev_name(dev);
+}
+
+/**
+ * Looks up the address from the beginning of the
+ * tree and returns the name of the device found.
+ */
+static
+int addr_is(dtree_ctx_t *ctx, dtree_addr_t addr, int cpu, const char *expect)
+{
+	dtree_ctx_reset(ctx);
+
+	struct dtree_dev_t *dev = cpu? dtree_ctx_bycpuaddr(ctx, addr) : dtree_ctx_byaddr(ctx, addr);
+	const int same = !strcmp(name_of(dev), expect);
+
+	if(dev != NULL)
+		dtree_ctx_dev_free(ctx, dev);
+
+	return same;
+}
+
+static
+void check_addr_lookups(const char *root, unsigned threads, int uring)
+{
+	dtree_ctx_t *ctx = dtree_ctx_new();
+	fail_on_true(ctx == NULL, "Can not create the context");
+
+	dtree_ctx_set_threads(ctx, threads);
+	dtree_ctx_set_uring(ctx, uring);
+
+	int err = threads > 0? dtree_ctx_open_snapshot(ctx, root) : dtree_ctx_open(ctx, root);
+	if(err)
+		dtree_ctx_free(ctx);
+	fail_on_true(err, "Can not open the tree");
+
+	fail_on_false(addr_is(ctx, 0xF0020108, 1, "dev@1,100"), "Device behind the bridge not found");
+	fail_on_false(addr_is(ctx, 0xF0004008, 1, "dual@3000"), "Second range not found by CPU address");
+	fail_on_false(addr_is(ctx, 0x4008, 0, "dual@3000"), "Second range not found by bus address");
+	fail_on_false(addr_is(ctx, 0x100000108ULL, 1, "(none)"), "Bus address found as a CPU one");
+	fail_on_false(addr_is(ctx, 0x100000108ULL, 0, "dev@1,100"), "Bus address of dev not found");
+	fail_on_false(addr_is(ctx, 0x50, 1, "(none)"), "Range not mapped found by CPU address");
+	fail_on_false(addr_is(ctx, 0x50, 0, "eeprom@50"), "Bus address of eeprom not found");
+
+	struct dtree_dev_t *devs[8];
+	size_t count = dtree_ctx_bycpurange(ctx, 0xF0000000, 0xF00FFFFF, devs, 8);
+
+	// uart, bridge, dev, i2c and dual (once for both ranges)
+	fail_on_false(count == 5, "Unexpected devices of the soc window");
+	for(size_t i = 0; i < count && i < 8; ++i)
+		dtree_ctx_dev_free(ctx, devs[i]);
+
+	fail_on_true(dtree_ctx_iserror(ctx), "An error occured during the look ups");
+	dtree_ctx_free(ctx);
+}
+
+void test_addr_lookups(void)
+{
+	test_start();
+
+	char root[] = "/tmp/dtree-reg-XXXXXX";
+
+	int err = gen_ranges_tree(root);
+	if(err)
+		gen_remove(root);
+	halt_on_error(err, "Can not create the synthetic device-tree");
+
+	check_addr_lookups(root, 0, 0);
+	check_addr_lookups(root, 0, 1);
+	check_addr_lookups(root, 1, 0);
+	check_addr_lookups(root, 4, 0);
+
+	gen_remove(root);
+	test_end();
+}
+
+int main(void)
+{
+	test_cells();
+	test_cells_read();
+	test_ranges();
+	test_addr_lookups();
+}
@@ -0,0 +1,248 @@
+#define _XOPEN_SOURCE 700
+
+#include "dtree.h"
+#include "test.h"
+#include "test_gen.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define EXPECT 8 // see dtree_next_test.c
+#define READERS 4
+#define ROUNDS 32
+#define INITIAL 4
+
+static
+int iter_count(dtree_iter_t *it)
+{
+	struct dtree_dev_t *dev = NULL;
+	int count = 0;
+
+	while((dev = dtree_iter_next(it)) != NULL) {
+		count += 1;
+		dtree_iter_dev_free(it, dev);
+	}
+
+	return count;
+}
+
+static
+int iter_count_byname(dtree_iter_t *it, const char *name)
+{
+	struct dtree_dev_t *dev = NULL;
+	int count = 0;
+
+	dtree_iter_reset(it);
+
+	while((dev = dtree_iter_byname(it, name)) != NULL) {
+		count += 1;
+		dtree_iter_dev_free(it, dev);
+	}
+
+	return count;
+}
+
+void test_errors(void)
+{
+	test_start();
+
+	dtree_shared_t *sh = dtree_shared_new();
+	halt_on_true(sh == NULL, "Can not allocate shared snapshot");
+
+	fail_on_false(dtree_shared_iter(sh) == NULL, "Iterator over an empty shared snapshot");
+	fail_on_success(dtree_shared_reload(sh), "Reload successful before open");
+	fail_on_success(dtree_shared_open(sh, "/xxx/yyy/zzz"), "Successful when passing non-existent dir");
+	fail_on_false(dtree_shared_iserror(sh), "Error is not indicated");
+
+	dtree_shared_free(sh);
+	test_end();
+}
+
+void test_queries(void)
+{
+	test_start();
+
+	dtree_shared_t *sh = dtree_shared_new();
+	halt_on_true(sh == NULL, "Can not allocate shared snapshot");
+	fail_on_true(dtree_shared_open(sh, test_tree()), "Can not open testing device-tree");
+
+	dtree_iter_t *it = dtree_shared_iter(sh);
+	fail_on_true(it == NULL, "Can not create iterator");
+
+	fail_on_false(iter_count(it) == EXPECT, "Unexpected number of devices");
+	fail_on_false(iter_count_byname(it, "serial") == 2, "Expected two 'serial' devices");
+
+	dtree_iter_reset(it);
+	struct dtree_dev_t *dev = dtree_iter_bycompat(it, "xlnx,xps-uartlite-1.00.a");
+	fail_on_true(dev == NULL, "Compatible device not found");
+	dtree_iter_dev_free(it, dev);
+
+	dtree_iter_reset(it);
+	dev = dtree_iter_byaddr(it, 0x84000010);
+	fail_on_true(dev == NULL, "Device not found by address");
+	dtree_iter_dev_free(it, dev);
+
+	struct dtree_stats_t stats;
+	dtree_shared_stats(sh, &stats);
+	fail_on_false(stats.devices == EXPECT, "Invalid number of devices in stats");
+
+	// the iterator keeps its snapshot over reload and free
+	fail_on_true(dtree_shared_reload(sh), "Can not reload testing device-tree");
+	dtree_shared_free(sh);
+
+	dtree_iter_reset(it);
+	fail_on_false(iter_count(it) == EXPECT, "Snapshot of the iterator has changed");
+	dtree_iter_destroy(it);
+
+	test_end();
+}
+
+//
+// Concurrent readers over a tree growing between reloads
+//
+
+/**
+ * Adds the i-th device into the bus@0 of root.
+ */
+static
+int tree_add_dev(const char *root, int i)
+{
+	const unsigned char reg[] = {0x10, 0x00, (unsigned char) i, 0x00, 0x00, 0x00, 0x01, 0x00};
+	char dev[512];
+
+	snprintf(dev, sizeof(dev), "%s/bus@0/dev@1000%02x00", root, i);
+
+	if(mkdir(dev, 0755))
+		return 1;
+
+	return gen_write(dev, "reg", reg, sizeof(reg));
+}
+
+static
+int tree_create(char *root)
+{
+	const unsigned char reg[] = {0x00, 0x00, 0x00, 0x00, 0x7F, 0xFF, 0xFF, 0xFF};
+	char bus[512];
+
+	if(mkdtemp(root) == NULL)
+		return 1;
+
+	snprintf(bus, sizeof(bus), "%s/bus@0", root);
+	if(mkdir(bus, 0755) || gen_write(bus, "reg", reg, sizeof(reg)))
+		return 1;
+
+	for(int i = 0; i < INITIAL; ++i) {
+		if(tree_add_dev(root, i))
+			return 1;
+	}
+
+	return 0;
+}
+
+struct reader {
+	pthread_t thread;
+	dtree_shared_t *sh;
+	int *stop;
+	unsigned long walks;
+	int failed;
+};
+
+/**
+ * Every snapshot seen must be complete: it contains the bus
+ * and at least the initial devices and look ups agree with
+ * the walk.
+ */
+static
+void *reader_run(void *arg)
+{
+	struct reader *r = (struct reader *) arg;
+
+	while(!__atomic_load_n(r->stop, __ATOMIC_ACQUIRE) && !r->failed) {
+		dtree_iter_t *it = dtree_shared_iter(r->sh);
+		if(it == NULL) {
+			r->failed = 1;
+			break;
+		}
+
+		const int count = iter_count(it);
+		const int devs  = iter_count_byname(it, "dev");
+
+		if(count != devs + 1 || devs < INITIAL || devs >= INITIAL + ROUNDS)
+			r->failed = 1;
+
+		dtree_iter_destroy(it);
+		r->walks += 1;
+	}
+
+	return NULL;
+}
+
+void test_concurrent_reload(void)
+{
+	test_start();
+
+	char root[] = "/tmp/dtree-shared-XXXXXX";
+	int err = tree_create(root);
+	if(err)
+		gen_remove(root);
+	halt_on_error(err, "Can not create the synthetic device-tree");
+
+	dtree_shared_t *sh = dtree_shared_new();
+	halt_on_true(sh == NULL, "Can not allocate shared snapshot");
+	halt_on_true(dtree_shared_open(sh, root), "Can not open the synthetic device-tree");
+
+	struct reader readers[READERS];
+	int stop = 0;
+
+	for(int i = 0; i < READERS; ++i) {
+		memset(&readers[i], 0, sizeof(struct reader));
+		readers[i].sh   = sh;
+		readers[i].stop = &stop;
+		halt_on_true(pthread_create(&readers[i].thread, NULL, reader_run, &readers[i]),
+				"Can not create reader thread");
+	}
+
+	int reloads = 0;
+	for(int i = INITIAL; i < INITIAL + ROUNDS - 1; ++i) {
+		if(tree_add_dev(root, i) || dtree_shared_reload(sh))
+			break;
+
+		reloads += 1;
+	}
+
+	__atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+
+	unsigned long walks = 0;
+	int failed = 0;
+
+	for(int i = 0; i < READERS; ++i) {
+		pthread_join(readers[i].thread, NULL);
+		walks  += readers[i].walks;
+		failed |= readers[i].failed;
+	}
+
+	dtree_iter_t *it = dtree_shared_iter(sh);
+	const int last = it == NULL? -1 : iter_count_byname(it, "dev");
+	dtree_iter_destroy(it);
+
+	dtree_shared_free(sh);
+	gen_remove(root);
+
+	printf("Reloads: %d, walks by %d readers: %lu\n", reloads, READERS, walks);
+
+	fail_on_false(reloads == ROUNDS - 1, "Reload has failed");
+	fail_on_true(failed, "A reader has seen an inconsistent snapshot");
+	fail_on_false(last == INITIAL + ROUNDS - 1, "The last reload is not published");
+
+	test_end();
+}
+
+int main(void)
+{
+	test_errors();
+	test_queries();
+	test_concurrent_reload();
+}
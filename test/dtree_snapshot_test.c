@@ -0,0 +1,241 @@
+#define _XOPEN_SOURCE 700
+
+#include "dtree.h"
+#include "test.h"
+#include "test_gen.h"
+
+#include <string.h>
+
+void test_all_dev(const int expect)
+{
+	test_start();
+
+	struct dtree_dev_t *curr = NULL;
+	int count = 0;
+
+	while((curr = dtree_next())) {
+		const char *name  = dtree_dev_name(curr);
+		dtree_addr_t base = dtree_dev_base(curr);
+		dtree_addr_t high = dtree_dev_high(curr);
+
+		printf("DEV '%s' at 0x%08llX .. 0x%08llX\n", name,
+				(unsigned long long) base, (unsigned long long) high);
+		print_compat(curr);
+
+		dtree_dev_free(curr);
+		count += 1;
+	}
+
+	fail_on_true(dtree_iserror(), "An error occured during traversing the snapshot");
+	fail_on_true(count != expect, "Unexpected number of devices in the snapshot");
+
+	test_end();
+}
+
+void test_find_after_reset(void)
+{
+	test_start();
+
+	struct dtree_dev_t *eth = dtree_byname("ethernet@81000000");
+	fail_on_true(eth == NULL, "Could not find the device 'ethernet@81000000'");
+	fail_on_false(dtree_dev_base(eth) == 0x81000000, "Invalid base of ethernet@81000000");
+	dtree_dev_free(eth);
+
+	dtree_reset();
+
+	struct dtree_dev_t *serial = dtree_byname("serial@84000000");
+	fail_on_true(serial == NULL, "Could not find the device 'serial@84000000' after reset");
+	fail_on_false(dtree_dev_high(serial) - dtree_dev_base(serial) == 0xFFFF,
+			"Invalid high of serial@84000000");
+	dtree_dev_free(serial);
+
+	test_end();
+}
+
+void test_find_base_name(void)
+{
+	test_start();
+
+	struct dtree_dev_t *dev = NULL;
+	int count = 0;
+
+	while((dev = dtree_byname("serial")) != NULL) {
+		count += 1;
+		dtree_dev_free(dev);
+	}
+
+	fail_on_false(count == 2, "Expected two 'serial' devices");
+
+	struct dtree_dev_t *devs[2];
+	size_t all = dtree_byname_all("serial", devs, 2);
+	fail_on_false(all == 2, "Expected two 'serial' devices by dtree_byname_all()");
+	fail_on_false(devs[0] != devs[1], "The same device returned twice");
+
+	dev = dtree_byname("plb");
+	fail_on_false(dev == NULL, "Device 'plb' found behind the last 'serial'");
+
+	test_end();
+}
+
+void test_find_compat(void)
+{
+	test_start();
+
+	struct dtree_dev_t *dev = NULL;
+	int count = 0;
+
+	while((dev = dtree_bycompat("xlnx,xps-uartlite-1.00.a")) != NULL) {
+		count += 1;
+		dtree_dev_free(dev);
+	}
+
+	fail_on_true(count != 2, "Expected two xlnx,xps-uartlite-1.00.a compatible components");
+
+	dev = dtree_bycompat("xlnx,xps-uartlite-1.00.a");
+	fail_on_false(dev == NULL, "Compatible device found behind the last one");
+
+	struct dtree_dev_t *devs[2];
+	size_t all = dtree_bycompat_all("xlnx,xps-uartlite-1.00.a", devs, 2);
+	fail_on_false(all == 2, "Expected two compatible components by dtree_bycompat_all()");
+	fail_on_false(devs[0] != devs[1], "The same device returned twice");
+
+	all = dtree_bycompat_all("xlnx,microblaze", devs, 2);
+	fail_on_false(all == 0, "The root is never a device");
+
+	test_end();
+}
+
+void test_find_addr(void)
+{
+	test_start();
+
+	struct dtree_dev_t *dev = NULL;
+	int count = 0;
+
+	while((dev = dtree_byaddr(0x84000010)) != NULL) {
+		count += 1;
+		dtree_dev_free(dev);
+	}
+
+	fail_on_false(count == 2, "Expected plb@0 and serial@84000000 only");
+
+	struct dtree_dev_t *devs[8];
+	size_t all = dtree_byrange(0x84000000, 0x8800FFFF, devs, 8);
+	fail_on_false(all == 4, "Expected plb@0, debug and both serial devices by dtree_byrange()");
+	fail_on_false(all >= 1 && !strcmp(dtree_dev_name(devs[0]), "plb@0"),
+			"Devices are not in the order of iteration");
+
+	test_end();
+}
+
+void test_stats(const int expect)
+{
+	test_start();
+
+	struct dtree_stats_t stats;
+	dtree_stats(&stats);
+
+	printf("Snapshot: %lu devices, %lu bytes, %lu overlaps, loaded in %lu us\n",
+			stats.devices, stats.memory, stats.overlaps, stats.load_us);
+
+	fail_on_true(stats.devices != (unsigned long) expect, "Invalid number of devices in stats");
+	fail_on_true(stats.memory == 0, "No memory reported for the snapshot");
+	fail_on_true(stats.overlaps != 0, "No devices of the testing device-tree overlap");
+
+	test_end();
+}
+
+/**
+ * Creates the tree of devices (their ranges):
+ *
+ *   a@0      0x00..0x100  encloses all below
+ *   b@10     0x10..0x30   partially overlaps c@20 and d@25
+ *   c@20     0x20..0x90
+ *   d@25     0x25..0x40   enclosed by c@20
+ *   e@1000   0x1000..0x100f
+ *   f@1000   the same as e@1000
+ */
+static
+int gen_overlap_tree(char *root)
+{
+	const struct {
+		const char *name;
+		unsigned base;
+		unsigned size;
+	} devs[] = {
+		{"a", 0x00, 0x101}, {"b", 0x10, 0x21}, {"c", 0x20, 0x71},
+		{"d", 0x25, 0x1c}, {"e", 0x1000, 0x10}, {"f", 0x1000, 0x10},
+	};
+	char path[512];
+
+	if(mkdtemp(root) == NULL)
+		return 1;
+
+	for(size_t i = 0; i < sizeof(devs) / sizeof(devs[0]); ++i) {
+		snprintf(path, sizeof(path), "%s/%s@%x", root, devs[i].name, devs[i].base);
+		if(gen_node(path, devs[i].name, devs[i].base, devs[i].size, "test,overlap"))
+			return 1;
+	}
+
+	return 0;
+}
+
+void test_overlaps(void)
+{
+	test_start();
+
+	char root[] = "/tmp/dtree-overlap-XXXXXX";
+	int err = gen_overlap_tree(root);
+	if(err)
+		gen_remove(root);
+	halt_on_error(err, "Can not create the testing device-tree");
+
+	dtree_ctx_t *ctx = dtree_ctx_new();
+	halt_on_true(ctx == NULL, "Can not create the context");
+
+	err = dtree_ctx_open_snapshot(ctx, root);
+	if(err) {
+		dtree_ctx_free(ctx);
+		gen_remove(root);
+	}
+	halt_on_error(err, "Can not open the tree as snapshot");
+
+	struct dtree_stats_t stats;
+	dtree_ctx_stats(ctx, &stats);
+
+	printf("Overlapping devices: %lu\n", stats.overlaps);
+	fail_on_false(stats.overlaps == 5, "Expected b, c, d, e and f to overlap");
+
+	dtree_ctx_free(ctx);
+	gen_remove(root);
+
+	test_end();
+}
+
+int main(void)
+{
+	const int expect = 8; // see dtree_next_test.c
+	int err = dtree_open_snapshot(test_tree());
+	halt_on_error(err, "Can not open testing device-tree as snapshot");
+
+	test_all_dev(expect);
+	dtree_reset();
+
+	test_find_after_reset();
+	dtree_reset();
+
+	test_find_base_name();
+	dtree_reset();
+
+	test_find_compat();
+	dtree_reset();
+
+	test_find_addr();
+	dtree_reset();
+
+	test_stats(expect);
+
+	dtree_close();
+
+	test_overlaps();
+}
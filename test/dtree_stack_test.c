@@ -6,6 +6,8 @@
 #include "stack.h"
 #include "test.h"
 
+#include <string.h>
+
 void test_stack_empty(void)
 {
 	test_start();
@@ -116,11 +118,97 @@ void test_stack_move(void)
 	test_end();
 }
 
+void test_path_stack_push_pop(void)
+{
+	test_start();
+
+	struct path_stack ps = PATH_STACK_INIT;
+	void *A = (void *) 0x4354523;
+	void *B = (void *) 0x0918401;
+	void *C = (void *) 0x0809481;
+
+	fail_on_false(path_stack_empty(&ps), "Path stack is not empty");
+	fail_on_false(path_stack_top(&ps) == NULL, "Top of the empty path stack is not NULL");
+	fail_on_false(path_stack_name(&ps) == NULL, "Name of the empty path stack is not NULL");
+	fail_on_false(!strcmp(path_stack_path(&ps), ""), "Path of the empty path stack is not empty");
+
+	halt_on_true(path_stack_push(&ps, "/proc/device-tree", A), "Failed to push A");
+	halt_on_true(path_stack_push(&ps, "plb@0", B), "Failed to push B");
+	fail_on_false(path_stack_depth(&ps) == 2, "Path stack's depth is not 2");
+	fail_on_false(path_stack_top(&ps) == B, "Top value is not B");
+	fail_on_false(!strcmp(path_stack_name(&ps), "plb@0"), "Top name is not plb@0");
+	fail_on_false(!strcmp(path_stack_path(&ps), "/proc/device-tree/plb@0"), "Invalid full path");
+	fail_on_false(path_stack_len(&ps) == strlen("/proc/device-tree/plb@0"), "Invalid cached length");
+
+	halt_on_true(path_stack_push(&ps, "serial@84000000", C), "Failed to push C");
+	fail_on_false(path_stack_depth(&ps) == 3, "Path stack's depth is not 3");
+	fail_on_false(!strcmp(path_stack_path(&ps), "/proc/device-tree/plb@0/serial@84000000"),
+			"Invalid full path with C");
+
+	fail_on_false(path_stack_pop(&ps) == C, "Popped value is not C");
+	fail_on_false(path_stack_top(&ps) == B, "Top value is not B after pop");
+	fail_on_false(!strcmp(path_stack_path(&ps), "/proc/device-tree/plb@0"), "Invalid full path after pop");
+
+	fail_on_false(path_stack_pop(&ps) == B, "Popped value is not B");
+	fail_on_false(path_stack_pop(&ps) == A, "Popped value is not A");
+	fail_on_false(path_stack_pop(&ps) == NULL, "Popped value is not NULL");
+	fail_on_false(path_stack_len(&ps) == 0, "Length of the empty path stack is not 0");
+
+	path_stack_free(&ps);
+	test_end();
+}
+
+void test_path_stack_root(void)
+{
+	test_start();
+
+	struct path_stack ps = PATH_STACK_INIT;
+
+	halt_on_true(path_stack_push(&ps, "/", NULL), "Failed to push the root");
+	halt_on_true(path_stack_push(&ps, "memory@0", NULL), "Failed to push memory@0");
+	fail_on_false(!strcmp(path_stack_path(&ps), "/memory@0"), "Separator doubled after the root");
+	fail_on_false(!strcmp(path_stack_name(&ps), "memory@0"), "Top name is not memory@0");
+
+	path_stack_pop(&ps);
+	fail_on_false(!strcmp(path_stack_path(&ps), "/"), "Root is not restored");
+
+	path_stack_free(&ps);
+	test_end();
+}
+
+void test_path_stack_deep(void)
+{
+	test_start();
+
+	struct path_stack ps = PATH_STACK_INIT;
+	const size_t depth = 1000;
+
+	for(size_t i = 0; i < depth; ++i) {
+		halt_on_true(path_stack_push(&ps, "node@12345678", (void *) (i + 1)), "Failed to push");
+	}
+
+	fail_on_false(path_stack_depth(&ps) == depth, "Invalid depth of the deep path stack");
+	fail_on_false(path_stack_len(&ps) == depth * 14 - 1, "Invalid length of the deep path");
+
+	for(size_t i = depth; i > 0; --i) {
+		fail_on_false(path_stack_top(&ps) == (void *) i, "Invalid top of the deep path stack");
+		path_stack_pop(&ps);
+		fail_on_false(path_stack_len(&ps) == (i == 1? 0 : (i - 1) * 14 - 1),
+				"Invalid length after pop");
+	}
+
+	path_stack_free(&ps);
+	test_end();
+}
+
 int main(void)
 {
 	test_stack_empty();
 	test_stack_top();
 	test_stack_push_pop();
 	test_stack_move();
+	test_path_stack_push_pop();
+	test_path_stack_root();
+	test_path_stack_deep();
 	return 0;
 }
@@ -0,0 +1,263 @@
+#define _XOPEN_SOURCE 700
+
+#include "dtree.h"
+#include "dtree_uring.h"
+#include "test.h"
+#include "test_gen.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAXDEV 512
+
+/**
+ * Device copied out of a context.
+ */
+struct devcopy {
+	char name[64];
+	dtree_addr_t base;
+	dtree_addr_t high;
+	size_t nreg;
+	char compat[1024];
+};
+
+/**
+ * Walks the tree with or without io_uring and copies all
+ * devices in the order of iteration.
+ * Returns the number of devices or -1 on error.
+ */
+static
+int walk_copy(const char *root, int uring, struct devcopy *devs, int max)
+{
+	dtree_ctx_t *ctx = dtree_ctx_new();
+	if(ctx == NULL)
+		return -1;
+
+	dtree_ctx_set_uring(ctx, uring);
+	if(dtree_ctx_open(ctx, root)) {
+		dtree_ctx_free(ctx);
+		return -1;
+	}
+
+	struct dtree_dev_t *dev = NULL;
+	int count = 0;
+
+	while((dev = dtree_ctx_next(ctx)) != NULL && count < max) {
+		struct devcopy *c = &devs[count++];
+		const char **compat = dtree_dev_compat(dev);
+
+		snprintf(c->name, sizeof(c->name), "%s", dtree_dev_name(dev));
+		c->base = dtree_dev_base(dev);
+		c->high = dtree_dev_high(dev);
+		c->nreg = dtree_dev_reg_count(dev);
+		c->compat[0] = '\0';
+
+		for(int i = 0; compat[i] != NULL; ++i) {
+			strncat(c->compat, compat[i], sizeof(c->compat) - strlen(c->compat) - 2);
+			strcat(c->compat, ";");
+		}
+
+		dtree_ctx_dev_free(ctx, dev);
+	}
+
+	if(dtree_ctx_iserror(ctx))
+		count = -1;
+
+	dtree_ctx_free(ctx);
+	return count;
+}
+
+static struct devcopy plain[MAXDEV];
+static struct devcopy batch[MAXDEV];
+
+static
+void compare_walks(const char *root, int expect)
+{
+	const int count = walk_copy(root, 0, plain, MAXDEV);
+	fail_on_false(count == expect, "Unexpected number of devices read by syscalls");
+
+	const int bcount = walk_copy(root, 1, batch, MAXDEV);
+	fail_on_false(bcount == count, "Batched reads returned another number of devices");
+
+	for(int i = 0; i < count && i < bcount; ++i) {
+		fail_on_true(strcmp(plain[i].name, batch[i].name), "Batched reads changed the order");
+		fail_on_false(plain[i].base == batch[i].base, "Batched reads changed the base");
+		fail_on_false(plain[i].high == batch[i].high, "Batched reads changed the high");
+		fail_on_false(plain[i].nreg == batch[i].nreg, "Batched reads changed the ranges");
+		fail_on_true(strcmp(plain[i].compat, batch[i].compat), "Batched reads changed compatible");
+	}
+}
+
+void test_read_batch(void)
+{
+	test_start();
+
+	struct dtree_uring *u = dtree_uring_new(3);
+	if(u == NULL) {
+		test_warn("io_uring is not available, skipping");
+		test_end();
+		return;
+	}
+
+	char root[] = "/tmp/dtree-uring-XXXXXX";
+	char longer[100];
+	memset(longer, 'x', sizeof(longer));
+
+	int err = mkdtemp(root) == NULL;
+	if(!err)
+		err = gen_write(root, "short", "abc", 4);
+	if(!err)
+		err = gen_write(root, "long", longer, sizeof(longer));
+	if(err)
+		gen_remove(root);
+	halt_on_error(err, "Can not create the testing files");
+
+	const int dirfd = open(root, O_RDONLY | O_DIRECTORY);
+	halt_on_true(dirfd < 0, "Can not open the testing directory");
+
+	char buf[3][16];
+	struct dtree_uring_read rd[3] = {
+		{"short",   buf[0], sizeof(buf[0]), 0},
+		{"long",    buf[1], sizeof(buf[1]), 0},
+		{"missing", buf[2], sizeof(buf[2]), 0},
+	};
+
+	for(int round = 0; round < 3; ++round) {
+		err = dtree_uring_read(u, dirfd, rd, 3);
+		fail_on_error(err, "Batch has failed");
+
+		fail_on_false(rd[0].res == 4, "Short file not read whole");
+		fail_on_true(strcmp(buf[0], "abc"), "Short file has unexpected contents");
+		fail_on_false(rd[1].res == sizeof(buf[1]), "Long file must fill the buffer");
+		fail_on_false(rd[2].res == -ENOENT, "Missing file reported no ENOENT");
+	}
+
+	err = dtree_uring_read(u, dirfd, rd, 4);
+	fail_on_success(err, "Batch larger than max accepted");
+
+	close(dirfd);
+	dtree_uring_free(u);
+	gen_remove(root);
+
+	test_end();
+}
+
+void test_same_devices(void)
+{
+	test_start();
+
+	compare_walks(test_tree(), 8); // see dtree_next_test.c
+
+	char root[] = "/tmp/dtree-uring-XXXXXX";
+	char path[512];
+	char compat[700];
+
+	// compatible longer than the batch buffer, reg of two ranges
+	memset(compat, 'c', sizeof(compat));
+	compat[sizeof(compat) - 1] = '\0';
+	const unsigned char reg2[16] = {0x40, 0, 0, 0, 0, 0, 0x10, 0, 0x50, 0, 0, 0, 0, 0, 0x10, 0};
+
+	int err = gen_tree(root, 2, 16);
+	if(!err) {
+		snprintf(path, sizeof(path), "%s/long@60000000", root);
+		err = gen_node(path, "long", 0x60000000, 0x1000, "test,long");
+	}
+	if(!err)
+		err = gen_write(path, "compatible", compat, sizeof(compat));
+	if(!err) {
+		snprintf(path, sizeof(path), "%s/two@40000000", root);
+		err = gen_node(path, "two", 0x40000000, 0x1000, "test,two");
+	}
+	if(!err)
+		err = gen_write(path, "reg", reg2, sizeof(reg2));
+	if(!err) {
+		snprintf(path, sizeof(path), "%s/nocompat@70000000", root);
+		err = gen_node(path, "nocompat", 0x70000000, 0x1000, "test,none");
+	}
+	if(!err) {
+		strcat(path, "/compatible");
+		err = unlink(path);
+	}
+	if(err)
+		gen_remove(root);
+	halt_on_error(err, "Can not create the synthetic device-tree");
+
+	compare_walks(root, 2 * (1 + 16 + 4) + 3);
+	gen_remove(root);
+
+	test_end();
+}
+
+/**
+ * A property that can not be read is reported by its errno
+ * as the plain syscalls do. The cursor returning the first
+ * device has already scanned the second one, its reg is
+ * removed then.
+ */
+static
+void check_read_error(const char *root, int uring)
+{
+	char path[512];
+
+	dtree_ctx_t *ctx = dtree_ctx_new();
+	fail_on_true(ctx == NULL, "Can not create the context");
+
+	dtree_ctx_set_uring(ctx, uring);
+	int err = dtree_ctx_open(ctx, root);
+	if(err)
+		dtree_ctx_free(ctx);
+	fail_on_error(err, "Can not open the tree");
+
+	struct dtree_dev_t *dev = dtree_ctx_next(ctx);
+	fail_on_true(dev == NULL, "No device found");
+
+	const int first = !strcmp(dtree_dev_name(dev), "a@1000");
+	snprintf(path, sizeof(path), "%s/%s/reg", root, first? "b@2000" : "a@1000");
+	dtree_ctx_dev_free(ctx, dev);
+	fail_on_true(unlink(path), "Can not remove reg");
+
+	dev = dtree_ctx_next(ctx);
+	fail_on_false(dev == NULL && dtree_ctx_iserror(ctx), "The missing reg was not reported");
+	printf("%s: %s\n", uring? "batch" : "syscalls", dtree_ctx_errstr(ctx));
+	fail_on_true(strcmp(dtree_ctx_errstr(ctx), strerror(ENOENT)), "Not reported as ENOENT");
+
+	dtree_ctx_free(ctx);
+}
+
+void test_read_error(void)
+{
+	test_start();
+
+	char root[] = "/tmp/dtree-uring-XXXXXX";
+	char path[512];
+
+	for(int uring = 0; uring < 2; ++uring) {
+		int err = mkdtemp(root) == NULL;
+		if(!err) {
+			snprintf(path, sizeof(path), "%s/a@1000", root);
+			err = gen_node(path, "a", 0x1000, 0x100, "test,a");
+		}
+		if(!err) {
+			snprintf(path, sizeof(path), "%s/b@2000", root);
+			err = gen_node(path, "b", 0x2000, 0x100, "test,b");
+		}
+		if(err)
+			gen_remove(root);
+		halt_on_error(err, "Can not create the testing device-tree");
+
+		check_read_error(root, uring);
+		gen_remove(root);
+		strcpy(root, "/tmp/dtree-uring-XXXXXX");
+	}
+
+	test_end();
+}
+
+int main(void)
+{
+	test_read_batch();
+	test_same_devices();
+	test_read_error();
+}
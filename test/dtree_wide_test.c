@@ -0,0 +1,207 @@
+#define _XOPEN_SOURCE 700
+
+#include "dtree.h"
+#include "dtree_procfs.h"
+#include "test.h"
+#include "test_alloc.h"
+#include "test_gen.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/**
+ * Generates a synthetic device-tree with a single bus
+ * containing the given number of devices. Each device
+ * has the files name, reg and compatible.
+ */
+static
+int wide_tree_create(char *root, int devices)
+{
+	if(mkdtemp(root) == NULL)
+		return 1;
+
+	const char compat[] = "test,wide-bus\0simple-bus";
+	const unsigned char reg[] = {0x00, 0x00, 0x00, 0x00, 0x7F, 0xFF, 0xFF, 0xFF};
+	char bus[512];
+	snprintf(bus, sizeof(bus), "%s/bus@0", root);
+
+	if(mkdir(bus, 0755))
+		return 1;
+	if(gen_write(bus, "compatible", compat, sizeof(compat)))
+		return 1;
+	if(gen_write(bus, "reg", reg, sizeof(reg)))
+		return 1;
+
+	for(int i = 0; i < devices; ++i) {
+		char dev[512];
+		char name[64];
+
+		snprintf(name, sizeof(name), "dev@10%04x00", i);
+		if(snprintf(dev, sizeof(dev), "%s/%s", bus, name) >= (int) sizeof(dev))
+			return 1;
+
+		if(gen_node(dev, "dev", 0x10000000u | (unsigned) i << 8, 0x100, "test,wide-dev"))
+			return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Walks the whole tree and returns the number of readdir
+ * calls that were necessary. Returns 0 on failure. The number
+ * of allocations done by the walk is stored into allocs.
+ */
+static
+unsigned long wide_tree_walk(const char *root, int expect, unsigned long *allocs)
+{
+	*allocs = test_alloc_count();
+
+	dtree_ctx_t *ctx = dtree_ctx_new();
+	if(ctx == NULL)
+		return 0;
+
+	if(dtree_ctx_open(ctx, root)) {
+		dtree_ctx_free(ctx);
+		return 0;
+	}
+
+	struct dtree_dev_t *dev = NULL;
+	int count = 0;
+
+	while((dev = dtree_ctx_next(ctx)) != NULL) {
+		count += 1;
+		dtree_ctx_dev_free(ctx, dev);
+	}
+
+	unsigned long readdirs = dtree_procfs_readdir_count(ctx);
+	int failed = dtree_ctx_iserror(ctx) || count != expect;
+
+	dtree_ctx_free(ctx);
+	*allocs = test_alloc_count() - *allocs;
+	return failed? 0 : readdirs;
+}
+
+void test_readdir_linear(void)
+{
+	test_start();
+
+	const int small = 64;
+	const int large = 512;
+
+	char root_small[] = "/tmp/dtree-wide-XXXXXX";
+	char root_large[] = "/tmp/dtree-wide-XXXXXX";
+
+	int err = wide_tree_create(root_small, small);
+	err = err || wide_tree_create(root_large, large);
+	if(err) {
+		gen_remove(root_small);
+		gen_remove(root_large);
+	}
+	halt_on_error(err, "Can not create the synthetic device-tree");
+
+	unsigned long asmall = 0;
+	unsigned long alarge = 0;
+	unsigned long rsmall = wide_tree_walk(root_small, small + 1, &asmall);
+	unsigned long rlarge = wide_tree_walk(root_large, large + 1, &alarge);
+
+	gen_remove(root_small);
+	gen_remove(root_large);
+
+	printf("readdir calls: %d devices: %lu, %d devices: %lu\n",
+			small, rsmall, large, rlarge);
+	printf("Allocations: %d devices: %lu, %d devices: %lu\n",
+			small, asmall, large, alarge);
+
+	fail_on_true(rsmall == 0, "Walk over the small tree has failed");
+	fail_on_true(rlarge == 0, "Walk over the large tree has failed");
+
+	// linear: 8x more devices must not need (much) more than 8x more readdirs
+	fail_on_false(4 * rlarge * small <= 5 * rsmall * large,
+			"Number of readdir calls grows faster than linear");
+
+	// devices come from the arena, frames and the path stack are reused,
+	// only the buffers of the scan grow (logarithmically)
+	fail_on_false(alarge <= 2 * asmall,
+			"Number of allocations grows with the number of devices");
+
+	test_end();
+}
+
+/**
+ * Walks the whole tree from its beginning. The number of
+ * allocations done by the walk is added to allocs.
+ * Returns non-zero on failure.
+ */
+static
+int wide_tree_rewalk(dtree_ctx_t *ctx, int expect, unsigned long *allocs)
+{
+	unsigned long start = test_alloc_count();
+	struct dtree_dev_t *dev = NULL;
+	int count = 0;
+
+	dtree_ctx_reset(ctx);
+
+	while((dev = dtree_ctx_next(ctx)) != NULL) {
+		count += 1;
+		dtree_ctx_dev_free(ctx, dev);
+	}
+
+	*allocs += test_alloc_count() - start;
+	return dtree_ctx_iserror(ctx) || count != expect;
+}
+
+void test_kept_device(void)
+{
+	test_start();
+
+	const int devices = 512;
+	const int walks = 4;
+
+	char root[] = "/tmp/dtree-wide-XXXXXX";
+	int err = wide_tree_create(root, devices);
+	if(err)
+		gen_remove(root);
+	halt_on_error(err, "Can not create the synthetic device-tree");
+
+	dtree_ctx_t *ctx = dtree_ctx_new();
+	err = ctx == NULL || dtree_ctx_open(ctx, root);
+	if(err) {
+		dtree_ctx_free(ctx);
+		gen_remove(root);
+	}
+	halt_on_error(err, "Can not open the synthetic device-tree");
+
+	// the first walk fills the buffers, the next ones reuse them
+	unsigned long walk = 0;
+	fail_on_true(wide_tree_rewalk(ctx, devices + 1, &walk), "Walk over the tree has failed");
+
+	dtree_ctx_reset(ctx);
+	struct dtree_dev_t *kept = dtree_ctx_next(ctx);
+	fail_on_true(kept == NULL, "No device to keep");
+
+	// the kept device pins its own chunk only, the others are
+	// released and reused, a walk needs a new chunk at most
+	unsigned long allocs = 0;
+	for(int i = 0; i < walks; ++i)
+		fail_on_true(wide_tree_rewalk(ctx, devices + 1, &allocs), "Walk over the tree has failed");
+
+	printf("Allocations: walk %lu, %d walks keeping a device %lu\n", walk, walks, allocs);
+	fail_on_false(allocs <= (unsigned long) walks,
+			"Memory of the arena grows while a device is kept");
+
+	if(kept != NULL)
+		dtree_ctx_dev_free(ctx, kept);
+
+	dtree_ctx_free(ctx);
+	gen_remove(root);
+	test_end();
+}
+
+int main(void)
+{
+	test_readdir_linear();
+	test_kept_device();
+}
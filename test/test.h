@@ -9,6 +9,18 @@
 #define DEVICE_TREE "/proc/device-tree"
 #endif
 
+/**
+ * Path to the testing device-tree. By default it is the
+ * device-tree/ directory, set DTREE_TEST_TREE to run the
+ * tests against another one (eg. device-tree.dtb).
+ */
+static inline
+const char *test_tree(void)
+{
+	const char *tree = getenv("DTREE_TEST_TREE");
+	return tree != NULL? tree : "device-tree";
+}
+
 void _test_start(const char *func, const char *file, int lineno)
 {
 	fprintf(stderr, "Running '%s' (%s:%d)\n", func, file, lineno);
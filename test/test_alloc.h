@@ -0,0 +1,43 @@
+#ifndef DTREE_TEST_ALLOC
+#define DTREE_TEST_ALLOC
+
+#include <stddef.h>
+
+/**
+ * Counts the allocations done by the library (and the test
+ * itself). Allocations inside libc (eg. opendir) are not
+ * counted. The test must be linked with:
+ *
+ *   -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc
+ */
+static unsigned long test_allocs = 0;
+
+void *__real_malloc(size_t len);
+void *__real_calloc(size_t n, size_t len);
+void *__real_realloc(void *p, size_t len);
+
+void *__wrap_malloc(size_t len)
+{
+	test_allocs += 1;
+	return __real_malloc(len);
+}
+
+void *__wrap_calloc(size_t n, size_t len)
+{
+	test_allocs += 1;
+	return __real_calloc(n, len);
+}
+
+void *__wrap_realloc(void *p, size_t len)
+{
+	test_allocs += 1;
+	return __real_realloc(p, len);
+}
+
+static inline
+unsigned long test_alloc_count(void)
+{
+	return test_allocs;
+}
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef DTREE_TEST_GEN
+#define DTREE_TEST_GEN
+
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/**
+ * Generator of synthetic procfs device-trees. Requires
+ * _XOPEN_SOURCE 700 (mkdtemp, nftw).
+ */
+
+static inline
+int gen_write(const char *dir, const char *fname, const void *data, size_t len)
+{
+	char path[512];
+	snprintf(path, sizeof(path), "%s/%s", dir, fname);
+
+	FILE *f = fopen(path, "w");
+	if(f == NULL)
+		return 1;
+
+	size_t wlen = fwrite(data, 1, len, f);
+	fclose(f);
+
+	return wlen != len;
+}
+
+static inline
+int gen_node(const char *dir, const char *name, unsigned base, unsigned size, const char *compat)
+{
+	const unsigned char reg[] = {
+		base >> 24, base >> 16, base >> 8, base,
+		size >> 24, size >> 16, size >> 8, size
+	};
+
+	if(mkdir(dir, 0755))
+		return 1;
+	if(gen_write(dir, "name", name, strlen(name) + 1))
+		return 1;
+	if(gen_write(dir, "compatible", compat, strlen(compat) + 1))
+		return 1;
+
+	return gen_write(dir, "reg", reg, sizeof(reg));
+}
+
+/**
+ * Creates a tree with the given number of buses each of them
+ * holding the given number of devices. Every fourth device
+ * has a nested sub-device. Returns 0 on success.
+ */
+static inline
+int gen_tree(char *root, int buses, int devices)
+{
+	char bus[512];
+	char dev[512];
+	char sub[512];
+
+	if(mkdtemp(root) == NULL)
+		return 1;
+
+	for(int b = 0; b < buses; ++b) {
+		const unsigned bbase = 0x10000000u * (unsigned) (b + 1);
+
+		if(snprintf(bus, sizeof(bus), "%s/bus@%x", root, bbase) >= (int) sizeof(bus))
+			return 1;
+		if(gen_node(bus, "bus", bbase, 0x0FFFFFFF, "test,gen-bus"))
+			return 1;
+
+		for(int d = 0; d < devices; ++d) {
+			const unsigned dbase = bbase + 0x10000u * (unsigned) d;
+
+			if(snprintf(dev, sizeof(dev), "%s/dev@%x", bus, dbase) >= (int) sizeof(dev))
+				return 1;
+			if(gen_node(dev, "dev", dbase, 0x1000, "test,gen-dev"))
+				return 1;
+
+			if(d % 4 != 0)
+				continue;
+
+			if(snprintf(sub, sizeof(sub), "%s/sub@%x", dev, dbase + 0x100) >= (int) sizeof(sub))
+				return 1;
+			if(gen_node(sub, "sub", dbase + 0x100, 0x100, "test,gen-sub"))
+				return 1;
+		}
+	}
+
+	return 0;
+}
+
+static inline
+int gen_rm_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+	(void) st;
+	(void) flag;
+	(void) ftw;
+	return remove(path);
+}
+
+static inline
+void gen_remove(const char *root)
+{
+	nftw(root, gen_rm_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+#endif